@@ -0,0 +1,348 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <future>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <functional>
+#include <filesystem>
+#include <string_view>
+
+#include "pe_parser.hpp"
+#include "diff_engine.hpp"
+#include "thread_pool.hpp"
+#include "mapped_file.hpp"
+#include "module_scanner.hpp"
+#include "pe_generator.hpp"
+#include "legacy_relocations.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        struct benchmark_options
+        {
+            generator_options generator{};
+            size_t iterations{10};
+
+            // Only the parser is benchmarked on real images, as there is no memory to diff them against
+            std::filesystem::path image{};
+        };
+
+        struct stage_result
+        {
+            double average{};
+            double best{};
+        };
+
+        void print_usage()
+        {
+            puts("Usage: patch-finder-benchmark [options]\n"
+                 "  --arch x86|x64              Architecture of the generated image (default: x64)\n"
+                 "  --sections <count>          Number of executable sections (default: 1)\n"
+                 "  --section-size <bytes>      Size of each section (default: 16777216)\n"
+                 "  --relocations <count>       Relocated slots per 4 KiB page (default: 64)\n"
+                 "  --patches <count>           Patches per MiB (default: 16)\n"
+                 "  --patch-length <bytes>      Maximum length of a patch (default: 16)\n"
+                 "  --distribution uniform|clustered\n"
+                 "  --seed <value>              Seed of the generator (default: 1)\n"
+                 "  --iterations <count>        Runs per stage (default: 10)\n"
+                 "  --image <path>              Only benchmark parsing, on an existing image such as ntdll.dll");
+        }
+
+        std::optional<benchmark_options> parse_arguments(const int argc, char** argv)
+        {
+            benchmark_options options{};
+            auto& generator = options.generator;
+
+            for (int i = 1; i < argc; ++i)
+            {
+                const std::string_view name = argv[i];
+                if (i + 1 >= argc)
+                {
+                    return std::nullopt;
+                }
+
+                const std::string value = argv[++i];
+
+                if (name == "--arch" && (value == "x86" || value == "x64"))
+                {
+                    generator.x64 = value == "x64";
+                }
+                else if (name == "--distribution" && (value == "uniform" || value == "clustered"))
+                {
+                    generator.distribution = value == "uniform" ? patch_distribution::uniform : patch_distribution::clustered;
+                }
+                else if (name == "--sections")
+                {
+                    generator.section_count = std::stoull(value);
+                }
+                else if (name == "--section-size")
+                {
+                    generator.section_size = std::stoull(value);
+                }
+                else if (name == "--relocations")
+                {
+                    generator.relocations_per_page = std::stoull(value);
+                }
+                else if (name == "--patches")
+                {
+                    generator.patches_per_mib = std::stoull(value);
+                }
+                else if (name == "--patch-length")
+                {
+                    generator.max_patch_length = std::stoull(value);
+                }
+                else if (name == "--seed")
+                {
+                    generator.seed = static_cast<uint32_t>(std::stoul(value));
+                }
+                else if (name == "--iterations")
+                {
+                    options.iterations = std::max<size_t>(std::stoull(value), 1);
+                }
+                else if (name == "--image")
+                {
+                    options.image = value;
+                }
+                else
+                {
+                    return std::nullopt;
+                }
+            }
+
+            return options;
+        }
+
+        // Throughput in MB/s of processing the given number of bytes per run
+        stage_result measure(const size_t iterations, const size_t bytes, const std::function<void()>& function)
+        {
+            // One warm-up run, so that page faults and caches don't end up in the first sample
+            function();
+
+            double total_seconds = 0.0;
+            double best_seconds = std::numeric_limits<double>::max();
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                function();
+                const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                total_seconds += seconds;
+                best_seconds = std::min(best_seconds, seconds);
+            }
+
+            const auto megabytes = static_cast<double>(bytes) / 1'000'000.0;
+
+            return {
+                .average = megabytes / (total_seconds / static_cast<double>(iterations)),
+                .best = megabytes / best_seconds,
+            };
+        }
+
+        void print_result(const char* stage, const stage_result& result)
+        {
+            printf("%-24s %12.1f %12.1f\n", stage, result.average, result.best);
+        }
+
+        // Relocation throughput is based on the two byte entries of the relocation table.
+        // The copy of the old map based path gives the numbers from before the flat relocation list.
+        template <typename SpanElement>
+        void measure_parsing(const benchmark_options& options, const utils::safe_buffer_accessor<SpanElement> buffer,
+                             const size_t file_size)
+        {
+            const auto relocation_count = parse_relocation_table(buffer).size();
+
+            // The old path relocates the sections in place, which just keeps adding the delta to a copy of the file
+            const auto& file = buffer.get_buffer();
+            std::vector<uint8_t> writable_file(file.size());
+            memcpy(writable_file.data(), file.data(), file.size());
+
+            const utils::safe_buffer_accessor<uint8_t> writable_buffer{std::span(writable_file)};
+            const auto load_address = parse_pe_file(buffer).image_base + 0x10000;
+
+            print_result("relocations (std::map)", measure(options.iterations, relocation_count * sizeof(uint16_t), [&] {
+                             if (legacy::parse_pe_file(writable_buffer, load_address).empty())
+                             {
+                                 throw std::runtime_error("Unexpected parsing result");
+                             }
+                         }));
+
+            print_result("parse_relocation_table", measure(options.iterations, relocation_count * sizeof(uint16_t), [&] {
+                             if (parse_relocation_table(buffer).size() != relocation_count)
+                             {
+                                 throw std::runtime_error("Unexpected parsing result");
+                             }
+                         }));
+
+            print_result("parse_pe_file", measure(options.iterations, file_size, [&] {
+                             const auto parsed_image = parse_pe_file(buffer);
+                             if (parsed_image.sections.empty())
+                             {
+                                 throw std::runtime_error("Unexpected parsing result");
+                             }
+                         }));
+        }
+
+        void run_image_benchmarks(const benchmark_options& options)
+        {
+            const utils::mapped_file file{options.image};
+            if (file.empty())
+            {
+                throw std::runtime_error("Failed to open image: " + options.image.string());
+            }
+
+            const utils::safe_buffer_accessor<const std::byte> buffer{file.get_data()};
+            const auto file_size = file.get_data().size();
+
+            printf("Image: %s, %zu bytes, %zu relocations\n\n", options.image.string().c_str(), file_size,
+                   parse_relocation_table(buffer).size());
+            printf("%-24s %12s %12s\n", "Stage", "MB/s (avg)", "MB/s (best)");
+
+            measure_parsing(options, buffer, file_size);
+        }
+
+        size_t get_section_bytes(const clean_image& image)
+        {
+            size_t bytes = 0;
+
+            for (const auto& section : image.sections)
+            {
+                bytes += section.data.size();
+            }
+
+            return bytes;
+        }
+
+        std::span<const uint8_t> get_runtime_data(const synthetic_module& module, const clean_section& section)
+        {
+            return std::span(module.memory).subspan(section.rva, section.data.size());
+        }
+
+        class synthetic_memory_source : public memory_source
+        {
+          public:
+            explicit synthetic_memory_source(const synthetic_module& module)
+                : module_(module)
+            {
+            }
+
+            std::future<bool> read_memory(const uint64_t address, const std::span<uint8_t> buffer) override
+            {
+                const auto& memory = this->module_.memory;
+                const auto offset = address - this->module_.load_address;
+
+                if (offset > memory.size() || buffer.size() > memory.size() - offset)
+                {
+                    return make_ready_read_result(false);
+                }
+
+                memcpy(buffer.data(), memory.data() + offset, buffer.size());
+                return make_ready_read_result(true);
+            }
+
+          private:
+            const synthetic_module& module_;
+        };
+
+        void run_benchmarks(const benchmark_options& options)
+        {
+            if (!options.image.empty())
+            {
+                run_image_benchmarks(options);
+                return;
+            }
+
+            const auto module = generate_module(options.generator);
+            const utils::safe_buffer_accessor<const uint8_t> buffer{std::span(module.file)};
+
+            const auto image = parse_pe_file(buffer);
+            const auto delta = image.get_delta(module.load_address);
+            const auto section_bytes = get_section_bytes(image);
+
+            size_t relocation_count = 0;
+            for (const auto& section : image.sections)
+            {
+                relocation_count += section.relocations.size();
+            }
+
+            printf("Image: %s, %zu sections, %zu bytes of code, %zu relocations, %zu patched bytes\n\n",
+                   options.generator.x64 ? "x64" : "x86", image.sections.size(), section_bytes, relocation_count, module.patched_bytes);
+
+            printf("%-24s %12s %12s\n", "Stage", "MB/s (avg)", "MB/s (best)");
+
+            measure_parsing(options, buffer, module.file.size());
+
+            print_result("safe_buffer_accessor", measure(options.iterations, module.file.size(), [&] {
+                             const auto values = buffer.as<uint64_t>(0);
+                             uint64_t checksum = 0;
+
+                             for (size_t i = 0; i < module.file.size() / sizeof(uint64_t); ++i)
+                             {
+                                 checksum += values.get(i);
+                             }
+
+                             volatile auto result = checksum;
+                             (void)result;
+                         }));
+
+            print_result("find_differences", measure(options.iterations, section_bytes, [&] {
+                             for (const auto& section : image.sections)
+                             {
+                                 const auto address = module.load_address + section.rva;
+                                 (void)find_differences(section, get_runtime_data(module, section), delta, address);
+                             }
+                         }));
+
+            utils::thread_pool pool{};
+            const scan_options scan_options{};
+
+            print_result("find_differences (pool)", measure(options.iterations, section_bytes, [&] {
+                             for (const auto& section : image.sections)
+                             {
+                                 const auto address = module.load_address + section.rva;
+                                 (void)find_differences(pool, section, get_runtime_data(module, section), delta, address,
+                                                        {0, section.data.size()}, std::numeric_limits<size_t>::max(),
+                                                        scan_options.parallel_diff_chunk_size);
+                             }
+                         }));
+
+            synthetic_memory_source memory{module};
+
+            print_result("scan_module", measure(options.iterations, section_bytes, [&] {
+                             const std::atomic_bool cancelled{false};
+                             scan_profiler profiler{false};
+                             module_profile profile{};
+
+                             const module_scan_context context{scan_options, memory, pool, cancelled, profiler};
+                             (void)scan_module(context, image, module.load_address, profile);
+                         }));
+        }
+    }
+}
+
+int main(const int argc, char** argv)
+{
+    const auto options = momo::parse_arguments(argc, argv);
+    if (!options)
+    {
+        momo::print_usage();
+        return 1;
+    }
+
+    try
+    {
+        momo::run_benchmarks(*options);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
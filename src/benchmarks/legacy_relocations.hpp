@@ -0,0 +1,218 @@
+#pragma once
+
+#include <map>
+#include <span>
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+
+#include "pe_parser.hpp"
+
+namespace momo::legacy
+{
+    /*****************************************************************************
+     * Copy of how relocations were applied before they were decoded into a
+     * flat sorted list, so that the benchmark can compare both. Every entry
+     * is looked up in a map of the executable sections and patched in place.
+     * The relocation table is found by scanning the section headers. The only
+     * change is the bound of find_section, which compared the offset against
+     * the number of sections instead of the section size and dropped almost
+     * every relocation.
+     ****************************************************************************/
+
+    using section_data = std::span<uint8_t>;
+    using section_map = std::map<uint64_t, section_data>;
+
+    template <typename AddrType, typename SpanElement>
+    std::optional<size_t> rva_to_file_offset(const utils::safe_buffer_accessor<SpanElement> buffer, const PENTHeaders_t<AddrType>& nt_headers,
+                                             const uint64_t nt_headers_offset, const uint32_t rva)
+    {
+        std::optional<size_t> result{};
+
+        detail::access_sections(buffer, nt_headers, nt_headers_offset, [&](const IMAGE_SECTION_HEADER& section) {
+            const auto size_of_data = std::min(section.SizeOfRawData, section.Misc.VirtualSize);
+            if (section.VirtualAddress <= rva && (section.VirtualAddress + size_of_data) > rva)
+            {
+                result = section.PointerToRawData + rva - section.VirtualAddress;
+                return false;
+            }
+
+            return true;
+        });
+
+        return result;
+    }
+
+    template <typename AddrType, typename SpanElement>
+    section_map parse_sections(const utils::safe_buffer_accessor<SpanElement> buffer, const PENTHeaders_t<AddrType>& nt_headers,
+                               const uint64_t nt_headers_offset, const uint64_t base_address)
+    {
+        section_map result{};
+
+        detail::access_sections(buffer, nt_headers, nt_headers_offset, [&](const IMAGE_SECTION_HEADER& section) {
+            const auto is_writable = section.Characteristics & IMAGE_SCN_MEM_WRITE;
+            const auto is_discardable = section.Characteristics & IMAGE_SCN_MEM_DISCARDABLE;
+            const auto is_uninitialized = section.Characteristics & IMAGE_SCN_CNT_UNINITIALIZED_DATA;
+            const auto is_executable = section.Characteristics & IMAGE_SCN_MEM_EXECUTE;
+            const auto is_invalid = is_writable || is_discardable || is_uninitialized || !is_executable;
+
+            if (section.SizeOfRawData <= 0 || is_invalid)
+            {
+                return true;
+            }
+
+            const auto target_ptr = base_address + section.VirtualAddress;
+
+            const auto size_of_data = std::min(section.SizeOfRawData, section.Misc.VirtualSize);
+            auto* byte_ptr = buffer.get_pointer_for_range(section.PointerToRawData, size_of_data);
+            auto* section_ptr = reinterpret_cast<uint8_t*>(byte_ptr);
+
+            result[target_ptr] = section_data{section_ptr, size_of_data};
+            return true;
+        });
+
+        return result;
+    }
+
+    inline section_map::iterator find_section(section_map& sections, const uint64_t address)
+    {
+        auto iter = sections.upper_bound(address);
+        if (iter == sections.begin())
+        {
+            return sections.end();
+        }
+
+        std::advance(iter, -1);
+
+        const auto offset = address - iter->first;
+        if (offset < iter->second.size())
+        {
+            return iter;
+        }
+
+        return sections.end();
+    }
+
+    template <typename T>
+        requires(std::is_integral_v<T>)
+    bool apply_relocation(section_map& sections, const uint64_t address, const uint64_t delta)
+    {
+        auto section = find_section(sections, address);
+        if (section == sections.end())
+        {
+            return false;
+        }
+
+        utils::safe_buffer_accessor<uint8_t> buffer{section->second};
+
+        const auto offset = address - section->first;
+        const auto obj = buffer.template as<T>(static_cast<size_t>(offset));
+        const auto value = obj.get();
+        const auto new_value = value + static_cast<T>(delta);
+        obj.set(new_value);
+
+        return true;
+    }
+
+    template <typename AddrType, typename SpanElement>
+    void apply_relocations(const utils::safe_buffer_accessor<SpanElement> buffer, const PENTHeaders_t<AddrType>& nt_headers,
+                           const uint64_t nt_headers_offset, section_map& sections, const int64_t delta, const uint64_t base_address)
+    {
+        if (delta == 0)
+        {
+            return;
+        }
+
+        const auto* directory = &nt_headers.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+        if (directory->Size == 0)
+        {
+            return;
+        }
+
+        auto relocation_offset = directory->VirtualAddress;
+        const auto relocation_end = relocation_offset + directory->Size;
+
+        auto relocation_file_offset = rva_to_file_offset(buffer, nt_headers, nt_headers_offset, relocation_offset);
+        if (!relocation_file_offset.has_value())
+        {
+            return;
+        }
+
+        while (relocation_offset < relocation_end)
+        {
+            const auto relocation = buffer.template as<IMAGE_BASE_RELOCATION>(*relocation_file_offset).get();
+
+            if (relocation.VirtualAddress <= 0 || relocation.SizeOfBlock <= sizeof(IMAGE_BASE_RELOCATION))
+            {
+                break;
+            }
+
+            const auto data_size = relocation.SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION);
+            const auto entry_count = data_size / sizeof(uint16_t);
+
+            const auto entries = buffer.template as<uint16_t>(*relocation_file_offset + sizeof(IMAGE_BASE_RELOCATION));
+
+            relocation_offset += relocation.SizeOfBlock;
+            *relocation_file_offset += relocation.SizeOfBlock;
+
+            for (size_t i = 0; i < entry_count; ++i)
+            {
+                const auto entry = entries.get(i);
+
+                const int type = entry >> 12;
+                const auto offset = static_cast<uint16_t>(entry & 0xfff);
+                const auto address = base_address + relocation.VirtualAddress + offset;
+
+                switch (type)
+                {
+                case IMAGE_REL_BASED_ABSOLUTE:
+                    break;
+
+                case IMAGE_REL_BASED_HIGHLOW:
+                    apply_relocation<uint32_t>(sections, address, delta);
+                    break;
+
+                case IMAGE_REL_BASED_DIR64:
+                    apply_relocation<uint64_t>(sections, address, delta);
+                    break;
+
+                default:
+                    throw std::runtime_error("Unknown relocation type: " + std::to_string(type));
+                }
+            }
+        }
+    }
+
+    template <typename AddrType, typename SpanElement>
+    section_map parse_pe_variant(const utils::safe_buffer_accessor<SpanElement>& buffer, const uint64_t base_address)
+    {
+        const auto dos_header = detail::get_dos_header(buffer).get();
+        const auto nt_headers_offset = dos_header.e_lfanew;
+        const auto nt_headers = detail::get_nt_headers<AddrType>(buffer).get();
+        const int64_t aslr_slide = base_address - nt_headers.OptionalHeader.ImageBase;
+
+        auto sections = parse_sections(buffer, nt_headers, nt_headers_offset, base_address);
+        apply_relocations(buffer, nt_headers, nt_headers_offset, sections, aslr_slide, base_address);
+
+        return sections;
+    }
+
+    // Relocates the executable sections in place, so the buffer must be a writable copy of the file
+    template <typename SpanElement>
+    section_map parse_pe_file(const utils::safe_buffer_accessor<SpanElement>& buffer, const uint64_t base_address)
+    {
+        const auto nt_headers = detail::get_nt_headers<uint64_t>(buffer);
+        const auto machine_type = nt_headers.get().FileHeader.Machine;
+
+        switch (machine_type)
+        {
+        case PEMachineType::I386:
+            return parse_pe_variant<uint32_t>(buffer, base_address);
+        case PEMachineType::AMD64:
+            return parse_pe_variant<uint64_t>(buffer, base_address);
+        default:
+            return {};
+        }
+    }
+}
@@ -0,0 +1,286 @@
+#include "pe_generator.hpp"
+
+#include <span>
+#include <random>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+
+#include "pe_parser.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr uint32_t file_alignment = 0x200;
+        constexpr uint32_t section_alignment = 0x1000;
+        constexpr uint32_t page_size = 0x1000;
+        constexpr uint32_t nt_headers_offset = 0x80;
+
+        uint32_t align_up(const uint64_t value, const uint32_t alignment)
+        {
+            return static_cast<uint32_t>((value + alignment - 1) & ~static_cast<uint64_t>(alignment - 1));
+        }
+
+        template <typename T>
+        void write_object(std::vector<uint8_t>& buffer, const size_t offset, const T& object)
+        {
+            memcpy(buffer.data() + offset, &object, sizeof(object));
+        }
+
+        template <typename T>
+        T read_object(const std::vector<uint8_t>& buffer, const size_t offset)
+        {
+            T object{};
+            memcpy(&object, buffer.data() + offset, sizeof(object));
+            return object;
+        }
+
+        // Picks sorted slot offsets within one page that don't overlap
+        std::vector<uint16_t> generate_page_relocations(std::mt19937_64& rng, const size_t page_bytes, const size_t slot_size,
+                                                        const size_t count)
+        {
+            std::vector<uint16_t> slots(page_bytes / slot_size);
+            for (size_t i = 0; i < slots.size(); ++i)
+            {
+                slots[i] = static_cast<uint16_t>(i * slot_size);
+            }
+
+            std::vector<uint16_t> result{};
+            std::ranges::sample(slots, std::back_inserter(result), std::min(count, slots.size()), rng);
+
+            return result;
+        }
+
+        struct section_layout
+        {
+            uint32_t rva{};
+            uint32_t size{};
+            uint32_t file_offset{};
+            std::vector<uint32_t> relocations{};
+        };
+
+        template <typename AddrType>
+        void fill_section(std::mt19937_64& rng, std::vector<uint8_t>& file, section_layout& section, const generator_options& options,
+                          const uint32_t size_of_image, std::vector<uint8_t>& relocation_table)
+        {
+            for (size_t i = 0; i < section.size; i += sizeof(uint64_t))
+            {
+                const auto value = rng();
+                memcpy(file.data() + section.file_offset + i, &value, std::min(sizeof(value), section.size - i));
+            }
+
+            const auto type = sizeof(AddrType) == sizeof(uint64_t) ? IMAGE_REL_BASED_DIR64 : IMAGE_REL_BASED_HIGHLOW;
+
+            for (uint32_t page = 0; page < section.size; page += page_size)
+            {
+                const auto page_bytes = std::min<size_t>(page_size, section.size - page);
+                auto offsets = generate_page_relocations(rng, page_bytes, sizeof(AddrType), options.relocations_per_page);
+                if (offsets.empty())
+                {
+                    continue;
+                }
+
+                std::vector<uint16_t> entries{};
+                entries.reserve(offsets.size() + 1);
+
+                for (const auto offset : offsets)
+                {
+                    entries.push_back(static_cast<uint16_t>((type << 12) | offset));
+
+                    // Slots hold pointers into the image, like real code and data references do
+                    const auto target = static_cast<AddrType>(options.image_base + (rng() % size_of_image));
+                    write_object(file, section.file_offset + page + offset, target);
+
+                    section.relocations.push_back(section.rva + page + offset);
+                }
+
+                // Blocks must stay 4 byte aligned
+                if (entries.size() % 2)
+                {
+                    entries.push_back(0);
+                }
+
+                const IMAGE_BASE_RELOCATION block{
+                    .VirtualAddress = section.rva + page,
+                    .SizeOfBlock = static_cast<uint32_t>(sizeof(IMAGE_BASE_RELOCATION) + (entries.size() * sizeof(uint16_t))),
+                };
+
+                const auto block_offset = relocation_table.size();
+                relocation_table.resize(block_offset + block.SizeOfBlock);
+
+                write_object(relocation_table, block_offset, block);
+                memcpy(relocation_table.data() + block_offset + sizeof(block), entries.data(), entries.size() * sizeof(uint16_t));
+            }
+        }
+
+        size_t apply_patches(std::mt19937_64& rng, std::span<uint8_t> data, const generator_options& options)
+        {
+            constexpr size_t cluster_size = 0x10000;
+
+            const auto patch_count = (data.size() * options.patches_per_mib) / (1024 * 1024);
+            const auto max_length = std::max<size_t>(options.max_patch_length, 1);
+
+            size_t cluster_start = 0;
+            size_t patched_bytes = 0;
+
+            for (size_t i = 0; i < patch_count; ++i)
+            {
+                size_t offset{};
+
+                if (options.distribution == patch_distribution::clustered)
+                {
+                    // Patches come in groups of eight, like hooks placed on neighbouring functions
+                    if (i % 8 == 0)
+                    {
+                        cluster_start = rng() % data.size();
+                    }
+
+                    offset = std::min(cluster_start + (rng() % cluster_size), data.size() - 1);
+                }
+                else
+                {
+                    offset = rng() % data.size();
+                }
+
+                const auto length = std::min(1 + (rng() % max_length), data.size() - offset);
+
+                for (size_t j = 0; j < length; ++j)
+                {
+                    data[offset + j] ^= static_cast<uint8_t>(1 + (rng() % 0xFF));
+                }
+
+                patched_bytes += length;
+            }
+
+            return patched_bytes;
+        }
+
+        template <typename AddrType>
+        synthetic_module generate_module_variant(const generator_options& options)
+        {
+            std::mt19937_64 rng{options.seed};
+
+            const auto section_count = std::max<size_t>(options.section_count, 1);
+            const auto headers_size = align_up(nt_headers_offset + sizeof(PENTHeaders_t<AddrType>) +
+                                                   ((section_count + 1) * sizeof(IMAGE_SECTION_HEADER)),
+                                               file_alignment);
+
+            std::vector<section_layout> sections(section_count);
+
+            uint32_t rva = section_alignment;
+            uint32_t file_offset = headers_size;
+
+            for (auto& section : sections)
+            {
+                section.rva = rva;
+                section.size = static_cast<uint32_t>(options.section_size);
+                section.file_offset = file_offset;
+
+                rva += align_up(section.size, section_alignment);
+                file_offset += align_up(section.size, file_alignment);
+            }
+
+            // The relocation table size isn't known yet, but only the executable sections are targeted
+            const auto size_of_code = rva;
+
+            std::vector<uint8_t> file(file_offset);
+            std::vector<uint8_t> relocation_table{};
+
+            for (auto& section : sections)
+            {
+                fill_section<AddrType>(rng, file, section, options, size_of_code, relocation_table);
+            }
+
+            const auto relocation_rva = rva;
+            const auto relocation_file_offset = file_offset;
+            const auto size_of_image = relocation_rva + align_up(relocation_table.size(), section_alignment);
+
+            file.resize(relocation_file_offset + align_up(relocation_table.size(), file_alignment));
+            memcpy(file.data() + relocation_file_offset, relocation_table.data(), relocation_table.size());
+
+            PEDosHeader_t dos_header{};
+            dos_header.e_magic = PEDosHeader_t::k_Magic;
+            dos_header.e_lfanew = nt_headers_offset;
+            write_object(file, 0, dos_header);
+
+            PENTHeaders_t<AddrType> nt_headers{};
+            nt_headers.Signature = PENTHeaders_t<AddrType>::k_Signature;
+            nt_headers.FileHeader.Machine = sizeof(AddrType) == sizeof(uint64_t) ? PEMachineType::AMD64 : PEMachineType::I386;
+            nt_headers.FileHeader.NumberOfSections = static_cast<uint16_t>(section_count + 1);
+            nt_headers.FileHeader.TimeDateStamp = static_cast<uint32_t>(rng());
+            nt_headers.FileHeader.SizeOfOptionalHeader = sizeof(nt_headers.OptionalHeader);
+            nt_headers.OptionalHeader.Magic = PEOptionalHeader_t<AddrType>::k_Magic;
+            nt_headers.OptionalHeader.ImageBase = static_cast<AddrType>(options.image_base);
+            nt_headers.OptionalHeader.SectionAlignment = section_alignment;
+            nt_headers.OptionalHeader.FileAlignment = file_alignment;
+            nt_headers.OptionalHeader.SizeOfImage = size_of_image;
+            nt_headers.OptionalHeader.SizeOfHeaders = headers_size;
+            nt_headers.OptionalHeader.NumberOfRvaAndSizes = PEOptionalHeaderBasePart1_t<AddrType>::k_NumberOfDataDirectors;
+
+            auto& relocation_directory = nt_headers.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+            relocation_directory.VirtualAddress = relocation_rva;
+            relocation_directory.Size = static_cast<uint32_t>(relocation_table.size());
+
+            write_object(file, nt_headers_offset, nt_headers);
+
+            auto section_header_offset = static_cast<size_t>(detail::get_first_section_offset(nt_headers, nt_headers_offset));
+
+            for (const auto& section : sections)
+            {
+                IMAGE_SECTION_HEADER header{};
+                memcpy(header.Name, ".text", 5);
+                header.Misc.VirtualSize = section.size;
+                header.VirtualAddress = section.rva;
+                header.SizeOfRawData = align_up(section.size, file_alignment);
+                header.PointerToRawData = section.file_offset;
+                header.Characteristics = IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ;
+
+                write_object(file, section_header_offset, header);
+                section_header_offset += sizeof(header);
+            }
+
+            IMAGE_SECTION_HEADER relocation_header{};
+            memcpy(relocation_header.Name, ".reloc", 6);
+            relocation_header.Misc.VirtualSize = static_cast<uint32_t>(relocation_table.size());
+            relocation_header.VirtualAddress = relocation_rva;
+            relocation_header.SizeOfRawData = align_up(relocation_table.size(), file_alignment);
+            relocation_header.PointerToRawData = relocation_file_offset;
+            relocation_header.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_DISCARDABLE;
+            write_object(file, section_header_offset, relocation_header);
+
+            synthetic_module module{};
+            module.load_address = options.load_address;
+            module.memory.resize(size_of_image);
+
+            const auto delta = options.load_address - options.image_base;
+
+            for (const auto& section : sections)
+            {
+                auto data = std::span(module.memory).subspan(section.rva, section.size);
+                memcpy(data.data(), file.data() + section.file_offset, section.size);
+
+                for (const auto relocation : section.relocations)
+                {
+                    const auto value = read_object<AddrType>(module.memory, relocation);
+                    write_object(module.memory, relocation, static_cast<AddrType>(value + delta));
+                }
+
+                module.patched_bytes += apply_patches(rng, data, options);
+            }
+
+            module.file = std::move(file);
+            return module;
+        }
+    }
+
+    synthetic_module generate_module(const generator_options& options)
+    {
+        if (options.x64)
+        {
+            return generate_module_variant<uint64_t>(options);
+        }
+
+        return generate_module_variant<uint32_t>(options);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace momo
+{
+    enum class patch_distribution
+    {
+        uniform,
+        clustered,
+    };
+
+    struct generator_options
+    {
+        bool x64{true};
+        uint64_t image_base{0x180000000};
+        uint64_t load_address{0x7ff700000000};
+        uint32_t seed{1};
+
+        size_t section_count{1};
+        size_t section_size{16 * 1024 * 1024};
+
+        // Number of relocated slots per 4 KiB page
+        size_t relocations_per_page{64};
+
+        size_t patches_per_mib{16};
+        size_t max_patch_length{16};
+        patch_distribution distribution{patch_distribution::uniform};
+    };
+
+    /*****************************************************************************
+     * A synthetic PE file with executable sections of random bytes and a
+     * relocation table, together with the memory of the module as if it was
+     * loaded at load_address: relocations are applied and patches written.
+     ****************************************************************************/
+
+    struct synthetic_module
+    {
+        std::vector<uint8_t> file{};
+
+        uint64_t load_address{};
+        std::vector<uint8_t> memory{};
+
+        size_t patched_bytes{};
+    };
+
+    synthetic_module generate_module(const generator_options& options);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace momo
+{
+    struct import_slot
+    {
+        // Rva of the slot in the import address table
+        uint32_t rva{};
+
+        // The slot holds this until the loader binds it
+        uint64_t file_value{};
+
+        // Imported module and function, for example kernel32.dll!CreateFileW or ws2_32.dll!#23
+        std::string name{};
+    };
+
+    struct export_slot
+    {
+        // Rva of the entry in the export address table
+        uint32_t rva{};
+        uint32_t function_rva{};
+
+        // Unnamed exports are named after their ordinal, for example #12
+        std::string name{};
+
+        // Forwarded exports point to a module and function name within the export directory
+        bool is_forwarder{false};
+    };
+
+    // Both tables are sorted by slot rva
+    struct address_tables
+    {
+        uint32_t pointer_size{};
+        std::vector<import_slot> imports{};
+        std::vector<export_slot> exports{};
+    };
+}
@@ -85,8 +85,7 @@ namespace momo::utils
 
         void validate(const size_t offset, const size_t size) const
         {
-            const auto end = offset + size;
-            if (end > buffer_.size())
+            if (offset > this->buffer_.size() || size > this->buffer_.size() - offset)
             {
                 throw std::runtime_error("Buffer accessor overflow");
             }
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <optional>
+
+namespace momo
+{
+    struct relocation_entry
+    {
+        uint32_t rva{};
+        uint8_t size{};
+    };
+
+    // Sorted by rva
+    using relocation_list = std::vector<relocation_entry>;
+
+    /*****************************************************************************
+     * Section bytes as they are stored in the file. Relocated slots are not
+     * rewritten; they are compared as file value + delta instead, which keeps
+     * the image independent of the address it is loaded at.
+     ****************************************************************************/
+
+    struct clean_section
+    {
+        uint32_t rva{};
+        std::span<const uint8_t> data{};
+
+        // Non-overlapping slots that lie completely within the section
+        relocation_list relocations{};
+    };
+
+    // Relocated pointer slots of the read-only data sections, which are the only part of those sections that is compared
+    struct pointer_slot_table
+    {
+        // Non-overlapping slots, sorted by rva
+        relocation_list slots{};
+
+        // File bytes of the slots, back to back in slot order
+        std::vector<uint8_t> values{};
+    };
+
+    // Identifies the build of a module, independent of where its file is stored
+    struct image_identity
+    {
+        uint32_t time_date_stamp{};
+        uint32_t size_of_image{};
+
+        bool operator==(const image_identity&) const = default;
+    };
+
+    struct section_header
+    {
+        std::array<char, 8> name{};
+        uint32_t rva{};
+        uint32_t virtual_size{};
+        uint32_t raw_size{};
+        uint32_t characteristics{};
+
+        bool operator==(const section_header&) const = default;
+    };
+
+    // The parts of the PE headers that the loader leaves untouched, so they are equal in the file and in memory
+    struct image_headers
+    {
+        image_identity identity{};
+        uint32_t checksum{};
+        std::vector<section_header> sections{};
+    };
+
+    struct clean_image
+    {
+        uint64_t image_base{};
+        image_identity identity{};
+        std::vector<clean_section> sections{};
+
+        // Only parsed for pointer scans
+        std::optional<pointer_slot_table> pointer_slots{};
+
+        int64_t get_delta(const uint64_t base_address) const
+        {
+            return static_cast<int64_t>(base_address - this->image_base);
+        }
+    };
+}
@@ -0,0 +1,200 @@
+#include "compression.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace momo::utils
+{
+    namespace
+    {
+        constexpr size_t min_match_length = 4;
+        constexpr size_t max_offset = 0xFFFF;
+        constexpr size_t hash_bits = 12;
+
+        // Sequence: token (literal length << 4 | match length - 4), extra literal length, literals, offset, extra match length
+        constexpr uint8_t length_mask = 0xF;
+
+        uint32_t read_u32(const uint8_t* data)
+        {
+            uint32_t value{};
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        uint32_t hash_sequence(const uint32_t sequence)
+        {
+            return (sequence * 2654435761U) >> (32 - hash_bits);
+        }
+
+        void write_length(std::vector<uint8_t>& output, size_t length)
+        {
+            while (length >= 0xFF)
+            {
+                output.push_back(0xFF);
+                length -= 0xFF;
+            }
+
+            output.push_back(static_cast<uint8_t>(length));
+        }
+
+        void write_sequence(std::vector<uint8_t>& output, const std::span<const uint8_t> literals, const size_t offset,
+                            const size_t match_length)
+        {
+            const auto match_extra = match_length ? match_length - min_match_length : 0;
+            const auto literal_token = std::min<size_t>(literals.size(), length_mask);
+            const auto match_token = std::min<size_t>(match_extra, length_mask);
+
+            output.push_back(static_cast<uint8_t>((literal_token << 4) | match_token));
+
+            if (literal_token == length_mask)
+            {
+                write_length(output, literals.size() - length_mask);
+            }
+
+            output.insert(output.end(), literals.begin(), literals.end());
+
+            // The last sequence only carries literals
+            if (!match_length)
+            {
+                return;
+            }
+
+            output.push_back(static_cast<uint8_t>(offset));
+            output.push_back(static_cast<uint8_t>(offset >> 8));
+
+            if (match_token == length_mask)
+            {
+                write_length(output, match_extra - length_mask);
+            }
+        }
+
+        bool read_length(std::span<const uint8_t>& input, size_t& length)
+        {
+            while (true)
+            {
+                if (input.empty())
+                {
+                    return false;
+                }
+
+                const auto value = input.front();
+                input = input.subspan(1);
+                length += value;
+
+                if (value != 0xFF)
+                {
+                    return true;
+                }
+            }
+        }
+    }
+
+    std::vector<uint8_t> compress_block(const std::span<const uint8_t> input)
+    {
+        std::vector<uint8_t> output{};
+        output.reserve(input.size() / 2);
+
+        std::array<uint32_t, 1 << hash_bits> table{};
+        table.fill(UINT32_MAX);
+
+        const auto* data = input.data();
+        size_t anchor = 0;
+        size_t position = 0;
+
+        while (position + min_match_length <= input.size())
+        {
+            const auto sequence = read_u32(data + position);
+            auto& entry = table[hash_sequence(sequence)];
+
+            const auto candidate = static_cast<size_t>(entry);
+            entry = static_cast<uint32_t>(position);
+
+            if (candidate == UINT32_MAX || position - candidate > max_offset || read_u32(data + candidate) != sequence)
+            {
+                ++position;
+                continue;
+            }
+
+            auto length = min_match_length;
+            while (position + length < input.size() && data[candidate + length] == data[position + length])
+            {
+                ++length;
+            }
+
+            write_sequence(output, input.subspan(anchor, position - anchor), position - candidate, length);
+
+            position += length;
+            anchor = position;
+        }
+
+        write_sequence(output, input.subspan(anchor), 0, 0);
+        return output;
+    }
+
+    bool decompress_block(std::span<const uint8_t> input, const std::span<uint8_t> output)
+    {
+        size_t position = 0;
+
+        while (!input.empty())
+        {
+            const auto token = input.front();
+            input = input.subspan(1);
+
+            size_t literal_length = token >> 4;
+            if (literal_length == length_mask && !read_length(input, literal_length))
+            {
+                return false;
+            }
+
+            if (literal_length > input.size() || literal_length > output.size() - position)
+            {
+                return false;
+            }
+
+            // The output of an empty block may not have any storage
+            if (literal_length)
+            {
+                memcpy(output.data() + position, input.data(), literal_length);
+            }
+
+            input = input.subspan(literal_length);
+            position += literal_length;
+
+            if (input.empty())
+            {
+                break;
+            }
+
+            if (input.size() < 2)
+            {
+                return false;
+            }
+
+            const auto offset = static_cast<size_t>(input[0] | (input[1] << 8));
+            input = input.subspan(2);
+
+            size_t match_length = token & length_mask;
+            if (match_length == length_mask && !read_length(input, match_length))
+            {
+                return false;
+            }
+
+            match_length += min_match_length;
+
+            if (offset == 0 || offset > position || match_length > output.size() - position)
+            {
+                return false;
+            }
+
+            // Matches may overlap the bytes they produce, which repeats short patterns
+            for (size_t i = 0; i < match_length; ++i)
+            {
+                output[position + i] = output[position - offset + i];
+            }
+
+            position += match_length;
+        }
+
+        return position == output.size();
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+namespace momo::utils
+{
+    /*****************************************************************************
+     * Small LZ77 block compressor in the spirit of LZ4. It favours speed over
+     * ratio, which suits code with its runs of padding and repeated
+     * instruction sequences. Blocks must not be larger than 4 GiB.
+     ****************************************************************************/
+
+    std::vector<uint8_t> compress_block(std::span<const uint8_t> input);
+
+    // The output must have exactly the uncompressed size. Returns false for malformed input.
+    bool decompress_block(std::span<const uint8_t> input, std::span<uint8_t> output);
+}
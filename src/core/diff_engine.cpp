@@ -0,0 +1,744 @@
+#include "diff_engine.hpp"
+
+#include <bit>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PATCH_FINDER_X64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(PATCH_FINDER_X64) && !defined(_MSC_VER)
+#define PATCH_FINDER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PATCH_FINDER_TARGET_AVX2
+#endif
+
+namespace momo
+{
+    namespace
+    {
+        // Both functions return the index of the first matching byte in [offset, size) or size if there is none
+        using search_function = size_t (*)(const uint8_t* clean_data, const uint8_t* runtime_data, size_t offset, size_t size);
+
+        struct diff_kernel
+        {
+            search_function find_first_difference{};
+            search_function find_first_equal{};
+        };
+
+        uint64_t load_word(const uint8_t* data)
+        {
+            uint64_t value{};
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        // Index of the first byte in memory order that has its highest bit set
+        size_t get_first_marked_byte(const uint64_t mask)
+        {
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                return static_cast<size_t>(std::countr_zero(mask)) / 8;
+            }
+            else
+            {
+                return static_cast<size_t>(std::countl_zero(mask)) / 8;
+            }
+        }
+
+        uint64_t get_non_zero_byte_mask(const uint64_t value)
+        {
+            constexpr uint64_t low_bits = 0x7F7F7F7F7F7F7F7FULL;
+            return (((value & low_bits) + low_bits) | value) & ~low_bits;
+        }
+
+        size_t find_first_difference_bytewise(const uint8_t* clean_data, const uint8_t* runtime_data, size_t offset, const size_t size)
+        {
+            while (offset < size && clean_data[offset] == runtime_data[offset])
+            {
+                ++offset;
+            }
+
+            return offset;
+        }
+
+        size_t find_first_equal_bytewise(const uint8_t* clean_data, const uint8_t* runtime_data, size_t offset, const size_t size)
+        {
+            while (offset < size && clean_data[offset] != runtime_data[offset])
+            {
+                ++offset;
+            }
+
+            return offset;
+        }
+
+        size_t find_first_difference_word(const uint8_t* clean_data, const uint8_t* runtime_data, size_t offset, const size_t size)
+        {
+            for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+            {
+                const auto difference = load_word(clean_data + offset) ^ load_word(runtime_data + offset);
+                if (difference != 0)
+                {
+                    return offset + get_first_marked_byte(get_non_zero_byte_mask(difference));
+                }
+            }
+
+            return find_first_difference_bytewise(clean_data, runtime_data, offset, size);
+        }
+
+        size_t find_first_equal_word(const uint8_t* clean_data, const uint8_t* runtime_data, size_t offset, const size_t size)
+        {
+            for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+            {
+                const auto difference = load_word(clean_data + offset) ^ load_word(runtime_data + offset);
+                const auto equal_mask = ~get_non_zero_byte_mask(difference) & 0x8080808080808080ULL;
+                if (equal_mask != 0)
+                {
+                    return offset + get_first_marked_byte(equal_mask);
+                }
+            }
+
+            return find_first_equal_bytewise(clean_data, runtime_data, offset, size);
+        }
+
+#ifdef PATCH_FINDER_X64
+        uint32_t compare_block_sse2(const uint8_t* clean_data, const uint8_t* runtime_data, const size_t offset)
+        {
+            const auto clean = _mm_loadu_si128(reinterpret_cast<const __m128i*>(clean_data + offset));
+            const auto runtime = _mm_loadu_si128(reinterpret_cast<const __m128i*>(runtime_data + offset));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(clean, runtime)));
+        }
+
+        size_t find_first_difference_sse2(const uint8_t* clean_data, const uint8_t* runtime_data, size_t offset, const size_t size)
+        {
+            constexpr size_t block_size = sizeof(__m128i);
+
+            for (; offset + (block_size * 2) <= size; offset += block_size * 2)
+            {
+                const auto low = compare_block_sse2(clean_data, runtime_data, offset);
+                const auto high = compare_block_sse2(clean_data, runtime_data, offset + block_size);
+                const auto equal_mask = low | (high << block_size);
+
+                if (equal_mask != 0xFFFFFFFF)
+                {
+                    return offset + static_cast<size_t>(std::countr_one(equal_mask));
+                }
+            }
+
+            return find_first_difference_word(clean_data, runtime_data, offset, size);
+        }
+
+        size_t find_first_equal_sse2(const uint8_t* clean_data, const uint8_t* runtime_data, size_t offset, const size_t size)
+        {
+            constexpr size_t block_size = sizeof(__m128i);
+
+            for (; offset + block_size <= size; offset += block_size)
+            {
+                const auto equal_mask = compare_block_sse2(clean_data, runtime_data, offset);
+                if (equal_mask != 0)
+                {
+                    return offset + static_cast<size_t>(std::countr_zero(equal_mask));
+                }
+            }
+
+            return find_first_equal_word(clean_data, runtime_data, offset, size);
+        }
+
+        PATCH_FINDER_TARGET_AVX2 uint32_t compare_block_avx2(const uint8_t* clean_data, const uint8_t* runtime_data, const size_t offset)
+        {
+            const auto clean = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(clean_data + offset));
+            const auto runtime = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(runtime_data + offset));
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(clean, runtime)));
+        }
+
+        PATCH_FINDER_TARGET_AVX2 size_t find_first_difference_avx2(const uint8_t* clean_data, const uint8_t* runtime_data, size_t offset,
+                                                                   const size_t size)
+        {
+            constexpr size_t block_size = sizeof(__m256i);
+
+            for (; offset + (block_size * 2) <= size; offset += block_size * 2)
+            {
+                const uint64_t low = compare_block_avx2(clean_data, runtime_data, offset);
+                const uint64_t high = compare_block_avx2(clean_data, runtime_data, offset + block_size);
+                const auto equal_mask = low | (high << block_size);
+
+                if (equal_mask != ~0ULL)
+                {
+                    return offset + static_cast<size_t>(std::countr_one(equal_mask));
+                }
+            }
+
+            return find_first_difference_sse2(clean_data, runtime_data, offset, size);
+        }
+
+        PATCH_FINDER_TARGET_AVX2 size_t find_first_equal_avx2(const uint8_t* clean_data, const uint8_t* runtime_data, size_t offset,
+                                                              const size_t size)
+        {
+            constexpr size_t block_size = sizeof(__m256i);
+
+            for (; offset + block_size <= size; offset += block_size)
+            {
+                const auto equal_mask = compare_block_avx2(clean_data, runtime_data, offset);
+                if (equal_mask != 0)
+                {
+                    return offset + static_cast<size_t>(std::countr_zero(equal_mask));
+                }
+            }
+
+            return find_first_equal_sse2(clean_data, runtime_data, offset, size);
+        }
+
+        bool is_avx2_supported()
+        {
+#ifdef _MSC_VER
+            int info[4]{};
+            __cpuid(info, 0);
+            if (info[0] < 7)
+            {
+                return false;
+            }
+
+            __cpuid(info, 1);
+            const auto has_avx = (info[2] & (1 << 28)) != 0;
+            const auto has_osxsave = (info[2] & (1 << 27)) != 0;
+            if (!has_avx || !has_osxsave || (_xgetbv(0) & 6) != 6)
+            {
+                return false;
+            }
+
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+
+        diff_kernel get_kernel_functions(const diff_kernel_type type)
+        {
+            switch (type)
+            {
+#ifdef PATCH_FINDER_X64
+            case diff_kernel_type::avx2:
+                return {find_first_difference_avx2, find_first_equal_avx2};
+            case diff_kernel_type::sse2:
+                return {find_first_difference_sse2, find_first_equal_sse2};
+#endif
+            default:
+                return {find_first_difference_word, find_first_equal_word};
+            }
+        }
+
+        diff_kernel select_diff_kernel()
+        {
+#ifdef PATCH_FINDER_X64
+            if (is_avx2_supported())
+            {
+                return get_kernel_functions(diff_kernel_type::avx2);
+            }
+
+            return get_kernel_functions(diff_kernel_type::sse2);
+#else
+            return get_kernel_functions(diff_kernel_type::word);
+#endif
+        }
+
+        diff_kernel& get_diff_kernel()
+        {
+            static auto kernel = select_diff_kernel();
+            return kernel;
+        }
+
+        /*****************************************************************************
+         * Builds patch runs from consecutive compare calls. A run that is still
+         * open at the end of one call is continued by the next one, so callers
+         * can split the data wherever they need to.
+         ****************************************************************************/
+
+        class run_builder
+        {
+          public:
+            run_builder(const uint64_t base_address, const size_t max_differences)
+                : base_address_(base_address),
+                  max_differences_(max_differences)
+            {
+            }
+
+            // Returns false as soon as the difference budget is exceeded
+            bool compare(const uint8_t* clean_data, const uint8_t* runtime_data, const size_t position, const size_t length)
+            {
+                const auto& kernel = get_diff_kernel();
+                size_t offset = 0;
+
+                while (offset < length)
+                {
+                    if (!this->run_start_)
+                    {
+                        const auto start = kernel.find_first_difference(clean_data, runtime_data, offset, length);
+                        if (start >= length)
+                        {
+                            break;
+                        }
+
+                        if (this->differences_ >= this->max_differences_)
+                        {
+                            return false;
+                        }
+
+                        this->run_start_ = position + start;
+                        offset = start + 1;
+                        continue;
+                    }
+
+                    // Don't look further than the remaining budget allows
+                    const auto run_length = position + offset - *this->run_start_;
+                    const auto remaining_budget = this->max_differences_ - this->differences_ - run_length;
+                    const auto search_end = (length - offset) > remaining_budget ? offset + remaining_budget + 1 : length;
+
+                    const auto end = kernel.find_first_equal(clean_data, runtime_data, offset, search_end);
+                    if (end - offset > remaining_budget)
+                    {
+                        return false;
+                    }
+
+                    if (end >= length)
+                    {
+                        break;
+                    }
+
+                    this->finish_run(position + end);
+                    offset = end;
+                }
+
+                return true;
+            }
+
+            std::vector<patch> finish(const size_t end)
+            {
+                if (this->run_start_)
+                {
+                    this->finish_run(end);
+                }
+
+                return std::move(this->patches_);
+            }
+
+          private:
+            uint64_t base_address_{};
+            size_t max_differences_{};
+            size_t differences_{};
+
+            std::optional<size_t> run_start_{};
+            std::vector<patch> patches_{};
+
+            void finish_run(const size_t end)
+            {
+                const auto length = end - *this->run_start_;
+                this->differences_ += length;
+                this->patches_.emplace_back(this->base_address_ + *this->run_start_, length);
+                this->run_start_.reset();
+            }
+        };
+
+        template <typename T>
+        void get_relocated_value(const uint8_t* clean_data, const int64_t delta, uint8_t* buffer)
+        {
+            T value{};
+            memcpy(&value, clean_data, sizeof(value));
+            value += static_cast<T>(delta);
+            memcpy(buffer, &value, sizeof(value));
+        }
+
+        std::optional<std::vector<patch>> find_differences_in_range(const clean_section& section, const std::span<const uint8_t> runtime_data,
+                                                                    const int64_t delta, const uint64_t base_address, const size_t begin,
+                                                                    const size_t end, const size_t max_differences)
+        {
+            const auto* clean_data = section.data.data();
+
+            run_builder builder{base_address, max_differences};
+            size_t position = begin;
+
+            if (delta != 0)
+            {
+                auto relocation = std::ranges::lower_bound(section.relocations, section.rva + begin, {}, &relocation_entry::rva);
+
+                for (; relocation != section.relocations.end(); ++relocation)
+                {
+                    const auto slot = static_cast<size_t>(relocation->rva - section.rva);
+
+                    // Overlapping slots are ignored
+                    if (slot < position)
+                    {
+                        continue;
+                    }
+
+                    if (slot + relocation->size > end)
+                    {
+                        break;
+                    }
+
+                    if (!builder.compare(clean_data + position, runtime_data.data() + position, position, slot - position))
+                    {
+                        return std::nullopt;
+                    }
+
+                    uint8_t relocated_value[sizeof(uint64_t)]{};
+
+                    if (relocation->size == sizeof(uint64_t))
+                    {
+                        get_relocated_value<uint64_t>(clean_data + slot, delta, relocated_value);
+                    }
+                    else
+                    {
+                        get_relocated_value<uint32_t>(clean_data + slot, delta, relocated_value);
+                    }
+
+                    if (!builder.compare(relocated_value, runtime_data.data() + slot, slot, relocation->size))
+                    {
+                        return std::nullopt;
+                    }
+
+                    position = slot + relocation->size;
+                }
+            }
+
+            if (!builder.compare(clean_data + position, runtime_data.data() + position, position, end - position))
+            {
+                return std::nullopt;
+            }
+
+            return builder.finish(end);
+        }
+
+        template <typename T>
+        T load_slot(const uint8_t* data)
+        {
+            T value{};
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        // Index of the first of count adjacent slots whose runtime value isn't the relocated clean value
+        template <typename T>
+        size_t find_first_pointer_difference(const uint8_t* clean_data, const uint8_t* runtime_data, const T delta, const size_t count)
+        {
+            size_t index = 0;
+
+#ifdef PATCH_FINDER_X64
+            constexpr auto lanes = sizeof(__m128i) / sizeof(T);
+            const auto deltas = sizeof(T) == sizeof(uint64_t) ? _mm_set1_epi64x(static_cast<int64_t>(delta))
+                                                              : _mm_set1_epi32(static_cast<int32_t>(delta));
+
+            for (; index + lanes <= count; index += lanes)
+            {
+                const auto offset = index * sizeof(T);
+                const auto clean = _mm_loadu_si128(reinterpret_cast<const __m128i*>(clean_data + offset));
+                const auto runtime = _mm_loadu_si128(reinterpret_cast<const __m128i*>(runtime_data + offset));
+                const auto relocated = sizeof(T) == sizeof(uint64_t) ? _mm_add_epi64(clean, deltas) : _mm_add_epi32(clean, deltas);
+
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(relocated, runtime)) != 0xFFFF)
+                {
+                    break;
+                }
+            }
+#endif
+
+            for (; index < count; ++index)
+            {
+                const auto offset = index * sizeof(T);
+                if (static_cast<T>(load_slot<T>(clean_data + offset) + delta) != load_slot<T>(runtime_data + offset))
+                {
+                    return index;
+                }
+            }
+
+            return count;
+        }
+
+        // The clean values and the runtime data of the run start at the first slot
+        template <typename T>
+        void compare_slot_run(const uint8_t* clean_data, const uint8_t* runtime, const int64_t delta, const uint64_t address,
+                              const size_t count, std::vector<pointer_patch>& patches)
+        {
+            const auto slot_delta = static_cast<T>(delta);
+
+            size_t index = 0;
+
+            while (index < count)
+            {
+                index += find_first_pointer_difference<T>(clean_data + (index * sizeof(T)), runtime + (index * sizeof(T)), slot_delta,
+                                                          count - index);
+                if (index >= count)
+                {
+                    break;
+                }
+
+                const auto slot_offset = index * sizeof(T);
+                patches.emplace_back(pointer_patch{
+                    .address = address + slot_offset,
+                    .size = sizeof(T),
+                    .target = load_slot<T>(runtime + slot_offset),
+                    .expected = static_cast<T>(load_slot<T>(clean_data + slot_offset) + slot_delta),
+                });
+
+                ++index;
+            }
+        }
+
+        // Chunks never split a relocated slot
+        std::vector<size_t> get_chunk_boundaries(const clean_section& section, const diff_range range, const size_t chunk_size)
+        {
+            std::vector<size_t> boundaries{range.begin};
+
+            for (auto boundary = range.begin + chunk_size; chunk_size > 0 && boundary < range.end;
+                 boundary = boundaries.back() + chunk_size)
+            {
+                boundary = align_to_relocations(section, {boundary, range.end}).begin;
+                if (boundary >= range.end)
+                {
+                    break;
+                }
+
+                boundaries.emplace_back(boundary);
+            }
+
+            boundaries.emplace_back(range.end);
+            return boundaries;
+        }
+
+        // Returns the slot that contains the offset without starting at it
+        const relocation_entry* find_slot_containing(const clean_section& section, const size_t offset)
+        {
+            const auto relocation = std::ranges::upper_bound(section.relocations, section.rva + offset, {}, &relocation_entry::rva);
+            if (relocation == section.relocations.begin())
+            {
+                return nullptr;
+            }
+
+            const auto& previous = *std::prev(relocation);
+            const auto slot = static_cast<size_t>(previous.rva - section.rva);
+
+            if (slot < offset && slot + previous.size > offset)
+            {
+                return &previous;
+            }
+
+            return nullptr;
+        }
+    }
+
+    bool is_diff_kernel_supported(const diff_kernel_type type)
+    {
+        switch (type)
+        {
+        case diff_kernel_type::word:
+            return true;
+#ifdef PATCH_FINDER_X64
+        case diff_kernel_type::sse2:
+            return true;
+        case diff_kernel_type::avx2:
+            return is_avx2_supported();
+#endif
+        default:
+            return false;
+        }
+    }
+
+    void set_diff_kernel(const diff_kernel_type type)
+    {
+        if (!is_diff_kernel_supported(type))
+        {
+            throw std::runtime_error("Diff kernel is not supported by this CPU");
+        }
+
+        get_diff_kernel() = get_kernel_functions(type);
+    }
+
+    std::optional<std::vector<patch>> find_differences(const std::span<const uint8_t> clean_data,
+                                                       const std::span<const uint8_t> runtime_data, const uint64_t base_address,
+                                                       const size_t max_differences)
+    {
+        const auto size = std::min(clean_data.size(), runtime_data.size());
+
+        run_builder builder{base_address, max_differences};
+        if (!builder.compare(clean_data.data(), runtime_data.data(), 0, size))
+        {
+            return std::nullopt;
+        }
+
+        return builder.finish(size);
+    }
+
+    std::optional<std::vector<patch>> find_differences(const clean_section& section, const std::span<const uint8_t> runtime_data,
+                                                       const int64_t delta, const uint64_t base_address, const size_t max_differences)
+    {
+        const auto size = std::min(section.data.size(), runtime_data.size());
+        return find_differences_in_range(section, runtime_data, delta, base_address, 0, size, max_differences);
+    }
+
+    std::optional<std::vector<patch>> find_differences(const clean_section& section, const std::span<const uint8_t> runtime_data,
+                                                       const int64_t delta, const uint64_t base_address, const diff_range range,
+                                                       const size_t max_differences)
+    {
+        const auto size = std::min(section.data.size(), runtime_data.size());
+        if (range.begin > range.end || range.end > size)
+        {
+            return std::nullopt;
+        }
+
+        return find_differences_in_range(section, runtime_data, delta, base_address, range.begin, range.end, max_differences);
+    }
+
+    std::optional<std::vector<patch>> find_differences(utils::thread_pool& pool, const clean_section& section,
+                                                       const std::span<const uint8_t> runtime_data, const int64_t delta,
+                                                       const uint64_t base_address, const diff_range range, const size_t max_differences,
+                                                       const size_t chunk_size)
+    {
+        const auto size = std::min(section.data.size(), runtime_data.size());
+        if (range.begin > range.end || range.end > size)
+        {
+            return std::nullopt;
+        }
+
+        const auto boundaries = get_chunk_boundaries(section, range, chunk_size);
+        const auto chunk_count = boundaries.size() - 1;
+
+        std::atomic_bool budget_exceeded{false};
+        std::vector<std::optional<std::vector<patch>>> chunk_patches(chunk_count);
+
+        pool.parallel_for(chunk_count, [&](const size_t chunk) {
+            if (budget_exceeded)
+            {
+                return;
+            }
+
+            chunk_patches[chunk] = find_differences_in_range(section, runtime_data, delta, base_address, boundaries[chunk],
+                                                             boundaries[chunk + 1], max_differences);
+
+            if (!chunk_patches[chunk])
+            {
+                budget_exceeded = true;
+            }
+        });
+
+        if (budget_exceeded)
+        {
+            return std::nullopt;
+        }
+
+        std::vector<patch> patches{};
+        size_t differences = 0;
+
+        for (const auto& chunk : chunk_patches)
+        {
+            for (const auto& patch : *chunk)
+            {
+                differences += patch.length;
+            }
+
+            append_patches(patches, *chunk);
+        }
+
+        if (differences > max_differences)
+        {
+            return std::nullopt;
+        }
+
+        return patches;
+    }
+
+    diff_range align_to_relocations(const clean_section& section, diff_range range)
+    {
+        if (const auto* slot = find_slot_containing(section, range.begin))
+        {
+            range.begin = static_cast<size_t>(slot->rva - section.rva) + slot->size;
+        }
+
+        if (const auto* slot = find_slot_containing(section, range.end))
+        {
+            range.end = static_cast<size_t>(slot->rva - section.rva);
+        }
+
+        range.end = std::max(range.begin, range.end);
+        return range;
+    }
+
+    void append_patches(std::vector<patch>& patches, const std::span<const patch> new_patches)
+    {
+        for (const auto& patch : new_patches)
+        {
+            if (!patches.empty() && patches.back().address + patches.back().length == patch.address)
+            {
+                patches.back().length += patch.length;
+            }
+            else
+            {
+                patches.emplace_back(patch);
+            }
+        }
+    }
+
+    std::vector<pointer_patch> find_pointer_differences(const std::span<const relocation_entry> slots,
+                                                        const std::span<const uint8_t> clean_values,
+                                                        const std::span<const uint8_t> runtime_data, const uint32_t runtime_rva,
+                                                        const int64_t delta, const uint64_t base_address)
+    {
+        std::vector<pointer_patch> patches{};
+        size_t value_offset = 0;
+
+        const uint64_t data_end = static_cast<uint64_t>(runtime_rva) + runtime_data.size();
+
+        for (size_t i = 0; i < slots.size();)
+        {
+            const size_t slot_size = slots[i].size;
+            const uint64_t run_rva = slots[i].rva;
+
+            // Slots are sorted and don't overlap, so a run continues as long as the next slot starts where the last one ended
+            size_t count = 1;
+            while (i + count < slots.size() && slots[i + count].size == slot_size &&
+                   slots[i + count].rva == slots[i].rva + (count * slot_size))
+            {
+                ++count;
+            }
+
+            i += count;
+
+            const auto run_value_offset = value_offset;
+            value_offset += count * slot_size;
+
+            // Slots that the runtime data or the clean values don't cover are skipped, everything else is still compared
+            const auto first = run_rva >= runtime_rva ? 0 : static_cast<size_t>((runtime_rva - run_rva + slot_size - 1) / slot_size);
+            const auto covered_slots = run_rva < data_end ? static_cast<size_t>((data_end - run_rva) / slot_size) : 0;
+            const auto known_values = run_value_offset < clean_values.size() ? (clean_values.size() - run_value_offset) / slot_size : 0;
+            const auto last = std::min({count, covered_slots, known_values});
+
+            if (first >= last)
+            {
+                continue;
+            }
+
+            const auto offset = static_cast<size_t>(run_rva - runtime_rva) + (first * slot_size);
+            const auto* clean = clean_values.data() + run_value_offset + (first * slot_size);
+            const auto* runtime = runtime_data.data() + offset;
+            const auto address = base_address + runtime_rva + offset;
+
+            if (slot_size == sizeof(uint64_t))
+            {
+                compare_slot_run<uint64_t>(clean, runtime, delta, address, last - first, patches);
+            }
+            else
+            {
+                compare_slot_run<uint32_t>(clean, runtime, delta, address, last - first, patches);
+            }
+        }
+
+        return patches;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <span>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <optional>
+
+#include "clean_image.hpp"
+#include "thread_pool.hpp"
+
+namespace momo
+{
+    struct patch
+    {
+        uint64_t address{};
+        uint64_t length{};
+    };
+
+    /*****************************************************************************
+     * Collects all runs of differing bytes. Equal blocks are skipped using the
+     * widest compare the CPU supports, which is detected once at runtime.
+     * The walk stops as soon as more than max_differences bytes differ, in
+     * which case no result is returned.
+     ****************************************************************************/
+
+    std::optional<std::vector<patch>> find_differences(std::span<const uint8_t> clean_data, std::span<const uint8_t> runtime_data,
+                                                       uint64_t base_address,
+                                                       size_t max_differences = std::numeric_limits<size_t>::max());
+
+    enum class diff_kernel_type
+    {
+        word,
+        sse2,
+        avx2,
+    };
+
+    bool is_diff_kernel_supported(diff_kernel_type type);
+
+    // Replaces the kernel that was detected at runtime, so tests and benchmarks can cover all of them.
+    // Must not be called while diffs are running.
+    void set_diff_kernel(diff_kernel_type type);
+
+    struct diff_range
+    {
+        size_t begin{};
+        size_t end{};
+    };
+
+    // Relocated slots of the section are compared as file value + delta
+    std::optional<std::vector<patch>> find_differences(const clean_section& section, std::span<const uint8_t> runtime_data,
+                                                       int64_t delta, uint64_t base_address,
+                                                       size_t max_differences = std::numeric_limits<size_t>::max());
+
+    // Only compares the given range of the section, which must not cut through a relocated slot
+    std::optional<std::vector<patch>> find_differences(const clean_section& section, std::span<const uint8_t> runtime_data,
+                                                       int64_t delta, uint64_t base_address, diff_range range, size_t max_differences);
+
+    // Same result as above, but chunks of chunk_size bytes are diffed in parallel and stitched together
+    std::optional<std::vector<patch>> find_differences(utils::thread_pool& pool, const clean_section& section,
+                                                       std::span<const uint8_t> runtime_data, int64_t delta, uint64_t base_address,
+                                                       diff_range range, size_t max_differences, size_t chunk_size);
+
+    // Shrinks the range so that it doesn't cut through a relocated slot
+    diff_range align_to_relocations(const clean_section& section, diff_range range);
+
+    struct pointer_patch
+    {
+        uint64_t address{};
+        uint64_t size{};
+
+        // Where the slot points now and where it would point if it was unchanged
+        uint64_t target{};
+        uint64_t expected{};
+    };
+
+    /*****************************************************************************
+     * Compares pointer slots as file value + delta. The clean values are the
+     * file bytes of the slots back to back, the runtime data starts at
+     * runtime_rva. Slots that either of them doesn't cover are skipped.
+     * Runs of adjacent slots of the same size, like vtables and function
+     * pointer tables, are compared several slots at a time with SSE2.
+     * Everything between the slots is ignored.
+     ****************************************************************************/
+
+    std::vector<pointer_patch> find_pointer_differences(std::span<const relocation_entry> slots, std::span<const uint8_t> clean_values,
+                                                        std::span<const uint8_t> runtime_data, uint32_t runtime_rva, int64_t delta,
+                                                        uint64_t base_address);
+
+    // Runs that continue exactly where the last one ended are merged
+    void append_patches(std::vector<patch>& patches, std::span<const patch> new_patches);
+}
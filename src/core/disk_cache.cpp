@@ -0,0 +1,349 @@
+#include "disk_cache.hpp"
+#include "buffer_accessor.hpp"
+
+#include <array>
+#include <cstdio>
+#include <optional>
+#include <thread>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+
+namespace momo
+{
+    namespace
+    {
+        constexpr uint32_t cache_magic = 0x43494650; // PFIC
+        constexpr uint32_t cache_version = 3;
+
+        constexpr size_t data_alignment = 16;
+
+        struct cache_header
+        {
+            uint32_t magic{};
+            uint32_t version{};
+            uint64_t file_size{};
+            int64_t last_write_time{};
+            uint32_t time_date_stamp{};
+            uint32_t size_of_image{};
+            uint64_t image_base{};
+            uint32_t section_count{};
+            uint32_t path_length{};
+
+            // Only stored if the image was parsed for pointer scans, the slots are followed by their values
+            uint32_t has_pointer_slots{};
+            uint32_t pointer_slot_count{};
+            uint64_t pointer_slots_offset{};
+        };
+
+        struct cache_section
+        {
+            uint32_t rva{};
+            uint32_t relocation_count{};
+            uint64_t data_offset{};
+            uint64_t data_size{};
+            uint64_t relocation_offset{};
+        };
+
+        struct cache_relocation
+        {
+            uint32_t rva{};
+            uint32_t size{};
+        };
+
+        uint64_t align_up(const uint64_t value, const uint64_t alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        // FNV-1a, as the name must stay the same across builds
+        uint64_t hash_path(const std::string& path)
+        {
+            uint64_t hash = 0xcbf29ce484222325;
+
+            for (const auto c : path)
+            {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 0x100000001b3;
+            }
+
+            return hash;
+        }
+
+        std::filesystem::path get_entry_path(const std::filesystem::path& cache_directory, const std::string& path)
+        {
+            std::array<char, 17> name{};
+            snprintf(name.data(), name.size(), "%016llx", static_cast<unsigned long long>(hash_path(path)));
+
+            return cache_directory / (std::string(name.data()) + ".bin");
+        }
+
+        bool is_valid_section(const clean_section& section)
+        {
+            uint64_t previous_end = section.rva;
+            const auto section_end = static_cast<uint64_t>(section.rva) + section.data.size();
+
+            for (const auto& relocation : section.relocations)
+            {
+                const auto slot_end = static_cast<uint64_t>(relocation.rva) + relocation.size;
+                if (relocation.rva < previous_end || slot_end > section_end)
+                {
+                    return false;
+                }
+
+                previous_end = slot_end;
+            }
+
+            return true;
+        }
+
+        std::optional<clean_section> read_section(const utils::safe_buffer_accessor<const std::byte>& buffer, const cache_section& entry)
+        {
+            const auto data_size = static_cast<size_t>(entry.data_size);
+            const auto* data = buffer.get_pointer_for_range(static_cast<size_t>(entry.data_offset), data_size);
+
+            // Counts come from the file, so the tables are checked to lie within it before anything is allocated for them
+            const auto relocation_offset = static_cast<size_t>(entry.relocation_offset);
+            buffer.validate(relocation_offset, entry.relocation_count * sizeof(cache_relocation));
+
+            clean_section section{};
+            section.rva = entry.rva;
+            section.data = {reinterpret_cast<const uint8_t*>(data), data_size};
+            section.relocations.reserve(entry.relocation_count);
+
+            const auto relocations = buffer.as<cache_relocation>(relocation_offset);
+
+            for (size_t i = 0; i < entry.relocation_count; ++i)
+            {
+                const auto relocation = relocations.get(i);
+                section.relocations.emplace_back(relocation.rva, static_cast<uint8_t>(relocation.size));
+            }
+
+            if (!is_valid_section(section))
+            {
+                return std::nullopt;
+            }
+
+            return section;
+        }
+
+        pointer_slot_table read_pointer_slots(const utils::safe_buffer_accessor<const std::byte>& buffer, const cache_header& header)
+        {
+            const auto offset = static_cast<size_t>(header.pointer_slots_offset);
+            buffer.validate(offset, header.pointer_slot_count * sizeof(cache_relocation));
+
+            const auto relocations = buffer.as<cache_relocation>(offset);
+
+            pointer_slot_table table{};
+            table.slots.reserve(header.pointer_slot_count);
+
+            size_t value_size = 0;
+            for (size_t i = 0; i < header.pointer_slot_count; ++i)
+            {
+                const auto relocation = relocations.get(i);
+                table.slots.emplace_back(relocation.rva, static_cast<uint8_t>(relocation.size));
+                value_size += relocation.size;
+            }
+
+            const auto values_offset = offset + (header.pointer_slot_count * sizeof(cache_relocation));
+            const auto* values = reinterpret_cast<const uint8_t*>(buffer.get_pointer_for_range(values_offset, value_size));
+            table.values.assign(values, values + value_size);
+
+            return table;
+        }
+
+        std::shared_ptr<loaded_image> read_entry(utils::mapped_file file, const std::string& path, const file_identity& file_id,
+                                                 const image_identity& image_id, const bool with_pointer_slots)
+        {
+            const utils::safe_buffer_accessor<const std::byte> buffer{file.get_data()};
+            const auto header = buffer.as<cache_header>(0).get();
+
+            const auto is_current = header.magic == cache_magic && header.version == cache_version && header.file_size == file_id.size &&
+                                    header.last_write_time == file_id.last_write_time && header.time_date_stamp == image_id.time_date_stamp &&
+                                    header.size_of_image == image_id.size_of_image && header.path_length == path.size() &&
+                                    (header.has_pointer_slots || !with_pointer_slots);
+            if (!is_current)
+            {
+                return {};
+            }
+
+            const auto* stored_path = buffer.get_pointer_for_range(sizeof(cache_header), path.size());
+            if (memcmp(stored_path, path.data(), path.size()) != 0)
+            {
+                return {};
+            }
+
+            const auto sections_offset = static_cast<size_t>(align_up(sizeof(cache_header) + path.size(), alignof(cache_section)));
+            buffer.validate(sections_offset, header.section_count * sizeof(cache_section));
+
+            auto image = std::make_shared<loaded_image>();
+            image->image.image_base = header.image_base;
+            image->image.identity = image_id;
+            image->image.sections.reserve(header.section_count);
+
+            const auto sections = buffer.as<cache_section>(sections_offset);
+
+            for (size_t i = 0; i < header.section_count; ++i)
+            {
+                auto section = read_section(buffer, sections.get(i));
+                if (!section)
+                {
+                    return {};
+                }
+
+                image->image.sections.emplace_back(std::move(*section));
+            }
+
+            // The slots are small, so they are loaded whenever they are stored
+            if (header.has_pointer_slots)
+            {
+                image->image.pointer_slots = read_pointer_slots(buffer, header);
+            }
+
+            image->file = std::move(file);
+            return image;
+        }
+
+        template <typename T>
+        void write_object(std::vector<std::byte>& buffer, const size_t offset, const T& object)
+        {
+            memcpy(buffer.data() + offset, &object, sizeof(object));
+        }
+
+        std::vector<std::byte> serialize_image(const std::string& path, const file_identity& file, const clean_image& image)
+        {
+            const auto sections_offset = align_up(sizeof(cache_header) + path.size(), alignof(cache_section));
+            auto offset = sections_offset + (image.sections.size() * sizeof(cache_section));
+
+            std::vector<cache_section> sections{};
+            sections.reserve(image.sections.size());
+
+            for (const auto& section : image.sections)
+            {
+                auto& entry = sections.emplace_back();
+                entry.rva = section.rva;
+                entry.relocation_count = static_cast<uint32_t>(section.relocations.size());
+                entry.data_offset = align_up(offset, data_alignment);
+                entry.data_size = section.data.size();
+                entry.relocation_offset = align_up(entry.data_offset + entry.data_size, alignof(cache_relocation));
+
+                offset = entry.relocation_offset + (section.relocations.size() * sizeof(cache_relocation));
+            }
+
+            const auto* pointer_slots = image.pointer_slots ? &*image.pointer_slots : nullptr;
+            const auto pointer_slots_offset = align_up(offset, alignof(cache_relocation));
+
+            if (pointer_slots)
+            {
+                offset = pointer_slots_offset + (pointer_slots->slots.size() * sizeof(cache_relocation)) + pointer_slots->values.size();
+            }
+
+            std::vector<std::byte> buffer(static_cast<size_t>(offset));
+
+            write_object(buffer, 0,
+                          cache_header{
+                              .magic = cache_magic,
+                              .version = cache_version,
+                              .file_size = file.size,
+                              .last_write_time = file.last_write_time,
+                              .time_date_stamp = image.identity.time_date_stamp,
+                              .size_of_image = image.identity.size_of_image,
+                              .image_base = image.image_base,
+                              .section_count = static_cast<uint32_t>(image.sections.size()),
+                              .path_length = static_cast<uint32_t>(path.size()),
+                              .has_pointer_slots = pointer_slots != nullptr,
+                              .pointer_slot_count = pointer_slots ? static_cast<uint32_t>(pointer_slots->slots.size()) : 0,
+                              .pointer_slots_offset = pointer_slots_offset,
+                          });
+
+            memcpy(buffer.data() + sizeof(cache_header), path.data(), path.size());
+
+            for (size_t i = 0; i < sections.size(); ++i)
+            {
+                const auto& section = image.sections[i];
+                const auto& entry = sections[i];
+
+                write_object(buffer, static_cast<size_t>(sections_offset + (i * sizeof(cache_section))), entry);
+                memcpy(buffer.data() + entry.data_offset, section.data.data(), section.data.size());
+
+                for (size_t j = 0; j < section.relocations.size(); ++j)
+                {
+                    const auto& relocation = section.relocations[j];
+                    write_object(buffer, static_cast<size_t>(entry.relocation_offset + (j * sizeof(cache_relocation))),
+                                  cache_relocation{relocation.rva, relocation.size});
+                }
+            }
+
+            if (pointer_slots)
+            {
+                for (size_t i = 0; i < pointer_slots->slots.size(); ++i)
+                {
+                    const auto& slot = pointer_slots->slots[i];
+                    write_object(buffer, static_cast<size_t>(pointer_slots_offset + (i * sizeof(cache_relocation))),
+                                 cache_relocation{slot.rva, slot.size});
+                }
+
+                const auto values_offset = pointer_slots_offset + (pointer_slots->slots.size() * sizeof(cache_relocation));
+                memcpy(buffer.data() + values_offset, pointer_slots->values.data(), pointer_slots->values.size());
+            }
+
+            return buffer;
+        }
+    }
+
+    std::shared_ptr<loaded_image> load_cached_image(const std::filesystem::path& cache_directory, const std::filesystem::path& path,
+                                                    const file_identity& file, const image_identity& image, const bool with_pointer_slots)
+    {
+        const auto key = path.string();
+
+        utils::mapped_file entry{get_entry_path(cache_directory, key)};
+        if (entry.empty())
+        {
+            return {};
+        }
+
+        try
+        {
+            return read_entry(std::move(entry), key, file, image, with_pointer_slots);
+        }
+        catch (...)
+        {
+            // Broken entries are replaced with a freshly parsed image
+            return {};
+        }
+    }
+
+    void store_cached_image(const std::filesystem::path& cache_directory, const std::filesystem::path& path, const file_identity& file,
+                            const clean_image& image)
+    {
+        const auto key = path.string();
+        const auto data = serialize_image(key, file, image);
+
+        std::error_code ec{};
+        std::filesystem::create_directories(cache_directory, ec);
+
+        // Written under a temporary name, so that readers never see partial entries
+        const auto entry_path = get_entry_path(cache_directory, key);
+        auto temp_path = entry_path;
+        temp_path += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+
+        {
+            std::ofstream stream{temp_path, std::ios::binary | std::ios::trunc};
+            stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+            if (!stream)
+            {
+                stream.close();
+                std::filesystem::remove(temp_path, ec);
+                return;
+            }
+        }
+
+        std::filesystem::rename(temp_path, entry_path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(temp_path, ec);
+        }
+    }
+}
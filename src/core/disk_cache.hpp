@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+#include <filesystem>
+
+#include "loaded_image.hpp"
+
+namespace momo
+{
+    /*****************************************************************************
+     * Persists parsed clean images in a cache directory. An entry holds the
+     * section bytes and relocations of one module file in a flat layout, so
+     * loading it is a single file mapping. Entries are only used while size,
+     * modification time, TimeDateStamp and SizeOfImage still match the file.
+     * Pointer slots are only stored if the image was parsed with them, entries
+     * without them are a miss for pointer scans and get replaced.
+     ****************************************************************************/
+
+    std::shared_ptr<loaded_image> load_cached_image(const std::filesystem::path& cache_directory, const std::filesystem::path& path,
+                                                    const file_identity& file, const image_identity& image, bool with_pointer_slots);
+
+    void store_cached_image(const std::filesystem::path& cache_directory, const std::filesystem::path& path, const file_identity& file,
+                            const clean_image& image);
+}
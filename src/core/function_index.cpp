@@ -0,0 +1,51 @@
+#include "function_index.hpp"
+
+#include <limits>
+#include <algorithm>
+
+namespace momo
+{
+    void function_index::add(const uint32_t rva, const std::string_view name)
+    {
+        this->functions_.push_back({
+            .rva = rva,
+            .name_offset = static_cast<uint32_t>(this->names_.size()),
+            .name_length = static_cast<uint32_t>(name.size()),
+        });
+
+        this->names_.append(name);
+    }
+
+    void function_index::finalize()
+    {
+        std::ranges::stable_sort(this->functions_, [](const function_entry& left, const function_entry& right) {
+            if (left.rva != right.rva)
+            {
+                return left.rva < right.rva;
+            }
+
+            return left.name_length > 0 && right.name_length == 0;
+        });
+
+        const auto duplicates = std::ranges::unique(this->functions_, {}, &function_entry::rva);
+        this->functions_.erase(duplicates.begin(), duplicates.end());
+        this->functions_.shrink_to_fit();
+    }
+
+    std::optional<function_symbol> function_index::find(const uint32_t rva) const
+    {
+        const auto next = std::ranges::upper_bound(this->functions_, rva, {}, &function_entry::rva);
+        if (next == this->functions_.begin())
+        {
+            return std::nullopt;
+        }
+
+        const auto& function = *(next - 1);
+
+        return function_symbol{
+            .rva = function.rva,
+            .end_rva = next != this->functions_.end() ? next->rva : std::numeric_limits<uint32_t>::max(),
+            .name = std::string_view(this->names_).substr(function.name_offset, function.name_length),
+        };
+    }
+}
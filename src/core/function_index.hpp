@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace momo
+{
+    struct function_symbol
+    {
+        uint32_t rva{};
+
+        // Start of the next known function, which bounds this one
+        uint32_t end_rva{};
+
+        // Empty for functions that are only known from the exception directory
+        std::string_view name{};
+    };
+
+    /*****************************************************************************
+     * Function starts of an image, sorted by rva. Names are stored in a single
+     * buffer. Starts are collected in any order and sorted once by finalize,
+     * which keeps one entry per rva and prefers named ones. Lookups map an
+     * rva to the nearest start at or below it by binary search.
+     ****************************************************************************/
+
+    class function_index
+    {
+      public:
+        void add(uint32_t rva, std::string_view name = {});
+        void finalize();
+
+        std::optional<function_symbol> find(uint32_t rva) const;
+
+        size_t size() const
+        {
+            return this->functions_.size();
+        }
+
+        bool empty() const
+        {
+            return this->functions_.empty();
+        }
+
+        uint32_t get_rva(const size_t index) const
+        {
+            return this->functions_[index].rva;
+        }
+
+      private:
+        struct function_entry
+        {
+            uint32_t rva{};
+            uint32_t name_offset{};
+            uint32_t name_length{};
+        };
+
+        std::vector<function_entry> functions_{};
+        std::string names_{};
+    };
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <bit>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+namespace momo::utils
+{
+    // Addresses are aligned and clustered, so their bits have to be mixed before they can index a table
+    struct integer_hash
+    {
+        size_t operator()(uint64_t value) const
+        {
+            value ^= value >> 33;
+            value *= 0xFF51AFD7ED558CCD;
+            value ^= value >> 33;
+            value *= 0xC4CEB9FE1A85EC53;
+            value ^= value >> 33;
+
+            return static_cast<size_t>(value);
+        }
+    };
+
+    /*****************************************************************************
+     * Open addressing hash set with linear probing. It is filled once and then
+     * only queried, so there is no removal. The table is kept at most half
+     * full, which keeps probe sequences short, and every key is stored next
+     * to its occupancy flag in a single array, so a lookup usually touches a
+     * single cache line.
+     ****************************************************************************/
+
+    template <typename Key, typename Hash = integer_hash>
+    class hash_set
+    {
+      public:
+        void reserve(const size_t count)
+        {
+            const auto capacity = std::bit_ceil(std::max<size_t>(count * 2, 16));
+            if (capacity > this->slots_.size())
+            {
+                this->rehash(capacity);
+            }
+        }
+
+        // Returns whether the key was new
+        bool insert(const Key& key)
+        {
+            if ((this->size_ + 1) * 2 > this->slots_.size())
+            {
+                this->rehash(std::max<size_t>(this->slots_.size() * 2, 16));
+            }
+
+            auto& slot = this->slots_[this->find_slot(key)];
+            if (slot.used)
+            {
+                return false;
+            }
+
+            slot = {key, true};
+            ++this->size_;
+
+            return true;
+        }
+
+        bool contains(const Key& key) const
+        {
+            return !this->slots_.empty() && this->slots_[this->find_slot(key)].used;
+        }
+
+        size_t size() const
+        {
+            return this->size_;
+        }
+
+        bool empty() const
+        {
+            return this->size_ == 0;
+        }
+
+        void clear()
+        {
+            this->slots_.clear();
+            this->size_ = 0;
+        }
+
+      private:
+        struct slot
+        {
+            Key key{};
+            bool used{false};
+        };
+
+        std::vector<slot> slots_{};
+        size_t size_{};
+
+        // Either the slot holding the key or the free slot where it belongs
+        size_t find_slot(const Key& key) const
+        {
+            const auto mask = this->slots_.size() - 1;
+            auto index = Hash{}(key) & mask;
+
+            while (this->slots_[index].used && !(this->slots_[index].key == key))
+            {
+                index = (index + 1) & mask;
+            }
+
+            return index;
+        }
+
+        void rehash(const size_t capacity)
+        {
+            auto slots = std::move(this->slots_);
+            this->slots_.assign(capacity, slot{});
+
+            for (const auto& entry : slots)
+            {
+                if (entry.used)
+                {
+                    this->slots_[this->find_slot(entry.key)] = entry;
+                }
+            }
+        }
+    };
+}
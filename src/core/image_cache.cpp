@@ -0,0 +1,148 @@
+#include "image_cache.hpp"
+#include "pe_parser.hpp"
+#include "disk_cache.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        std::shared_ptr<const loaded_image> load_image(const std::filesystem::path& path, const file_identity& identity,
+                                                       const std::filesystem::path& cache_directory, const bool with_pointer_slots)
+        {
+            utils::mapped_file file{path};
+            if (file.empty())
+            {
+                return {};
+            }
+
+            const utils::safe_buffer_accessor<const std::byte> buffer{file.get_data()};
+
+            std::shared_ptr<loaded_image> image{};
+
+            if (!cache_directory.empty())
+            {
+                image = load_cached_image(cache_directory, path, identity, get_image_identity(buffer), with_pointer_slots);
+            }
+
+            if (!image)
+            {
+                image = std::make_shared<loaded_image>();
+                image->image = parse_pe_file(buffer, with_pointer_slots);
+                image->file = std::move(file);
+
+                if (!cache_directory.empty())
+                {
+                    store_cached_image(cache_directory, path, identity, image->image);
+                }
+            }
+
+            // Exports, imports and unwind data are cheap to parse, so they are not stored in the disk cache.
+            // The buffer is still valid here, moving the mapped file doesn't move the mapping.
+            try
+            {
+                image->functions = parse_function_index(buffer);
+            }
+            catch (...)
+            {
+                // Just ignore all issues
+            }
+
+            try
+            {
+                image->tables = parse_address_tables(buffer);
+            }
+            catch (...)
+            {
+                // Just ignore all issues
+            }
+
+            return image;
+        }
+    }
+
+    std::optional<file_identity> get_file_identity(const std::filesystem::path& path)
+    {
+        std::error_code ec{};
+        const auto size = std::filesystem::file_size(path, ec);
+        if (ec)
+        {
+            return std::nullopt;
+        }
+
+        const auto last_write_time = std::filesystem::last_write_time(path, ec);
+        if (ec)
+        {
+            return std::nullopt;
+        }
+
+        return file_identity{
+            .size = size,
+            .last_write_time = last_write_time.time_since_epoch().count(),
+        };
+    }
+
+    std::optional<image_headers> read_image_headers(const std::filesystem::path& path)
+    {
+        const utils::mapped_file file{path};
+        if (file.empty())
+        {
+            return std::nullopt;
+        }
+
+        try
+        {
+            return parse_image_headers(utils::safe_buffer_accessor<const std::byte>{file.get_data()});
+        }
+        catch (...)
+        {
+            return std::nullopt;
+        }
+    }
+
+    std::shared_ptr<const loaded_image> image_cache::get_image(const std::filesystem::path& path, const bool with_pointer_slots)
+    {
+        const auto identity = get_file_identity(path);
+        if (!identity)
+        {
+            return {};
+        }
+
+        const auto key = path.string();
+        std::filesystem::path cache_directory{};
+
+        {
+            std::scoped_lock lock{this->mutex_};
+            cache_directory = this->cache_directory_;
+
+            const auto entry = this->images_.find(key);
+            if (entry != this->images_.end() && entry->second.identity == *identity &&
+                (entry->second.image->image.pointer_slots || !with_pointer_slots))
+            {
+                return entry->second.image;
+            }
+        }
+
+        auto image = load_image(path, *identity, cache_directory, with_pointer_slots);
+        if (!image)
+        {
+            return {};
+        }
+
+        std::scoped_lock lock{this->mutex_};
+        this->images_[key] = {*identity, image};
+
+        return image;
+    }
+
+    void image_cache::clear()
+    {
+        std::scoped_lock lock{this->mutex_};
+        this->images_.clear();
+    }
+
+    void image_cache::set_cache_directory(std::filesystem::path directory)
+    {
+        std::scoped_lock lock{this->mutex_};
+        this->cache_directory_ = std::move(directory);
+    }
+}
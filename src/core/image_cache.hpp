@@ -0,0 +1,43 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <filesystem>
+#include <unordered_map>
+
+#include "loaded_image.hpp"
+
+namespace momo
+{
+    /*****************************************************************************
+     * Clean images don't depend on the address a module is loaded at, so a
+     * parsed file is shared by every module that maps it. Entries are dropped
+     * once the file on disk changes.
+     * If a cache directory is set, parsed images are also persisted there and
+     * loaded from it on later runs instead of parsing the file again.
+     * Pointer slots are only parsed for callers that ask for them. Entries
+     * without them are replaced once they are needed.
+     ****************************************************************************/
+
+    class image_cache
+    {
+      public:
+        std::shared_ptr<const loaded_image> get_image(const std::filesystem::path& path, bool with_pointer_slots = false);
+        void clear();
+
+        // An empty path disables the persistent cache
+        void set_cache_directory(std::filesystem::path directory);
+
+      private:
+        struct entry
+        {
+            file_identity identity{};
+            std::shared_ptr<const loaded_image> image{};
+        };
+
+        std::mutex mutex_{};
+        std::unordered_map<std::string, entry> images_{};
+        std::filesystem::path cache_directory_{};
+    };
+}
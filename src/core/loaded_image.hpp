@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <filesystem>
+
+#include "clean_image.hpp"
+#include "mapped_file.hpp"
+#include "address_tables.hpp"
+#include "function_index.hpp"
+
+namespace momo
+{
+    // The sections of the image point into the mapped file
+    struct loaded_image
+    {
+        utils::mapped_file file{};
+        clean_image image{};
+        function_index functions{};
+        address_tables tables{};
+    };
+
+    struct file_identity
+    {
+        uint64_t size{};
+        int64_t last_write_time{};
+
+        bool operator==(const file_identity&) const = default;
+    };
+
+    std::optional<file_identity> get_file_identity(const std::filesystem::path& path);
+
+    // Only maps the file and parses its headers, without loading the sections
+    std::optional<image_headers> read_image_headers(const std::filesystem::path& path);
+}
@@ -0,0 +1,134 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace momo::utils
+{
+    namespace
+    {
+#ifdef _WIN32
+        std::span<std::byte> map_file(const std::filesystem::path& path)
+        {
+            auto* file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                     FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                return {};
+            }
+
+            LARGE_INTEGER file_size{};
+            if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0)
+            {
+                CloseHandle(file);
+                return {};
+            }
+
+            auto* mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            CloseHandle(file);
+
+            if (!mapping)
+            {
+                return {};
+            }
+
+            auto* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+
+            if (!view)
+            {
+                return {};
+            }
+
+            return {static_cast<std::byte*>(view), static_cast<size_t>(file_size.QuadPart)};
+        }
+
+        void unmap_file(const std::span<std::byte> data)
+        {
+            UnmapViewOfFile(data.data());
+        }
+#else
+        std::span<std::byte> map_file(const std::filesystem::path& path)
+        {
+            const auto fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                return {};
+            }
+
+            struct stat file_info{};
+            if (fstat(fd, &file_info) != 0 || file_info.st_size <= 0)
+            {
+                close(fd);
+                return {};
+            }
+
+            const auto size = static_cast<size_t>(file_info.st_size);
+            auto* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+
+            if (view == MAP_FAILED)
+            {
+                return {};
+            }
+
+            return {static_cast<std::byte*>(view), size};
+        }
+
+        void unmap_file(const std::span<std::byte> data)
+        {
+            munmap(data.data(), data.size());
+        }
+#endif
+    }
+
+    mapped_file::mapped_file(const std::filesystem::path& path)
+    {
+        const auto data = map_file(path);
+        this->data_ = data.data();
+        this->size_ = data.size();
+    }
+
+    mapped_file::~mapped_file()
+    {
+        this->release();
+    }
+
+    mapped_file::mapped_file(mapped_file&& obj) noexcept
+    {
+        this->operator=(std::move(obj));
+    }
+
+    mapped_file& mapped_file::operator=(mapped_file&& obj) noexcept
+    {
+        if (this != &obj)
+        {
+            this->release();
+            this->data_ = std::exchange(obj.data_, nullptr);
+            this->size_ = std::exchange(obj.size_, 0);
+        }
+
+        return *this;
+    }
+
+    void mapped_file::release()
+    {
+        if (this->data_)
+        {
+            unmap_file({this->data_, this->size_});
+        }
+
+        this->data_ = nullptr;
+        this->size_ = 0;
+    }
+}
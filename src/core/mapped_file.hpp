@@ -0,0 +1,45 @@
+#pragma once
+
+#include <span>
+#include <cstddef>
+#include <filesystem>
+
+namespace momo::utils
+{
+    /*****************************************************************************
+     * Read-only file mapping. Pages are only faulted in when they are accessed
+     * and stay backed by the page cache.
+     * An empty mapping is produced if the file can't be mapped.
+     ****************************************************************************/
+
+    class mapped_file
+    {
+      public:
+        mapped_file() = default;
+        explicit mapped_file(const std::filesystem::path& path);
+
+        ~mapped_file();
+
+        mapped_file(mapped_file&& obj) noexcept;
+        mapped_file& operator=(mapped_file&& obj) noexcept;
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        bool empty() const
+        {
+            return this->size_ == 0;
+        }
+
+        std::span<const std::byte> get_data() const
+        {
+            return {this->data_, this->size_};
+        }
+
+      private:
+        std::byte* data_{};
+        size_t size_{};
+
+        void release();
+    };
+}
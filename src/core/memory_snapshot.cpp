@@ -0,0 +1,165 @@
+#include "memory_snapshot.hpp"
+
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <charconv>
+#include <stdexcept>
+#include <algorithm>
+
+namespace momo
+{
+    namespace
+    {
+        uint64_t parse_number(const std::string& text)
+        {
+            const auto is_hex = text.starts_with("0x") || text.starts_with("0X");
+            const auto* start = text.data() + (is_hex ? 2 : 0);
+            const auto* end = text.data() + text.size();
+
+            uint64_t value{};
+            const auto [ptr, ec] = std::from_chars(start, end, value, is_hex ? 16 : 10);
+
+            if (ec != std::errc{} || ptr != end || start == end)
+            {
+                throw std::runtime_error("Invalid number in snapshot manifest: " + text);
+            }
+
+            return value;
+        }
+
+        // The rest of the line, so that paths may contain spaces
+        std::filesystem::path parse_path(std::istringstream& stream, const std::filesystem::path& directory)
+        {
+            std::string path{};
+            std::getline(stream >> std::ws, path);
+
+            if (path.empty())
+            {
+                throw std::runtime_error("Missing path in snapshot manifest");
+            }
+
+            return directory / std::filesystem::path(path);
+        }
+    }
+
+    memory_snapshot::memory_snapshot(const std::filesystem::path& manifest)
+    {
+        std::ifstream stream{manifest};
+        if (!stream)
+        {
+            throw std::runtime_error("Failed to open snapshot manifest: " + manifest.string());
+        }
+
+        const auto directory = manifest.parent_path();
+
+        std::string line{};
+        while (std::getline(stream, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            std::istringstream line_stream{line};
+
+            std::string type{};
+            if (!(line_stream >> type) || type.starts_with('#'))
+            {
+                continue;
+            }
+
+            std::string address{};
+            line_stream >> address;
+
+            if (type == "memory")
+            {
+                auto& region = this->regions_.emplace_back();
+                region.address = parse_number(address);
+                region.file = utils::mapped_file{parse_path(line_stream, directory)};
+            }
+            else if (type == "module")
+            {
+                std::string size{};
+                line_stream >> size;
+
+                auto& module = this->modules_.emplace_back();
+                module.base_address = parse_number(address);
+                module.size = parse_number(size);
+                module.path = parse_path(line_stream, directory).string();
+            }
+            else
+            {
+                throw std::runtime_error("Unknown entry in snapshot manifest: " + type);
+            }
+        }
+
+        std::erase_if(this->regions_, [](const memory_region& region) { return region.file.empty(); });
+        std::ranges::sort(this->regions_, {}, &memory_region::address);
+
+        for (size_t i = 1; i < this->regions_.size(); ++i)
+        {
+            if (this->regions_[i].address < this->regions_[i - 1].get_end())
+            {
+                throw std::runtime_error("Overlapping memory regions in snapshot manifest");
+            }
+        }
+    }
+
+    std::vector<module_info> memory_snapshot::get_modules()
+    {
+        return this->modules_;
+    }
+
+    // Reads may span multiple regions, as long as there is no gap between them
+    std::future<bool> memory_snapshot::read_memory(uint64_t address, std::span<uint8_t> buffer)
+    {
+        auto region = std::ranges::upper_bound(this->regions_, address, {}, &memory_region::address);
+        if (region == this->regions_.begin())
+        {
+            return make_ready_read_result(false);
+        }
+
+        --region;
+
+        while (!buffer.empty())
+        {
+            if (region == this->regions_.end() || address < region->address || address >= region->get_end())
+            {
+                return make_ready_read_result(false);
+            }
+
+            const auto data = region->file.get_data();
+            const auto offset = static_cast<size_t>(address - region->address);
+            const auto size = std::min(buffer.size(), data.size() - offset);
+
+            memcpy(buffer.data(), data.data() + offset, size);
+
+            buffer = buffer.subspan(size);
+            address += size;
+            ++region;
+        }
+
+        return make_ready_read_result(true);
+    }
+
+    std::span<const uint8_t> memory_snapshot::get_memory_view(const uint64_t address, const size_t size)
+    {
+        auto region = std::ranges::upper_bound(this->regions_, address, {}, &memory_region::address);
+        if (region == this->regions_.begin())
+        {
+            return {};
+        }
+
+        --region;
+
+        if (address - region->address >= region->file.get_data().size() || size > region->get_end() - address)
+        {
+            return {};
+        }
+
+        const auto data = region->file.get_data().subspan(static_cast<size_t>(address - region->address), size);
+        return {reinterpret_cast<const uint8_t*>(data.data()), data.size()};
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <filesystem>
+
+#include "mapped_file.hpp"
+#include "memory_source.hpp"
+
+namespace momo
+{
+    /*****************************************************************************
+     * Process memory captured into raw files, described by a manifest:
+     *
+     *   # comment
+     *   memory <address> <file>          raw bytes starting at address
+     *   module <base> <size> <image>     loaded module and its file on disk
+     *
+     * Numbers are decimal or 0x-prefixed hex. Relative paths are resolved
+     * against the directory of the manifest. Malformed manifests throw.
+     ****************************************************************************/
+
+    class memory_snapshot : public memory_source, public module_enumerator
+    {
+      public:
+        explicit memory_snapshot(const std::filesystem::path& manifest);
+
+        std::vector<module_info> get_modules() override;
+        std::future<bool> read_memory(uint64_t address, std::span<uint8_t> buffer) override;
+        std::span<const uint8_t> get_memory_view(uint64_t address, size_t size) override;
+
+      private:
+        struct memory_region
+        {
+            uint64_t address{};
+            utils::mapped_file file{};
+
+            uint64_t get_end() const
+            {
+                return this->address + this->file.get_data().size();
+            }
+        };
+
+        // Sorted by address and not overlapping
+        std::vector<memory_region> regions_{};
+        std::vector<module_info> modules_{};
+    };
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <span>
+#include <future>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <optional>
+
+#include "clean_image.hpp"
+
+namespace momo
+{
+    struct module_info
+    {
+        // Path of the image file on disk
+        std::string path{};
+        uint64_t base_address{};
+        uint64_t size{};
+
+        // If known, the image on disk must be the same build
+        std::optional<image_identity> identity{};
+    };
+
+    class module_enumerator
+    {
+      public:
+        virtual ~module_enumerator() = default;
+        virtual std::vector<module_info> get_modules() = 0;
+    };
+
+    /*****************************************************************************
+     * Memory of the scanned process, for example a live debuggee or a
+     * snapshot. Reads may complete on a different thread, which allows
+     * sources to serialize access to APIs that are not thread-safe.
+     ****************************************************************************/
+
+    class memory_source
+    {
+      public:
+        virtual ~memory_source() = default;
+
+        // Returns whether the whole buffer could be read
+        virtual std::future<bool> read_memory(uint64_t address, std::span<uint8_t> buffer) = 0;
+
+        // Sources that keep memory mapped can hand it out without copying. Returns an empty span otherwise.
+        virtual std::span<const uint8_t> get_memory_view(uint64_t /*address*/, size_t /*size*/)
+        {
+            return {};
+        }
+    };
+
+    // For sources that complete reads immediately
+    inline std::future<bool> make_ready_read_result(const bool success)
+    {
+        std::promise<bool> promise{};
+        promise.set_value(success);
+
+        return promise.get_future();
+    }
+}
@@ -0,0 +1,329 @@
+#include "minidump.hpp"
+
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "buffer_accessor.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr uint32_t minidump_signature = 0x504D444D; // MDMP
+
+        constexpr uint32_t module_list_stream = 4;
+        constexpr uint32_t memory_list_stream = 5;
+        constexpr uint32_t memory64_list_stream = 9;
+
+#pragma pack(push, 4)
+
+        struct minidump_header
+        {
+            uint32_t signature{};
+            uint32_t version{};
+            uint32_t number_of_streams{};
+            uint32_t stream_directory_rva{};
+            uint32_t checksum{};
+            uint32_t time_date_stamp{};
+            uint64_t flags{};
+        };
+
+        struct location_descriptor
+        {
+            uint32_t data_size{};
+            uint32_t rva{};
+        };
+
+        struct minidump_directory
+        {
+            uint32_t stream_type{};
+            location_descriptor location{};
+        };
+
+        struct minidump_module
+        {
+            uint64_t base_of_image{};
+            uint32_t size_of_image{};
+            uint32_t checksum{};
+            uint32_t time_date_stamp{};
+            uint32_t module_name_rva{};
+            uint8_t version_info[52]{};
+            location_descriptor cv_record{};
+            location_descriptor misc_record{};
+            uint64_t reserved0{};
+            uint64_t reserved1{};
+        };
+
+        struct memory_descriptor
+        {
+            uint64_t start_of_memory_range{};
+            location_descriptor memory{};
+        };
+
+        struct memory_descriptor64
+        {
+            uint64_t start_of_memory_range{};
+            uint64_t data_size{};
+        };
+
+        struct memory64_list
+        {
+            uint64_t number_of_memory_ranges{};
+            uint64_t base_rva{};
+        };
+
+#pragma pack(pop)
+
+        static_assert(sizeof(minidump_header) == 32);
+        static_assert(sizeof(minidump_module) == 108);
+        static_assert(sizeof(memory_descriptor) == 16);
+
+        using buffer_accessor = utils::safe_buffer_accessor<const std::byte>;
+
+        void append_utf8(std::string& text, const uint32_t code_point)
+        {
+            if (code_point < 0x80)
+            {
+                text.push_back(static_cast<char>(code_point));
+            }
+            else if (code_point < 0x800)
+            {
+                text.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+                text.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+            else if (code_point < 0x10000)
+            {
+                text.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+                text.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                text.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+            else
+            {
+                text.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+                text.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+                text.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                text.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+        }
+
+        // MINIDUMP_STRING: byte length followed by UTF-16 characters
+        std::string read_string(const buffer_accessor& buffer, const uint32_t rva)
+        {
+            const auto length = buffer.as<uint32_t>(rva).get() / sizeof(char16_t);
+            const auto characters = buffer.as<char16_t>(rva + sizeof(uint32_t));
+
+            // The length comes from the file, so it is checked before anything is allocated for it
+            buffer.validate(static_cast<size_t>(rva) + sizeof(uint32_t), length * sizeof(char16_t));
+
+            std::string result{};
+            result.reserve(length);
+
+            for (size_t i = 0; i < length; ++i)
+            {
+                uint32_t code_point = characters.get(i);
+
+                if (code_point >= 0xD800 && code_point < 0xDC00 && i + 1 < length)
+                {
+                    const uint32_t low_surrogate = characters.get(i + 1);
+                    if (low_surrogate >= 0xDC00 && low_surrogate < 0xE000)
+                    {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+                        ++i;
+                    }
+                }
+
+                append_utf8(result, code_point);
+            }
+
+            return result;
+        }
+    }
+
+    minidump::minidump(const std::filesystem::path& path)
+        : file_(path)
+    {
+        if (this->file_.empty())
+        {
+            throw std::runtime_error("Failed to map minidump: " + path.string());
+        }
+
+        const buffer_accessor buffer{this->file_.get_data()};
+        const auto header = buffer.as<minidump_header>(0).get();
+
+        if (header.signature != minidump_signature)
+        {
+            throw std::runtime_error("Not a minidump: " + path.string());
+        }
+
+        const auto directories = buffer.as<minidump_directory>(header.stream_directory_rva);
+
+        for (size_t i = 0; i < header.number_of_streams; ++i)
+        {
+            const auto directory = directories.get(i);
+            const auto& location = directory.location;
+
+            buffer.validate(location.rva, location.data_size);
+
+            if (directory.stream_type == module_list_stream)
+            {
+                const auto count = buffer.as<uint32_t>(location.rva).get();
+                const auto modules = buffer.as<minidump_module>(location.rva + sizeof(uint32_t));
+
+                for (size_t j = 0; j < count; ++j)
+                {
+                    const auto module = modules.get(j);
+
+                    this->modules_.push_back({
+                        .path = read_string(buffer, module.module_name_rva),
+                        .base_address = module.base_of_image,
+                        .size = module.size_of_image,
+                        .identity =
+                            image_identity{
+                                .time_date_stamp = module.time_date_stamp,
+                                .size_of_image = module.size_of_image,
+                            },
+                    });
+                }
+            }
+            else if (directory.stream_type == memory64_list_stream)
+            {
+                const auto list = buffer.as<memory64_list>(location.rva).get();
+                const auto descriptors = buffer.as<memory_descriptor64>(location.rva + sizeof(memory64_list));
+
+                // The data of all ranges follows each other, starting at the base rva
+                auto file_offset = list.base_rva;
+
+                for (size_t j = 0; j < list.number_of_memory_ranges; ++j)
+                {
+                    const auto descriptor = descriptors.get(j);
+                    this->ranges_.push_back({descriptor.start_of_memory_range, descriptor.data_size, file_offset});
+
+                    file_offset += descriptor.data_size;
+                }
+            }
+            else if (directory.stream_type == memory_list_stream)
+            {
+                const auto count = buffer.as<uint32_t>(location.rva).get();
+                const auto descriptors = buffer.as<memory_descriptor>(location.rva + sizeof(uint32_t));
+
+                for (size_t j = 0; j < count; ++j)
+                {
+                    const auto descriptor = descriptors.get(j);
+                    this->ranges_.push_back({descriptor.start_of_memory_range, descriptor.memory.data_size, descriptor.memory.rva});
+                }
+            }
+        }
+
+        std::erase_if(this->ranges_, [](const memory_range& range) { return range.size == 0; });
+        std::ranges::stable_sort(this->ranges_, {}, &memory_range::address);
+
+        std::vector<memory_range> merged_ranges{};
+        merged_ranges.reserve(this->ranges_.size());
+
+        for (auto range : this->ranges_)
+        {
+            if (range.file_offset + range.size < range.file_offset || range.address + range.size < range.address)
+            {
+                throw std::runtime_error("Invalid memory range in minidump: " + path.string());
+            }
+
+            buffer.validate(static_cast<size_t>(range.file_offset), static_cast<size_t>(range.size));
+
+            // Dumps that hold both memory lists can contain a range twice, so ranges that overlap an earlier one keep their tail
+            const auto covered_until = merged_ranges.empty() ? range.address : merged_ranges.back().get_end();
+            if (range.get_end() <= covered_until)
+            {
+                continue;
+            }
+
+            if (range.address < covered_until)
+            {
+                const auto overlap = covered_until - range.address;
+
+                range.address += overlap;
+                range.file_offset += overlap;
+                range.size -= overlap;
+            }
+
+            auto* previous = merged_ranges.empty() ? nullptr : &merged_ranges.back();
+            if (previous && previous->get_end() == range.address && previous->file_offset + previous->size == range.file_offset)
+            {
+                previous->size += range.size;
+            }
+            else
+            {
+                merged_ranges.push_back(range);
+            }
+        }
+
+        this->ranges_ = std::move(merged_ranges);
+    }
+
+    std::vector<module_info> minidump::get_modules()
+    {
+        return this->modules_;
+    }
+
+    std::vector<minidump::memory_range>::const_iterator minidump::find_range(const uint64_t address) const
+    {
+        auto range = std::ranges::upper_bound(this->ranges_, address, {}, &memory_range::address);
+        if (range == this->ranges_.begin())
+        {
+            return this->ranges_.end();
+        }
+
+        --range;
+        return address < range->get_end() ? range : this->ranges_.end();
+    }
+
+    // Reads may span multiple ranges, as long as there is no gap between them in memory
+    std::future<bool> minidump::read_memory(uint64_t address, std::span<uint8_t> buffer)
+    {
+        auto range = this->find_range(address);
+        const auto data = this->file_.get_data();
+
+        while (!buffer.empty())
+        {
+            if (range == this->ranges_.end() || address < range->address || address >= range->get_end())
+            {
+                return make_ready_read_result(false);
+            }
+
+            const auto offset = address - range->address;
+            const auto size = static_cast<size_t>(std::min<uint64_t>(buffer.size(), range->size - offset));
+
+            memcpy(buffer.data(), data.data() + range->file_offset + offset, size);
+
+            buffer = buffer.subspan(size);
+            address += size;
+            ++range;
+        }
+
+        return make_ready_read_result(true);
+    }
+
+    std::span<const uint8_t> minidump::get_memory_view(const uint64_t address, const size_t size)
+    {
+        const auto range = this->find_range(address);
+        if (range == this->ranges_.end() || size > range->get_end() - address)
+        {
+            return {};
+        }
+
+        const auto* data = reinterpret_cast<const uint8_t*>(this->file_.get_data().data());
+        return {data + range->file_offset + (address - range->address), size};
+    }
+
+    bool minidump::is_minidump(const std::filesystem::path& path)
+    {
+        std::ifstream stream{path, std::ios::binary};
+
+        uint32_t signature{};
+        stream.read(reinterpret_cast<char*>(&signature), sizeof(signature));
+
+        return stream && signature == minidump_signature;
+    }
+}
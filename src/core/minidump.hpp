@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <filesystem>
+
+#include "mapped_file.hpp"
+#include "memory_source.hpp"
+
+namespace momo
+{
+    /*****************************************************************************
+     * Windows minidump as a memory source. The dump is mapped, not loaded,
+     * and the memory list streams are indexed into a sorted range table, so
+     * reads are served straight from the mapping. Module paths are the ones
+     * recorded on the machine the dump was taken on.
+     * Throws if the file is not a valid minidump.
+     ****************************************************************************/
+
+    class minidump : public memory_source, public module_enumerator
+    {
+      public:
+        explicit minidump(const std::filesystem::path& path);
+
+        std::vector<module_info> get_modules() override;
+        std::future<bool> read_memory(uint64_t address, std::span<uint8_t> buffer) override;
+        std::span<const uint8_t> get_memory_view(uint64_t address, size_t size) override;
+
+        static bool is_minidump(const std::filesystem::path& path);
+
+      private:
+        struct memory_range
+        {
+            uint64_t address{};
+            uint64_t size{};
+            uint64_t file_offset{};
+
+            uint64_t get_end() const
+            {
+                return this->address + this->size;
+            }
+        };
+
+        utils::mapped_file file_{};
+
+        // Sorted by address and not overlapping. Ranges that are contiguous in memory and in the file are merged.
+        std::vector<memory_range> ranges_{};
+        std::vector<module_info> modules_{};
+
+        std::vector<memory_range>::const_iterator find_range(uint64_t address) const;
+    };
+}
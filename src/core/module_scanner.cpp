@@ -0,0 +1,1411 @@
+#include "module_scanner.hpp"
+#include "pe_parser.hpp"
+
+#include <optional>
+#include <string>
+#include <stdexcept>
+#include <bit>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <ranges>
+#include <algorithm>
+#include <functional>
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t page_size = 0x1000;
+
+        uint64_t align_down(const uint64_t value, const uint64_t alignment)
+        {
+            return value & ~(alignment - 1);
+        }
+
+        uint64_t align_up(const uint64_t value, const uint64_t alignment)
+        {
+            return align_down(value + alignment - 1, alignment);
+        }
+
+        // Sections must be at least 90% equal to be considered the same code
+        std::optional<size_t> get_max_differences_for_analysis(const size_t size)
+        {
+            const auto min_equal_bytes = ((size / 10) * 9) + 1;
+            if (size < min_equal_bytes)
+            {
+                return std::nullopt;
+            }
+
+            return size - min_equal_bytes;
+        }
+
+        // Only used to detect changes between scans, so it favors speed over distribution
+        uint64_t hash_page(const std::span<const uint8_t> data)
+        {
+            constexpr uint64_t prime = 0x100000001B3;
+            uint64_t hash = 0xCBF29CE484222325 ^ data.size();
+
+            size_t offset = 0;
+
+            for (; offset + sizeof(uint64_t) <= data.size(); offset += sizeof(uint64_t))
+            {
+                uint64_t value{};
+                memcpy(&value, data.data() + offset, sizeof(value));
+                hash = std::rotl((hash ^ value) * prime, 31);
+            }
+
+            for (; offset < data.size(); ++offset)
+            {
+                hash = (hash ^ data[offset]) * prime;
+            }
+
+            return hash;
+        }
+
+        // Chunks end on a page boundary, so that every page is hashed as a whole, no matter how the region is read
+        size_t get_chunk_end(const uint64_t region_address, const size_t region_size, const size_t offset, const size_t chunk_size)
+        {
+            const auto start = region_address + offset;
+            const auto end = std::max(align_down(start + chunk_size, page_size), start + 1);
+
+            return offset + std::min(static_cast<size_t>(end - start), region_size - offset);
+        }
+
+        void hash_pages(const uint64_t address, const std::span<const uint8_t> data, std::vector<page_hash>& hashes)
+        {
+            size_t offset = 0;
+
+            while (offset < data.size())
+            {
+                const auto page_end = align_down(address + offset + page_size, page_size);
+                const auto size = std::min(static_cast<size_t>(page_end - (address + offset)), data.size() - offset);
+
+                hashes.emplace_back(address + offset, hash_page(data.subspan(offset, size)));
+                offset += size;
+            }
+        }
+
+        // Patches are matched against the allowlist right after the diff, as only then the runtime bytes are at hand
+        struct patch_filter
+        {
+            const patch_allowlist* allowlist{};
+            image_identity identity{};
+            uint64_t base_address{};
+
+            bool is_active() const
+            {
+                return this->allowlist && !this->allowlist->empty();
+            }
+
+            // The data holds the runtime bytes starting at data_address and covers the patch
+            bool is_allowed(const uint64_t address, const uint64_t length, const uint64_t data_address,
+                            const std::span<const uint8_t> data) const
+            {
+                if (!this->is_active())
+                {
+                    return false;
+                }
+
+                const auto bytes = data.subspan(static_cast<size_t>(address - data_address), static_cast<size_t>(length));
+                return this->allowlist->contains(make_allowed_patch(this->identity, address - this->base_address, bytes));
+            }
+        };
+
+        struct section_scan
+        {
+            const clean_section* section{};
+            uint64_t address{};
+            size_t region_offset{};
+            size_t max_differences{};
+
+            size_t differences{};
+            size_t scanned_until{};
+            bool rejected{false};
+            std::vector<patch> patches{};
+
+            // Runtime bytes of the patches back to back, only kept if there is an allowlist to match them against
+            std::vector<uint8_t> patch_bytes{};
+
+            bool is_done() const
+            {
+                return this->rejected || this->scanned_until >= this->section->data.size();
+            }
+        };
+
+        struct memory_region
+        {
+            uint64_t address{};
+            size_t size{};
+            std::vector<section_scan> sections{};
+        };
+
+        // Runtime bytes of a region, starting at offset. Reads only keep the current chunk and the end of the one before it.
+        struct region_window
+        {
+            size_t offset{};
+            std::span<const uint8_t> data{};
+        };
+
+        struct pending_read
+        {
+            size_t offset{};
+            size_t size{};
+            size_t buffer_index{};
+            std::future<bool> result{};
+        };
+
+        std::vector<memory_region> plan_regions(const clean_image& image, const uint64_t base_address)
+        {
+            std::vector<memory_region> regions{};
+
+            for (const auto& section : image.sections)
+            {
+                const auto max_differences = get_max_differences_for_analysis(section.data.size());
+                if (!max_differences)
+                {
+                    continue;
+                }
+
+                const auto address = base_address + section.rva;
+
+                if (regions.empty() || align_up(regions.back().address + regions.back().size, page_size) < address)
+                {
+                    regions.emplace_back().address = address;
+                }
+
+                auto& region = regions.back();
+                const auto region_offset = static_cast<size_t>(address - region.address);
+
+                region.size = std::max(region.size, region_offset + section.data.size());
+                region.sections.emplace_back(section_scan{
+                    .section = &section,
+                    .address = address,
+                    .region_offset = region_offset,
+                    .max_differences = *max_differences,
+                });
+            }
+
+            return regions;
+        }
+
+        uint64_t count_relocated_slots(const clean_section& section, const diff_range range)
+        {
+            const auto begin = std::ranges::lower_bound(section.relocations, section.rva + range.begin, {}, &relocation_entry::rva);
+            const auto end = std::ranges::lower_bound(begin, section.relocations.end(), section.rva + range.end, {}, &relocation_entry::rva);
+
+            return static_cast<uint64_t>(end - begin);
+        }
+
+        // The window only holds part of the section, so the range is compared as a section of its own
+        void diff_section_range(const module_scan_context& context, const int64_t delta, const patch_filter& filter, section_scan& scan,
+                                const region_window& window, diff_range range, scan_statistics& statistics)
+        {
+            const auto& section = *scan.section;
+            range = align_to_relocations(section, range);
+
+            if (scan.rejected || range.begin >= range.end)
+            {
+                return;
+            }
+
+            const auto size = range.end - range.begin;
+
+            statistics.bytes_compared += size;
+            context.profiler.add_compared_bytes(size);
+            statistics.relocated_slots += count_relocated_slots(section, range);
+
+            clean_section part{
+                .rva = static_cast<uint32_t>(section.rva + range.begin),
+                .data = section.data.subspan(range.begin, size),
+            };
+
+            const auto first_slot = std::ranges::lower_bound(section.relocations, part.rva, {}, &relocation_entry::rva);
+            const auto last_slot = std::ranges::lower_bound(first_slot, section.relocations.end(), part.rva + size, {}, &relocation_entry::rva);
+            part.relocations.assign(first_slot, last_slot);
+
+            const auto runtime_data = window.data.subspan(scan.region_offset + range.begin - window.offset, size);
+            const auto address = scan.address + range.begin;
+
+            const auto& options = context.options;
+            const auto remaining_budget = scan.max_differences - scan.differences;
+            const auto split_range = size > options.parallel_diff_threshold && options.parallel_diff_chunk_size > 0;
+
+            const auto patches = split_range ? find_differences(context.pool, part, runtime_data, delta, address, {0, size}, remaining_budget,
+                                                                options.parallel_diff_chunk_size)
+                                             : find_differences(part, runtime_data, delta, address, {0, size}, remaining_budget);
+            if (!patches)
+            {
+                scan.rejected = true;
+                scan.patches = {};
+                scan.patch_bytes = {};
+                return;
+            }
+
+            for (const auto& patch : *patches)
+            {
+                scan.differences += patch.length;
+
+                if (filter.is_active())
+                {
+                    const auto bytes = runtime_data.subspan(static_cast<size_t>(patch.address - address), static_cast<size_t>(patch.length));
+                    scan.patch_bytes.insert(scan.patch_bytes.end(), bytes.begin(), bytes.end());
+                }
+            }
+
+            append_patches(scan.patches, *patches);
+        }
+
+        // Compares everything up to readable_until that hasn't been compared yet, skipping unreadable ranges
+        bool diff_available_data(const module_scan_context& context, const int64_t delta, const patch_filter& filter, memory_region& region,
+                                 const region_window& window, const std::vector<diff_range>& unreadable, const size_t readable_until,
+                                 scan_statistics& statistics)
+        {
+            bool pending_sections = false;
+
+            for (auto& scan : region.sections)
+            {
+                if (scan.is_done())
+                {
+                    continue;
+                }
+
+                const auto section_size = scan.section->data.size();
+
+                if (scan.region_offset >= readable_until)
+                {
+                    pending_sections = true;
+                    continue;
+                }
+
+                const auto available = std::min(section_size, readable_until - scan.region_offset);
+
+                // Slots crossing the end of the available data are compared once the rest is read
+                auto range = diff_range{scan.scanned_until, available};
+                if (available < section_size)
+                {
+                    range.end = align_to_relocations(*scan.section, range).end;
+                }
+
+                auto position = range.begin;
+
+                for (const auto& hole : unreadable)
+                {
+                    const auto hole_begin = std::max(hole.begin, scan.region_offset) - scan.region_offset;
+                    const auto hole_end = std::max(hole.end, scan.region_offset) - scan.region_offset;
+
+                    if (hole_end <= position || hole_begin >= range.end)
+                    {
+                        continue;
+                    }
+
+                    diff_section_range(context, delta, filter, scan, window, {position, std::max(position, hole_begin)}, statistics);
+                    position = std::min(hole_end, range.end);
+                }
+
+                diff_section_range(context, delta, filter, scan, window, {position, range.end}, statistics);
+                scan.scanned_until = std::max(scan.scanned_until, range.end);
+
+                pending_sections |= !scan.is_done();
+            }
+
+            return pending_sections;
+        }
+
+        void add_unreadable_range(std::vector<diff_range>& unreadable, const size_t offset, const size_t size)
+        {
+            if (!unreadable.empty() && unreadable.back().end == offset)
+            {
+                unreadable.back().end += size;
+                return;
+            }
+
+            unreadable.emplace_back(offset, offset + size);
+        }
+
+        // Keeps track of the read buffers that are alive at the same time
+        class buffer_reservation
+        {
+          public:
+            buffer_reservation(scan_profiler& profiler, const uint64_t size)
+                : profiler_(profiler),
+                  size_(size)
+            {
+                this->profiler_.allocate_buffer(this->size_);
+            }
+
+            ~buffer_reservation()
+            {
+                this->profiler_.release_buffer(this->size_);
+            }
+
+            buffer_reservation(buffer_reservation&&) = delete;
+            buffer_reservation(const buffer_reservation&) = delete;
+            buffer_reservation& operator=(buffer_reservation&&) = delete;
+            buffer_reservation& operator=(const buffer_reservation&) = delete;
+
+          private:
+            scan_profiler& profiler_;
+            uint64_t size_{};
+        };
+
+        void collect_region_result(const memory_region& region, const std::vector<diff_range>& unreadable, const patch_filter& filter,
+                                   module_scan_result& result)
+        {
+            for (const auto& scan : region.sections)
+            {
+                if (scan.rejected)
+                {
+                    continue;
+                }
+
+                const std::span<const uint8_t> patch_bytes = scan.patch_bytes;
+                size_t byte_offset = 0;
+
+                for (const auto& entry : scan.patches)
+                {
+                    const auto bytes = filter.is_active() ? patch_bytes.subspan(byte_offset, static_cast<size_t>(entry.length))
+                                                          : std::span<const uint8_t>{};
+                    byte_offset += static_cast<size_t>(entry.length);
+
+                    if (filter.is_allowed(entry.address, entry.length, entry.address, bytes))
+                    {
+                        ++result.allowed_patches;
+                    }
+                    else
+                    {
+                        result.patches.push_back(entry);
+                    }
+                }
+            }
+
+            for (const auto& range : unreadable)
+            {
+                result.unreadable_ranges.emplace_back(region.address + range.begin, range.end - range.begin);
+            }
+        }
+
+        // Mapped memory is compared in place, in steps of the maximum read size to stay responsive to cancellation
+        bool scan_mapped_region(const module_scan_context& context, const int64_t delta, const patch_filter& filter, memory_region& region,
+                                module_scan_result& result, module_profile& profile)
+        {
+            const auto data = context.memory.get_memory_view(region.address, region.size);
+            if (data.size() != region.size)
+            {
+                return false;
+            }
+
+            auto& statistics = profile.statistics;
+            const auto step = std::max(context.options.max_read_size, page_size);
+
+            size_t readable_until = 0;
+
+            while (readable_until < region.size && !context.cancelled)
+            {
+                const auto next_end = get_chunk_end(region.address, region.size, readable_until, step);
+                statistics.bytes_read += next_end - readable_until;
+
+                if (context.hash_pages)
+                {
+                    hash_pages(region.address + readable_until, data.subspan(readable_until, next_end - readable_until),
+                               result.page_hashes);
+                }
+
+                readable_until = next_end;
+
+                const scan_profiler::scope scope{context.profiler, profile, scan_phase::diff};
+                if (!diff_available_data(context, delta, filter, region, {0, data}, {}, readable_until, statistics))
+                {
+                    break;
+                }
+            }
+
+            collect_region_result(region, {}, filter, result);
+            return true;
+        }
+
+        // Slots are at most this large, so this much of the previous chunk is kept to compare slots that cross into the next one
+        constexpr size_t carry_size = sizeof(uint64_t);
+
+        void scan_region(const module_scan_context& context, const int64_t delta, const patch_filter& filter, memory_region& region,
+                         module_scan_result& result, module_profile& profile)
+        {
+            if (scan_mapped_region(context, delta, filter, region, result, profile))
+            {
+                return;
+            }
+
+            const auto& options = context.options;
+            auto& statistics = profile.statistics;
+
+            auto chunk_size = std::max(options.initial_read_size, page_size);
+            const auto max_chunk_size = std::max(options.max_read_size, page_size);
+
+            // One chunk is compared while the next one is read into the other buffer
+            const auto buffer_size = carry_size + std::min(max_chunk_size, region.size);
+
+            const buffer_reservation reservation{context.profiler, 2 * buffer_size};
+            statistics.peak_buffer_size = std::max(statistics.peak_buffer_size, static_cast<uint64_t>(2 * buffer_size));
+
+            std::array<std::vector<uint8_t>, 2> buffers{std::vector<uint8_t>(buffer_size), std::vector<uint8_t>(buffer_size)};
+            std::vector<diff_range> unreadable{};
+            region_window window{};
+
+            const auto issue_read = [&](const size_t offset, const size_t buffer_index) {
+                const auto size = get_chunk_end(region.address, region.size, offset, chunk_size) - offset;
+
+                return pending_read{
+                    .offset = offset,
+                    .size = size,
+                    .buffer_index = buffer_index,
+                    .result = context.memory.read_memory(region.address + offset, std::span(buffers[buffer_index]).subspan(carry_size, size)),
+                };
+            };
+
+            std::optional<pending_read> pending = issue_read(0, 0);
+
+            while (pending)
+            {
+                auto current = std::move(*pending);
+                pending.reset();
+
+                bool success{};
+
+                {
+                    const scan_profiler::scope scope{context.profiler, profile, scan_phase::read_memory};
+                    success = current.result.get();
+                }
+
+                // Retry page by page to find the pages that can't be read
+                if (!success && get_chunk_end(region.address, region.size, current.offset, page_size) < current.offset + current.size)
+                {
+                    chunk_size = page_size;
+                    pending = issue_read(current.offset, current.buffer_index);
+                    continue;
+                }
+
+                auto& buffer = buffers[current.buffer_index];
+
+                if (success)
+                {
+                    statistics.bytes_read += current.size;
+                    chunk_size = std::min(chunk_size * 2, max_chunk_size);
+
+                    if (context.hash_pages)
+                    {
+                        hash_pages(region.address + current.offset, std::span(buffer).subspan(carry_size, current.size), result.page_hashes);
+                    }
+                }
+                else
+                {
+                    add_unreadable_range(unreadable, current.offset, current.size);
+                }
+
+                // The end of the last window is moved in front of the chunk, before the next read reuses its buffer
+                const auto carry = std::min(carry_size, window.data.size());
+                std::ranges::copy(window.data.last(carry), buffer.begin() + static_cast<ptrdiff_t>(carry_size - carry));
+
+                window = region_window{
+                    .offset = current.offset - carry,
+                    .data = std::span(buffer).subspan(carry_size - carry, carry + current.size),
+                };
+
+                const auto readable_until = current.offset + current.size;
+                if (readable_until < region.size && !context.cancelled)
+                {
+                    pending = issue_read(readable_until, current.buffer_index ^ 1);
+                }
+
+                // The next chunk is read while this one is compared, so it must finish before the buffers go away
+                bool pending_sections{};
+
+                try
+                {
+                    const scan_profiler::scope scope{context.profiler, profile, scan_phase::diff};
+                    pending_sections = diff_available_data(context, delta, filter, region, window, unreadable, readable_until, statistics);
+                }
+                catch (...)
+                {
+                    if (pending)
+                    {
+                        pending->result.wait();
+                    }
+
+                    throw;
+                }
+
+                if (!pending_sections || context.cancelled)
+                {
+                    if (pending)
+                    {
+                        pending->result.wait();
+                    }
+
+                    break;
+                }
+            }
+
+            collect_region_result(region, unreadable, filter, result);
+        }
+
+        bool is_same_page(const std::span<const page_hash> baseline, const page_hash& page)
+        {
+            const auto entry = std::ranges::lower_bound(baseline, page.address, {}, &page_hash::address);
+            return entry != baseline.end() && entry->address == page.address && entry->hash == page.hash;
+        }
+
+        // Reads the regions in steps of the maximum read size and stops at the first page that changed or can't be read
+        bool has_same_pages(const module_scan_context& context, const std::vector<memory_region>& regions,
+                            const std::span<const page_hash> baseline, module_profile& profile)
+        {
+            auto& statistics = profile.statistics;
+            const auto step = std::max(context.options.max_read_size, page_size);
+
+            std::vector<uint8_t> buffer{};
+            std::vector<page_hash> hashes{};
+
+            for (const auto& region : regions)
+            {
+                size_t offset = 0;
+
+                while (offset < region.size && !context.cancelled)
+                {
+                    const auto address = region.address + offset;
+                    const auto size = get_chunk_end(region.address, region.size, offset, step) - offset;
+
+                    auto data = context.memory.get_memory_view(address, size);
+                    if (data.size() != size)
+                    {
+                        if (buffer.empty())
+                        {
+                            buffer.resize(step);
+                        }
+
+                        const buffer_reservation reservation{context.profiler, size};
+                        statistics.peak_buffer_size = std::max(statistics.peak_buffer_size, static_cast<uint64_t>(size));
+
+                        const scan_profiler::scope scope{context.profiler, profile, scan_phase::read_memory};
+                        const auto target = std::span(buffer).subspan(0, size);
+
+                        if (!context.memory.read_memory(address, target).get())
+                        {
+                            return false;
+                        }
+
+                        data = target;
+                    }
+
+                    statistics.bytes_read += size;
+
+                    hashes.clear();
+                    hash_pages(address, data, hashes);
+
+                    if (!std::ranges::all_of(hashes, [&](const page_hash& page) { return is_same_page(baseline, page); }))
+                    {
+                        return false;
+                    }
+
+                    offset += size;
+                }
+            }
+
+            return !context.cancelled;
+        }
+
+        const char* find_header_mismatch(const image_headers& file_headers, const image_headers& memory_headers)
+        {
+            if (file_headers.identity.time_date_stamp != memory_headers.identity.time_date_stamp)
+            {
+                return "TimeDateStamp";
+            }
+
+            if (file_headers.identity.size_of_image != memory_headers.identity.size_of_image)
+            {
+                return "SizeOfImage";
+            }
+
+            if (file_headers.checksum != memory_headers.checksum)
+            {
+                return "CheckSum";
+            }
+
+            if (file_headers.sections != memory_headers.sections)
+            {
+                return "section table";
+            }
+
+            return nullptr;
+        }
+
+        // Headers that can't be read or parsed, for example because they were wiped, don't prevent the scan
+        void verify_image_headers(const module_scan_context& context, const module_info& module, module_profile& profile)
+        {
+            std::optional<image_headers> memory_headers{};
+
+            {
+                const scan_profiler::scope scope{context.profiler, profile, scan_phase::read_memory};
+                memory_headers = read_module_headers(context.memory, module.base_address);
+            }
+
+            if (!memory_headers)
+            {
+                return;
+            }
+
+            profile.statistics.bytes_read += page_size;
+
+            std::optional<image_headers> file_headers{};
+
+            {
+                const scan_profiler::scope scope{context.profiler, profile, scan_phase::load_image};
+                file_headers = read_image_headers(module.path);
+            }
+
+            if (!file_headers)
+            {
+                return;
+            }
+
+            if (const auto* field = find_header_mismatch(*file_headers, *memory_headers))
+            {
+                throw std::runtime_error(std::string("Image on disk is a different build than the loaded module, ") + field + " differs");
+            }
+        }
+
+        // Windows that are closer than this are read together, a few extra bytes are cheaper than another request
+        constexpr size_t max_prologue_gap = 0x200;
+
+        struct prologue_batch
+        {
+            size_t section_index{};
+            diff_range range{};
+            std::vector<diff_range> windows{};
+        };
+
+        struct prologue_section_scan
+        {
+            size_t compared_bytes{};
+            size_t differences{};
+            size_t allowed_patches{};
+            std::vector<patch> patches{};
+
+            // End of the last run, which may lie past the window it was found in
+            uint64_t covered_until{};
+        };
+
+        size_t find_first_function(const function_index& functions, const uint32_t rva)
+        {
+            size_t low = 0;
+            size_t high = functions.size();
+
+            while (low < high)
+            {
+                const auto middle = low + ((high - low) / 2);
+
+                if (functions.get_rva(middle) < rva)
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+
+            return low;
+        }
+
+        // Grows the range so that relocated slots crossing its ends are compared as a whole
+        diff_range expand_to_relocations(const clean_section& section, diff_range range)
+        {
+            const auto find_slot = [&](const size_t offset) -> const relocation_entry* {
+                const auto rva = section.rva + offset;
+                const auto entry = std::ranges::upper_bound(section.relocations, rva, {}, &relocation_entry::rva);
+                if (entry == section.relocations.begin())
+                {
+                    return nullptr;
+                }
+
+                const auto& slot = *std::prev(entry);
+                return slot.rva < rva && slot.rva + slot.size > rva ? &slot : nullptr;
+            };
+
+            if (const auto* slot = find_slot(range.begin))
+            {
+                range.begin = slot->rva - section.rva;
+            }
+
+            if (const auto* slot = find_slot(range.end))
+            {
+                range.end = slot->rva + slot->size - section.rva;
+            }
+
+            return range;
+        }
+
+        std::vector<prologue_batch> plan_prologue_batches(const clean_image& image, const function_index& functions,
+                                                          const size_t prologue_size, const size_t max_batch_size)
+        {
+            std::vector<prologue_batch> batches{};
+
+            for (size_t section_index = 0; section_index < image.sections.size(); ++section_index)
+            {
+                const auto& section = image.sections[section_index];
+                const auto section_end = static_cast<uint64_t>(section.rva) + section.data.size();
+
+                for (auto index = find_first_function(functions, section.rva);
+                     index < functions.size() && functions.get_rva(index) < section_end; ++index)
+                {
+                    const auto begin = functions.get_rva(index) - section.rva;
+                    auto end = std::min(static_cast<uint64_t>(begin) + prologue_size, section_end - section.rva);
+
+                    if (index + 1 < functions.size())
+                    {
+                        end = std::min(end, static_cast<uint64_t>(functions.get_rva(index + 1) - section.rva));
+                    }
+
+                    const auto window = expand_to_relocations(section, {begin, static_cast<size_t>(end)});
+
+                    auto* batch = batches.empty() ? nullptr : &batches.back();
+                    if (batch && batch->section_index == section_index && window.begin <= batch->range.end + max_prologue_gap &&
+                        window.end - batch->range.begin <= max_batch_size)
+                    {
+                        auto& last_window = batch->windows.back();
+                        if (window.begin <= last_window.end)
+                        {
+                            last_window.end = std::max(last_window.end, window.end);
+                        }
+                        else
+                        {
+                            batch->windows.emplace_back(window);
+                        }
+
+                        batch->range.end = std::max(batch->range.end, window.end);
+                        continue;
+                    }
+
+                    batches.emplace_back(prologue_batch{
+                        .section_index = section_index,
+                        .range = window,
+                        .windows = {window},
+                    });
+                }
+            }
+
+            return batches;
+        }
+
+        // Part of a section as a section of its own, with the slots that lie in it
+        clean_section get_section_part(const clean_section& section, const diff_range range)
+        {
+            const auto rva = static_cast<uint32_t>(section.rva + range.begin);
+            const auto size = range.end - range.begin;
+
+            clean_section part{
+                .rva = rva,
+                .data = section.data.subspan(range.begin, size),
+            };
+
+            const auto first_slot = std::ranges::lower_bound(section.relocations, rva, {}, &relocation_entry::rva);
+            const auto last_slot = std::ranges::lower_bound(first_slot, section.relocations.end(), rva + size, {}, &relocation_entry::rva);
+            part.relocations.assign(first_slot, last_slot);
+
+            return part;
+        }
+
+        // Runtime bytes of a batch. Ranges around it are read on demand.
+        struct prologue_batch_data
+        {
+            const module_scan_context* context{};
+            const clean_section* section{};
+            uint64_t section_address{};
+            diff_range range{};
+            std::span<const uint8_t> data{};
+            std::vector<uint8_t> buffer{};
+
+            std::optional<std::span<const uint8_t>> get(const diff_range part, scan_statistics& statistics)
+            {
+                const auto size = part.end - part.begin;
+                if (part.begin >= this->range.begin && part.end <= this->range.end)
+                {
+                    return this->data.subspan(part.begin - this->range.begin, size);
+                }
+
+                const auto address = this->section_address + part.begin;
+                statistics.bytes_read += size;
+
+                const auto view = this->context->memory.get_memory_view(address, size);
+                if (view.size() == size)
+                {
+                    return view;
+                }
+
+                this->buffer.resize(size);
+                if (!this->context->memory.read_memory(address, this->buffer).get())
+                {
+                    return std::nullopt;
+                }
+
+                return std::span<const uint8_t>(this->buffer);
+            }
+        };
+
+        // Runs that grow by fewer bytes than this at a time end within one more step
+        constexpr size_t patch_extension_size = 0x40;
+
+        // A run that touches the edge of a window may go on past it, so it is followed through the section until it ends.
+        // That way quick scans report the same patches as full scans, which allowlists recorded by either rely on.
+        patch complete_patch(const int64_t delta, prologue_batch_data& batch, const diff_range window, patch entry,
+                             scan_statistics& statistics)
+        {
+            const auto& section = *batch.section;
+
+            const auto diff_part = [&](const diff_range range) -> std::optional<std::vector<patch>> {
+                const auto runtime_data = batch.get(range, statistics);
+                if (!runtime_data)
+                {
+                    return std::nullopt;
+                }
+
+                statistics.bytes_compared += range.end - range.begin;
+                batch.context->profiler.add_compared_bytes(range.end - range.begin);
+
+                return find_differences(get_section_part(section, range), *runtime_data, delta, batch.section_address + range.begin);
+            };
+
+            auto begin = static_cast<size_t>(entry.address - batch.section_address);
+            auto end = begin + static_cast<size_t>(entry.length);
+
+            for (auto reached_edge = begin == window.begin; reached_edge && begin > 0;)
+            {
+                const auto range = expand_to_relocations(section, {begin - std::min(begin, patch_extension_size), begin});
+                const auto patches = diff_part(range);
+                if (!patches)
+                {
+                    break;
+                }
+
+                const auto previous_begin = begin;
+                for (const auto& found : *patches | std::views::reverse)
+                {
+                    const auto found_begin = static_cast<size_t>(found.address - batch.section_address);
+                    if (found_begin + found.length >= begin && found_begin < begin)
+                    {
+                        begin = found_begin;
+                    }
+                }
+
+                reached_edge = begin != previous_begin && begin == range.begin;
+            }
+
+            for (auto reached_edge = end == window.end; reached_edge && end < section.data.size();)
+            {
+                const auto range = expand_to_relocations(section, {end, std::min(end + patch_extension_size, section.data.size())});
+                const auto patches = diff_part(range);
+                if (!patches)
+                {
+                    break;
+                }
+
+                const auto previous_end = end;
+                for (const auto& found : *patches)
+                {
+                    const auto found_begin = static_cast<size_t>(found.address - batch.section_address);
+                    if (found_begin <= end && found_begin + found.length > end)
+                    {
+                        end = found_begin + static_cast<size_t>(found.length);
+                    }
+                }
+
+                reached_edge = end != previous_end && end == range.end;
+            }
+
+            entry.address = batch.section_address + begin;
+            entry.length = end - begin;
+
+            return entry;
+        }
+
+        // The batch is diffed as a section of its own, so that the runtime data only has to cover the batch
+        void diff_prologue_batch(const module_scan_context& context, const int64_t delta, const patch_filter& filter,
+                                 const clean_section& section, const prologue_batch& batch, const std::span<const uint8_t> data,
+                                 prologue_section_scan& scan, scan_statistics& statistics)
+        {
+            const auto batch_section = get_section_part(section, batch.range);
+            const auto batch_address = filter.base_address + batch_section.rva;
+
+            prologue_batch_data batch_data{
+                .context = &context,
+                .section = &section,
+                .section_address = filter.base_address + section.rva,
+                .range = batch.range,
+                .data = data,
+            };
+
+            for (const auto& window : batch.windows)
+            {
+                const diff_range range{window.begin - batch.range.begin, window.end - batch.range.begin};
+
+                statistics.bytes_compared += range.end - range.begin;
+                context.profiler.add_compared_bytes(range.end - range.begin);
+                statistics.relocated_slots += count_relocated_slots(batch_section, range);
+                scan.compared_bytes += range.end - range.begin;
+
+                const auto patches = find_differences(batch_section, data, delta, batch_address, range, std::numeric_limits<size_t>::max());
+                if (!patches)
+                {
+                    continue;
+                }
+
+                for (const auto& found : *patches)
+                {
+                    // Only bytes within the window count towards the rule that sections must mostly be equal
+                    scan.differences += found.length;
+
+                    auto entry = complete_patch(delta, batch_data, window, found, statistics);
+
+                    // Runs that were followed out of an earlier window are only reported once
+                    if (entry.address + entry.length <= scan.covered_until)
+                    {
+                        continue;
+                    }
+
+                    if (entry.address < scan.covered_until)
+                    {
+                        entry.length -= scan.covered_until - entry.address;
+                        entry.address = scan.covered_until;
+                    }
+
+                    scan.covered_until = entry.address + entry.length;
+
+                    if (filter.is_active())
+                    {
+                        const diff_range patch_range{static_cast<size_t>(entry.address - batch_data.section_address),
+                                                     static_cast<size_t>(scan.covered_until - batch_data.section_address)};
+
+                        const auto bytes = batch_data.get(patch_range, statistics);
+                        if (bytes && filter.is_allowed(entry.address, entry.length, entry.address, *bytes))
+                        {
+                            ++scan.allowed_patches;
+                            continue;
+                        }
+                    }
+
+                    append_patches(scan.patches, std::span(&entry, 1));
+                }
+            }
+        }
+
+        struct pointer_slot_run
+        {
+            size_t first_slot{};
+            size_t slot_count{};
+            size_t value_offset{};
+
+            // Page aligned
+            uint32_t rva{};
+            size_t size{};
+        };
+
+        // Only pages that hold slots are read. Slots on the same or adjacent pages are read together, up to the maximum read size.
+        std::vector<pointer_slot_run> plan_pointer_slot_runs(const pointer_slot_table& table, const size_t max_read_size)
+        {
+            std::vector<pointer_slot_run> runs{};
+            size_t value_offset = 0;
+
+            for (size_t i = 0; i < table.slots.size(); ++i)
+            {
+                const auto& slot = table.slots[i];
+                const auto begin = static_cast<uint32_t>(align_down(slot.rva, page_size));
+                const auto end = align_up(static_cast<uint64_t>(slot.rva) + slot.size, page_size);
+
+                auto* run = runs.empty() ? nullptr : &runs.back();
+                if (run && begin <= run->rva + run->size && end - run->rva <= max_read_size)
+                {
+                    run->size = static_cast<size_t>(std::max<uint64_t>(run->rva + run->size, end) - run->rva);
+                    ++run->slot_count;
+                }
+                else
+                {
+                    runs.emplace_back(pointer_slot_run{
+                        .first_slot = i,
+                        .slot_count = 1,
+                        .value_offset = value_offset,
+                        .rva = begin,
+                        .size = static_cast<size_t>(end - begin),
+                    });
+                }
+
+                value_offset += slot.size;
+            }
+
+            return runs;
+        }
+
+        // Read with a single request first and page by page if that fails, so that a missing page only hides the slots on it
+        std::span<const uint8_t> read_pointer_slot_run(const module_scan_context& context, const uint64_t address, const size_t size,
+                                                       std::vector<uint8_t>& buffer, std::vector<diff_range>& unreadable,
+                                                       module_profile& profile)
+        {
+            auto& statistics = profile.statistics;
+            statistics.bytes_read += size;
+
+            const auto view = context.memory.get_memory_view(address, size);
+            if (view.size() == size)
+            {
+                return view;
+            }
+
+            const buffer_reservation reservation{context.profiler, size};
+            statistics.peak_buffer_size = std::max(statistics.peak_buffer_size, static_cast<uint64_t>(size));
+
+            buffer.resize(size);
+            const scan_profiler::scope scope{context.profiler, profile, scan_phase::read_memory};
+
+            if (context.memory.read_memory(address, buffer).get())
+            {
+                return buffer;
+            }
+
+            for (size_t offset = 0; offset < size; offset += page_size)
+            {
+                const auto page = std::span(buffer).subspan(offset, std::min(page_size, size - offset));
+                if (!context.memory.read_memory(address + offset, page).get())
+                {
+                    add_unreadable_range(unreadable, offset, page.size());
+                }
+            }
+
+            return buffer;
+        }
+    }
+
+    module_scan_result scan_module(const module_scan_context& context, const clean_image& image, const uint64_t base_address,
+                                   module_profile& profile)
+    {
+        module_scan_result result{};
+
+        const auto delta = image.get_delta(base_address);
+        auto regions = plan_regions(image, base_address);
+        const patch_filter filter{context.allowlist, image.identity, base_address};
+
+        // Unreadable pages have no hash, so a module that had any is always compared again
+        if (context.baseline && !context.baseline->page_hashes.empty() &&
+            has_same_pages(context, regions, context.baseline->page_hashes, profile))
+        {
+            result.patches = context.baseline->patches;
+            result.page_hashes = context.baseline->page_hashes;
+            return result;
+        }
+
+        for (auto& region : regions)
+        {
+            if (context.cancelled)
+            {
+                return {};
+            }
+
+            scan_region(context, delta, filter, region, result, profile);
+        }
+
+        if (context.cancelled)
+        {
+            return {};
+        }
+
+        return result;
+    }
+
+    module_scan_result scan_function_prologues(const module_scan_context& context, const clean_image& image,
+                                               const function_index& functions, const uint64_t base_address, module_profile& profile)
+    {
+        module_scan_result result{};
+
+        const auto delta = image.get_delta(base_address);
+        const auto max_batch_size = std::max(context.options.max_read_size, page_size);
+        const auto batches = plan_prologue_batches(image, functions, context.options.prologue_size, max_batch_size);
+        const patch_filter filter{context.allowlist, image.identity, base_address};
+
+        auto& statistics = profile.statistics;
+        std::vector<prologue_section_scan> scans(image.sections.size());
+
+        const auto get_batch_address = [&](const prologue_batch& batch) {
+            return base_address + image.sections[batch.section_index].rva + batch.range.begin;
+        };
+
+        struct batch_read
+        {
+            std::vector<uint8_t> data{};
+            std::span<const uint8_t> view{};
+            std::future<bool> result{};
+        };
+
+        const auto issue_read = [&](const prologue_batch& batch) {
+            const auto address = get_batch_address(batch);
+            const auto size = batch.range.end - batch.range.begin;
+
+            batch_read read{};
+            read.view = context.memory.get_memory_view(address, size);
+
+            if (read.view.size() == size)
+            {
+                read.result = make_ready_read_result(true);
+                return read;
+            }
+
+            read.data.resize(size);
+            read.view = read.data;
+            read.result = context.memory.read_memory(address, read.data);
+
+            return read;
+        };
+
+        size_t largest_batch{};
+        for (const auto& batch : batches)
+        {
+            largest_batch = std::max(largest_batch, batch.range.end - batch.range.begin);
+        }
+
+        // At most two batches are alive at the same time
+        const buffer_reservation reservation{context.profiler, 2 * largest_batch};
+        statistics.peak_buffer_size = std::max(statistics.peak_buffer_size, static_cast<uint64_t>(2 * largest_batch));
+
+        // The next batch is read while the current one is compared
+        std::optional<batch_read> pending{};
+        if (!batches.empty())
+        {
+            pending = issue_read(batches.front());
+        }
+
+        for (size_t index = 0; index < batches.size(); ++index)
+        {
+            auto current = std::move(*pending);
+            pending.reset();
+
+            bool success{};
+
+            {
+                const scan_profiler::scope scope{context.profiler, profile, scan_phase::read_memory};
+                success = current.result.get();
+            }
+
+            if (index + 1 < batches.size() && !context.cancelled)
+            {
+                pending = issue_read(batches[index + 1]);
+            }
+
+            const auto& batch = batches[index];
+            const auto size = batch.range.end - batch.range.begin;
+
+            if (!success)
+            {
+                result.unreadable_ranges.emplace_back(get_batch_address(batch), size);
+            }
+            else
+            {
+                statistics.bytes_read += size;
+
+                try
+                {
+                    const scan_profiler::scope scope{context.profiler, profile, scan_phase::diff};
+                    diff_prologue_batch(context, delta, filter, image.sections[batch.section_index], batch, current.view,
+                                        scans[batch.section_index], statistics);
+                }
+                catch (...)
+                {
+                    if (pending)
+                    {
+                        pending->result.wait();
+                    }
+
+                    throw;
+                }
+            }
+
+            if (context.cancelled)
+            {
+                if (pending)
+                {
+                    pending->result.wait();
+                }
+
+                return {};
+            }
+        }
+
+        // Same rule as for full scans, sections that mostly differ are not the same code
+        for (auto& scan : scans)
+        {
+            const auto max_differences = get_max_differences_for_analysis(scan.compared_bytes);
+            if (max_differences && scan.differences <= *max_differences)
+            {
+                result.patches.insert(result.patches.end(), scan.patches.begin(), scan.patches.end());
+                result.allowed_patches += scan.allowed_patches;
+            }
+        }
+
+        return result;
+    }
+
+    void scan_data_sections(const module_scan_context& context, const clean_image& image, const uint64_t base_address,
+                            module_scan_result& result, module_profile& profile)
+    {
+        if (!image.pointer_slots)
+        {
+            return;
+        }
+
+        const auto& table = *image.pointer_slots;
+        const auto delta = image.get_delta(base_address);
+        const patch_filter filter{context.allowlist, image.identity, base_address};
+        auto& statistics = profile.statistics;
+
+        const auto runs = plan_pointer_slot_runs(table, std::max(context.options.max_read_size, page_size));
+        std::vector<uint8_t> buffer{};
+
+        for (const auto& run : runs)
+        {
+            if (context.cancelled)
+            {
+                return;
+            }
+
+            const auto address = base_address + run.rva;
+            const auto slots = std::span(table.slots).subspan(run.first_slot, run.slot_count);
+
+            std::vector<diff_range> unreadable{};
+            const auto data = read_pointer_slot_run(context, address, run.size, buffer, unreadable, profile);
+
+            for (const auto& range : unreadable)
+            {
+                statistics.bytes_read -= range.end - range.begin;
+                result.unreadable_ranges.emplace_back(address + range.begin, range.end - range.begin);
+            }
+
+            const auto is_readable = [&](const relocation_entry& slot) {
+                const auto offset = slot.rva - run.rva;
+                return std::ranges::none_of(unreadable, [&](const diff_range& range) {
+                    return offset < range.end && range.begin < offset + slot.size;
+                });
+            };
+
+            const auto compare_slots = [&](const size_t first, const size_t count, const size_t value_offset) {
+                if (count == 0)
+                {
+                    return;
+                }
+
+                uint64_t slot_bytes{};
+                for (const auto& slot : slots.subspan(first, count))
+                {
+                    slot_bytes += slot.size;
+                }
+
+                statistics.bytes_compared += slot_bytes;
+                statistics.relocated_slots += count;
+                context.profiler.add_compared_bytes(slot_bytes);
+
+                const scan_profiler::scope scope{context.profiler, profile, scan_phase::diff};
+                const auto values = std::span(table.values).subspan(value_offset);
+                const auto patches = find_pointer_differences(slots.subspan(first, count), values, data, run.rva, delta, base_address);
+
+                for (const auto& entry : patches)
+                {
+                    if (filter.is_allowed(entry.address, entry.size, address, data))
+                    {
+                        ++result.allowed_patches;
+                    }
+                    else
+                    {
+                        result.pointer_patches.push_back(entry);
+                    }
+                }
+            };
+
+            // Slots on pages that couldn't be read are left out
+            size_t first = 0;
+            size_t first_value = run.value_offset;
+            size_t value_offset = run.value_offset;
+
+            for (size_t i = 0; i < slots.size(); ++i)
+            {
+                value_offset += slots[i].size;
+
+                if (!is_readable(slots[i]))
+                {
+                    compare_slots(first, i - first, first_value);
+                    first = i + 1;
+                    first_value = value_offset;
+                }
+            }
+
+            compare_slots(first, slots.size() - first, first_value);
+        }
+    }
+
+    module_scan_result scan_module_file(const module_scan_context& context, image_cache& cache, const module_info& module,
+                                        module_profile& profile)
+    {
+        // A different build is detected from the headers, before the image is loaded or any section is read
+        verify_image_headers(context, module, profile);
+
+        std::shared_ptr<const loaded_image> image{};
+
+        {
+            const scan_profiler::scope scope{context.profiler, profile, scan_phase::load_image};
+            image = cache.get_image(module.path, context.options.pointer_scan);
+        }
+
+        if (!image)
+        {
+            return {};
+        }
+
+        if (module.identity && *module.identity != image->image.identity)
+        {
+            throw std::runtime_error("Image on disk is a different build than the loaded module");
+        }
+
+        auto result = context.options.prologue_size > 0 && !image->functions.empty()
+                          ? scan_function_prologues(context, image->image, image->functions, module.base_address, profile)
+                          : scan_module(context, image->image, module.base_address, profile);
+
+        if (context.options.pointer_scan && !context.cancelled)
+        {
+            scan_data_sections(context, image->image, module.base_address, result, profile);
+        }
+
+        return result;
+    }
+
+    // The section table lies within the first page for all but the most unusual images
+    std::optional<image_headers> read_module_headers(memory_source& memory, const uint64_t base_address)
+    {
+        std::vector<uint8_t> data(page_size);
+        if (!memory.read_memory(base_address, data).get())
+        {
+            return std::nullopt;
+        }
+
+        try
+        {
+            return parse_image_headers(utils::safe_buffer_accessor<const uint8_t>{std::span<const uint8_t>(data)});
+        }
+        catch (...)
+        {
+            return std::nullopt;
+        }
+    }
+
+    std::vector<size_t> get_scan_order(const std::span<const module_info> modules)
+    {
+        std::vector<size_t> order(modules.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+
+        std::ranges::stable_sort(order, std::greater{}, [&](const size_t index) { return modules[index].size; });
+        return order;
+    }
+}
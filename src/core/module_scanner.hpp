@@ -0,0 +1,112 @@
+#pragma once
+
+#include <span>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <optional>
+
+#include "diff_engine.hpp"
+#include "clean_image.hpp"
+#include "image_cache.hpp"
+#include "thread_pool.hpp"
+#include "scan_options.hpp"
+#include "scan_profiler.hpp"
+#include "memory_source.hpp"
+#include "function_index.hpp"
+#include "patch_allowlist.hpp"
+
+namespace momo
+{
+    struct memory_range
+    {
+        uint64_t address{};
+        uint64_t size{};
+    };
+
+    struct page_hash
+    {
+        uint64_t address{};
+        uint64_t hash{};
+    };
+
+    struct module_scan_result
+    {
+        std::vector<patch> patches{};
+        std::vector<pointer_patch> pointer_patches{};
+        std::vector<memory_range> unreadable_ranges{};
+        std::vector<page_hash> page_hashes{};
+
+        // Patches that were dropped because they are on the allowlist
+        size_t allowed_patches{};
+    };
+
+    // What the last scan of a module found, taken over as long as none of its pages changed
+    struct module_baseline
+    {
+        std::vector<patch> patches{};
+
+        // Sorted by address
+        std::vector<page_hash> page_hashes{};
+    };
+
+    struct module_scan_context
+    {
+        const scan_options& options;
+        memory_source& memory;
+        utils::thread_pool& pool;
+        const std::atomic_bool& cancelled;
+        scan_profiler& profiler;
+
+        // Hashes the content of every page that was read, so that later scans can tell which pages changed
+        bool hash_pages{false};
+
+        // Expected patches, they are dropped before they end up in the result
+        const patch_allowlist* allowlist{nullptr};
+
+        // Pages are hashed before they are compared. If they all match, the code is not compared again.
+        const module_baseline* baseline{nullptr};
+    };
+
+    /*****************************************************************************
+     * Compares the executable sections of a module against its clean image.
+     * Sections that follow each other in memory are read together in page
+     * aligned chunks. While one chunk is compared the next one is already
+     * being read, so only two chunks are held in memory at any time.
+     * Pages that can't be read are skipped and reported.
+     * With a baseline whose page hashes all still match, the patches of the
+     * baseline are returned without comparing anything.
+     ****************************************************************************/
+
+    module_scan_result scan_module(const module_scan_context& context, const clean_image& image, uint64_t base_address,
+                                   module_profile& profile);
+
+    /*****************************************************************************
+     * Quick triage for inline hooks. Only the first prologue_size bytes of
+     * every known function start are compared. Windows that lie close to
+     * each other are read together, so a module takes a few large reads
+     * instead of one per function. Runs that touch the edge of a window are
+     * followed until they end, so patches are reported exactly as by a full
+     * scan and match the same allowlist entries.
+     ****************************************************************************/
+
+    module_scan_result scan_function_prologues(const module_scan_context& context, const clean_image& image,
+                                               const function_index& functions, uint64_t base_address, module_profile& profile);
+
+    // Compares the relocated pointer slots of the read-only data sections, which hold vtables and function pointer tables.
+    // Only the pages that hold slots are read. Requires an image that was loaded with its pointer slots.
+    void scan_data_sections(const module_scan_context& context, const clean_image& image, uint64_t base_address, module_scan_result& result,
+                            module_profile& profile);
+
+    // Loads the clean image of the module from the cache and scans the module with it.
+    // Only function prologues are scanned if a prologue size is set and the image has known function starts.
+    // Data sections are scanned as well if pointer scans are enabled.
+    module_scan_result scan_module_file(const module_scan_context& context, image_cache& cache, const module_info& module,
+                                        module_profile& profile);
+
+    // Reads the PE headers of a loaded module with a single request. Returns nothing if they can't be read or were wiped.
+    std::optional<image_headers> read_module_headers(memory_source& memory, uint64_t base_address);
+
+    // Largest modules first, so that no single big module is left for the end
+    std::vector<size_t> get_scan_order(std::span<const module_info> modules);
+}
@@ -0,0 +1,184 @@
+#include "module_store.hpp"
+#include "loaded_image.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+
+namespace momo
+{
+    namespace
+    {
+        constexpr auto index_file_name = "index.txt";
+
+        uint64_t get_identity_key(const image_identity& identity)
+        {
+            return (static_cast<uint64_t>(identity.time_date_stamp) << 32) | identity.size_of_image;
+        }
+    }
+
+    std::string format_image_identity(const image_identity& identity)
+    {
+        char buffer[32]{};
+        snprintf(buffer, sizeof(buffer), "%08X%X", identity.time_date_stamp, identity.size_of_image);
+        return buffer;
+    }
+
+    std::optional<image_identity> parse_image_identity(const std::string_view text)
+    {
+        constexpr size_t time_date_stamp_length = 8;
+        if (text.size() <= time_date_stamp_length)
+        {
+            return std::nullopt;
+        }
+
+        image_identity identity{};
+
+        const auto parse_field = [](const std::string_view field, uint32_t& value) {
+            const auto* end = field.data() + field.size();
+            const auto [ptr, ec] = std::from_chars(field.data(), end, value, 16);
+            return ec == std::errc{} && ptr == end;
+        };
+
+        if (!parse_field(text.substr(0, time_date_stamp_length), identity.time_date_stamp) ||
+            !parse_field(text.substr(time_date_stamp_length), identity.size_of_image))
+        {
+            return std::nullopt;
+        }
+
+        return identity;
+    }
+
+    module_store::module_store(std::filesystem::path directory)
+        : directory_(std::move(directory))
+    {
+        this->load_index();
+    }
+
+    std::optional<std::filesystem::path> module_store::find(const image_identity& identity) const
+    {
+        const auto entry = this->images_.find(get_identity_key(identity));
+        if (entry == this->images_.end())
+        {
+            return std::nullopt;
+        }
+
+        return this->directory_ / std::filesystem::path(entry->second);
+    }
+
+    bool module_store::resolve_module(module_info& module) const
+    {
+        if (!module.identity)
+        {
+            return false;
+        }
+
+        const auto path = this->find(*module.identity);
+        if (!path)
+        {
+            return false;
+        }
+
+        module.path = path->string();
+        return true;
+    }
+
+    size_t module_store::add_directory(const std::filesystem::path& directory)
+    {
+        size_t added = 0;
+
+        std::error_code ec{};
+        for (auto entry = std::filesystem::recursive_directory_iterator(directory, ec); !ec && entry != std::filesystem::end(entry);
+             entry.increment(ec))
+        {
+            if (entry->is_regular_file(ec) && this->add_file(entry->path()))
+            {
+                ++added;
+            }
+        }
+
+        if (ec)
+        {
+            throw std::runtime_error("Failed to walk directory: " + directory.string());
+        }
+
+        return added;
+    }
+
+    bool module_store::add_file(const std::filesystem::path& path)
+    {
+        const auto headers = read_image_headers(path);
+        if (!headers)
+        {
+            return false;
+        }
+
+        const auto key = get_identity_key(headers->identity);
+        if (this->images_.contains(key))
+        {
+            return false;
+        }
+
+        const auto file_name = path.filename();
+        const auto relative_path = file_name / format_image_identity(headers->identity) / file_name;
+        const auto target = this->directory_ / relative_path;
+
+        std::error_code ec{};
+        std::filesystem::create_directories(target.parent_path(), ec);
+        std::filesystem::copy_file(path, target, std::filesystem::copy_options::overwrite_existing, ec);
+
+        if (ec)
+        {
+            throw std::runtime_error("Failed to copy " + path.string() + " into the module store");
+        }
+
+        const auto generic_path = relative_path.generic_string();
+        this->append_index(headers->identity, generic_path);
+        this->images_[key] = generic_path;
+
+        return true;
+    }
+
+    // Lines have the form "<TimeDateStamp><SizeOfImage> <path relative to the store>"
+    void module_store::load_index()
+    {
+        std::ifstream stream{this->directory_ / index_file_name};
+
+        std::string line{};
+        while (std::getline(stream, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            const auto separator = line.find(' ');
+            if (separator == std::string::npos || line.starts_with('#'))
+            {
+                continue;
+            }
+
+            const auto identity = parse_image_identity(std::string_view(line).substr(0, separator));
+            if (identity)
+            {
+                this->images_[get_identity_key(*identity)] = line.substr(separator + 1);
+            }
+        }
+    }
+
+    void module_store::append_index(const image_identity& identity, const std::string& path) const
+    {
+        std::error_code ec{};
+        std::filesystem::create_directories(this->directory_, ec);
+
+        std::ofstream stream{this->directory_ / index_file_name, std::ios::app};
+        stream << format_image_identity(identity) << ' ' << path << '\n';
+
+        if (!stream)
+        {
+            throw std::runtime_error("Failed to write the module store index");
+        }
+    }
+}
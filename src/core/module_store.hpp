@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <filesystem>
+#include <unordered_map>
+
+#include "clean_image.hpp"
+#include "memory_source.hpp"
+
+namespace momo
+{
+    // <TimeDateStamp><SizeOfImage> in hex, the format the symbol server uses for binaries
+    std::string format_image_identity(const image_identity& identity);
+    std::optional<image_identity> parse_image_identity(std::string_view text);
+
+    /*****************************************************************************
+     * Local repository of module images, laid out like a symbol store:
+     * <store>/<file name>/<TimeDateStamp><SizeOfImage>/<file name>.
+     * The images are listed in an index file, which is loaded once, so
+     * lookups by identity don't touch the file system. This allows scanning
+     * remote targets, whose module paths don't exist on this machine.
+     * Lookups are thread-safe, adding images is not.
+     ****************************************************************************/
+
+    class module_store
+    {
+      public:
+        explicit module_store(std::filesystem::path directory);
+
+        std::optional<std::filesystem::path> find(const image_identity& identity) const;
+
+        // Points the module at the stored image of the same build, if its identity is known and there is one
+        bool resolve_module(module_info& module) const;
+
+        // Copies every PE file below the directory into the store, returns the number of images that were new
+        size_t add_directory(const std::filesystem::path& directory);
+
+        // Returns whether the file is a PE image that wasn't stored yet
+        bool add_file(const std::filesystem::path& path);
+
+        size_t size() const
+        {
+            return this->images_.size();
+        }
+
+        const std::filesystem::path& get_directory() const
+        {
+            return this->directory_;
+        }
+
+      private:
+        std::filesystem::path directory_{};
+
+        // Paths relative to the store
+        std::unordered_map<uint64_t, std::string> images_{};
+
+        void load_index();
+        void append_index(const image_identity& identity, const std::string& path) const;
+    };
+}
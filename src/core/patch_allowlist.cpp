@@ -0,0 +1,273 @@
+#include "patch_allowlist.hpp"
+#include "mapped_file.hpp"
+#include "module_store.hpp"
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <charconv>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+namespace momo
+{
+    namespace
+    {
+        constexpr uint32_t allowlist_magic = 0x4C414650; // PFAL
+        constexpr uint32_t allowlist_version = 1;
+
+        struct allowlist_header
+        {
+            uint32_t magic{};
+            uint32_t version{};
+            uint64_t entry_count{};
+        };
+
+        struct allowlist_entry
+        {
+            uint32_t time_date_stamp{};
+            uint32_t size_of_image{};
+            uint32_t rva{};
+            uint32_t length{};
+            uint64_t hash{};
+        };
+
+        static_assert(sizeof(allowlist_entry) == 24);
+
+        bool is_binary_allowlist(const std::span<const std::byte> data)
+        {
+            uint32_t magic{};
+            if (data.size() < sizeof(magic))
+            {
+                return false;
+            }
+
+            memcpy(&magic, data.data(), sizeof(magic));
+            return magic == allowlist_magic;
+        }
+
+        template <typename T>
+        bool parse_hex(const std::string_view field, T& value)
+        {
+            const auto* end = field.data() + field.size();
+            const auto [ptr, ec] = std::from_chars(field.data(), end, value, 16);
+            return ec == std::errc{} && ptr == end;
+        }
+
+        std::string_view next_field(std::string_view& line)
+        {
+            const auto begin = line.find_first_not_of(" \t");
+            if (begin == std::string_view::npos)
+            {
+                line = {};
+                return {};
+            }
+
+            line.remove_prefix(begin);
+
+            const auto end = std::min(line.find_first_of(" \t"), line.size());
+            const auto field = line.substr(0, end);
+            line.remove_prefix(end);
+
+            return field;
+        }
+
+        std::optional<allowed_patch> parse_line(std::string_view line)
+        {
+            const auto identity = parse_image_identity(next_field(line));
+            if (!identity)
+            {
+                return std::nullopt;
+            }
+
+            allowed_patch entry{};
+            entry.identity = *identity;
+
+            if (!parse_hex(next_field(line), entry.rva) || !parse_hex(next_field(line), entry.length) ||
+                !parse_hex(next_field(line), entry.hash) || !next_field(line).empty())
+            {
+                return std::nullopt;
+            }
+
+            return entry;
+        }
+    }
+
+    uint64_t hash_patch_bytes(const std::span<const uint8_t> data)
+    {
+        uint64_t hash = 0xcbf29ce484222325;
+
+        for (const auto value : data)
+        {
+            hash ^= value;
+            hash *= 0x100000001b3;
+        }
+
+        return hash;
+    }
+
+    allowed_patch make_allowed_patch(const image_identity& identity, const uint64_t rva, const std::span<const uint8_t> data)
+    {
+        return allowed_patch{
+            .identity = identity,
+            .rva = static_cast<uint32_t>(rva),
+            .length = static_cast<uint32_t>(data.size()),
+            .hash = hash_patch_bytes(data),
+        };
+    }
+
+    void patch_allowlist::load(const std::filesystem::path& path)
+    {
+        const utils::mapped_file file{path};
+        if (file.empty())
+        {
+            // Empty files can't be mapped, but are valid allowlists
+            std::error_code ec{};
+            if (std::filesystem::is_regular_file(path, ec))
+            {
+                return;
+            }
+
+            throw std::runtime_error("Failed to open allowlist: " + path.string());
+        }
+
+        const auto data = file.get_data();
+
+        if (is_binary_allowlist(data))
+        {
+            this->load_binary(data);
+        }
+        else
+        {
+            this->load_text(data);
+        }
+    }
+
+    bool patch_allowlist::add(const allowed_patch& entry)
+    {
+        return this->entries_.insert(entry);
+    }
+
+    // Fixed size entries after the header, so the table can be sized before anything is inserted
+    void patch_allowlist::load_binary(const std::span<const std::byte> data)
+    {
+        allowlist_header header{};
+        if (data.size() < sizeof(header))
+        {
+            throw std::runtime_error("Allowlist is truncated");
+        }
+
+        memcpy(&header, data.data(), sizeof(header));
+
+        if (header.version != allowlist_version)
+        {
+            throw std::runtime_error("Unsupported allowlist version " + std::to_string(header.version));
+        }
+
+        const auto available = (data.size() - sizeof(header)) / sizeof(allowlist_entry);
+        if (header.entry_count > available)
+        {
+            throw std::runtime_error("Allowlist is truncated");
+        }
+
+        const auto count = static_cast<size_t>(header.entry_count);
+        this->entries_.reserve(this->entries_.size() + count);
+
+        const auto* entries = data.data() + sizeof(header);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            allowlist_entry entry{};
+            memcpy(&entry, entries + (i * sizeof(entry)), sizeof(entry));
+
+            this->entries_.insert(allowed_patch{
+                .identity = {entry.time_date_stamp, entry.size_of_image},
+                .rva = entry.rva,
+                .length = entry.length,
+                .hash = entry.hash,
+            });
+        }
+    }
+
+    // Lines have the form "<TimeDateStamp><SizeOfImage> <rva> <length> <hash>", all in hex
+    void patch_allowlist::load_text(const std::span<const std::byte> data)
+    {
+        const std::string_view text{reinterpret_cast<const char*>(data.data()), data.size()};
+        this->entries_.reserve(this->entries_.size() + std::ranges::count(text, '\n') + 1);
+
+        size_t line_number = 0;
+        size_t offset = 0;
+
+        while (offset < text.size())
+        {
+            const auto end = std::min(text.find('\n', offset), text.size());
+            auto line = text.substr(offset, end - offset);
+            offset = end + 1;
+            ++line_number;
+
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+
+            if (line.find_first_not_of(" \t") == std::string_view::npos || line.starts_with('#'))
+            {
+                continue;
+            }
+
+            const auto entry = parse_line(line);
+            if (!entry)
+            {
+                throw std::runtime_error("Invalid allowlist entry in line " + std::to_string(line_number));
+            }
+
+            this->entries_.insert(*entry);
+        }
+    }
+
+    void write_patch_allowlist(const std::filesystem::path& path, const std::span<const allowed_patch> entries, const bool binary)
+    {
+        std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+
+        if (binary)
+        {
+            const allowlist_header header{
+                .magic = allowlist_magic,
+                .version = allowlist_version,
+                .entry_count = entries.size(),
+            };
+
+            stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+            for (const auto& entry : entries)
+            {
+                const allowlist_entry stored{
+                    .time_date_stamp = entry.identity.time_date_stamp,
+                    .size_of_image = entry.identity.size_of_image,
+                    .rva = entry.rva,
+                    .length = entry.length,
+                    .hash = entry.hash,
+                };
+
+                stream.write(reinterpret_cast<const char*>(&stored), sizeof(stored));
+            }
+        }
+        else
+        {
+            for (const auto& entry : entries)
+            {
+                char buffer[64]{};
+                snprintf(buffer, sizeof(buffer), " %X %X %016llX\n", entry.rva, entry.length, static_cast<unsigned long long>(entry.hash));
+                stream << format_image_identity(entry.identity) << buffer;
+            }
+        }
+
+        if (!stream)
+        {
+            throw std::runtime_error("Failed to write allowlist: " + path.string());
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <span>
+#include <cstdint>
+#include <filesystem>
+
+#include "hash_set.hpp"
+#include "clean_image.hpp"
+
+namespace momo
+{
+    // A patch that is expected, such as an AV hook or a hotpatch, identified by where it lies and what it writes
+    struct allowed_patch
+    {
+        image_identity identity{};
+        uint32_t rva{};
+        uint32_t length{};
+        uint64_t hash{};
+
+        bool operator==(const allowed_patch&) const = default;
+    };
+
+    struct allowed_patch_hash
+    {
+        size_t operator()(const allowed_patch& entry) const
+        {
+            const utils::integer_hash hash{};
+            const auto identity = (static_cast<uint64_t>(entry.identity.time_date_stamp) << 32) | entry.identity.size_of_image;
+            const auto location = (static_cast<uint64_t>(entry.rva) << 32) | entry.length;
+
+            return hash(entry.hash ^ hash(identity ^ hash(location)));
+        }
+    };
+
+    // FNV-1a over the patched bytes, as the hashes are stored in files and must stay the same across builds
+    uint64_t hash_patch_bytes(std::span<const uint8_t> data);
+
+    allowed_patch make_allowed_patch(const image_identity& identity, uint64_t rva, std::span<const uint8_t> data);
+
+    /*****************************************************************************
+     * Patches that are known to be fine and are dropped right after the diff,
+     * before anything is symbolized or reported. Entries are kept in an open
+     * addressing hash set, so a lookup costs about one cache miss, no matter
+     * how many millions of entries were loaded.
+     * Lookups are thread-safe, loading is not.
+     ****************************************************************************/
+
+    class patch_allowlist
+    {
+      public:
+        // Accepts both the text and the binary format, entries are added to the ones already loaded
+        void load(const std::filesystem::path& path);
+
+        bool add(const allowed_patch& entry);
+
+        bool contains(const allowed_patch& entry) const
+        {
+            return this->entries_.contains(entry);
+        }
+
+        size_t size() const
+        {
+            return this->entries_.size();
+        }
+
+        bool empty() const
+        {
+            return this->entries_.empty();
+        }
+
+      private:
+        utils::hash_set<allowed_patch, allowed_patch_hash> entries_{};
+
+        void load_binary(std::span<const std::byte> data);
+        void load_text(std::span<const std::byte> data);
+    };
+
+    void write_patch_allowlist(const std::filesystem::path& path, std::span<const allowed_patch> entries, bool binary);
+}
@@ -0,0 +1,206 @@
+#include "patch_table.hpp"
+
+#include <limits>
+#include <algorithm>
+
+namespace momo
+{
+    namespace
+    {
+        uint32_t clamp_length(const uint64_t length)
+        {
+            return static_cast<uint32_t>(std::min<uint64_t>(length, std::numeric_limits<uint32_t>::max()));
+        }
+    }
+
+    uint32_t patch_table::add_module(std::string path)
+    {
+        const auto entry = std::ranges::find(this->modules_, path);
+        if (entry != this->modules_.end())
+        {
+            return static_cast<uint32_t>(entry - this->modules_.begin());
+        }
+
+        this->modules_.emplace_back(std::move(path));
+        return static_cast<uint32_t>(this->modules_.size() - 1);
+    }
+
+    void patch_table::add_patches(const uint32_t module_index, const std::span<const patch> patches)
+    {
+        std::vector<patch_record> records{};
+        records.reserve(patches.size());
+
+        for (const auto& patch : patches)
+        {
+            records.push_back({
+                .address = patch.address,
+                .length = clamp_length(patch.length),
+                .module_index = module_index,
+            });
+        }
+
+        this->add_records(records);
+    }
+
+    void patch_table::add_pointer_patches(const uint32_t module_index, const std::span<const pointer_patch> patches)
+    {
+        std::vector<patch_record> records{};
+        records.reserve(patches.size());
+
+        for (const auto& patch : patches)
+        {
+            this->targets_.push_back({
+                .record = static_cast<uint32_t>(this->records_.size() + records.size()),
+                .target = patch.target,
+                .expected = patch.expected,
+            });
+
+            records.push_back({
+                .address = patch.address,
+                .length = clamp_length(patch.size),
+                .module_index = module_index,
+            });
+        }
+
+        this->add_records(records);
+    }
+
+    void patch_table::add_records(const std::span<const patch_record> records)
+    {
+        const auto old_size = static_cast<ptrdiff_t>(this->order_.size());
+
+        for (const auto& record : records)
+        {
+            this->records_.push_back(record);
+            this->order_.push_back(static_cast<uint32_t>(this->records_.size() - 1));
+        }
+
+        // New rows are sorted on their own and merged, so that adding a module stays cheap
+        const auto compare = [this](const uint32_t left, const uint32_t right) { return this->is_before(left, right); };
+        std::sort(this->order_.begin() + old_size, this->order_.end(), compare);
+        std::inplace_merge(this->order_.begin(), this->order_.begin() + old_size, this->order_.end(), compare);
+    }
+
+    void patch_table::remove_patches(const uint32_t module_index, const std::span<const patch> patches)
+    {
+        std::erase_if(this->order_, [&](const uint32_t index) {
+            const auto& record = this->records_[index];
+            if (record.module_index != module_index || this->has_pointer_target(index))
+            {
+                return false;
+            }
+
+            const patch key{record.address, record.length};
+            return std::ranges::binary_search(patches, key, [](const patch& left, const patch& right) {
+                return left.address != right.address ? left.address < right.address
+                                                     : clamp_length(left.length) < clamp_length(right.length);
+            });
+        });
+
+        this->compact();
+    }
+
+    void patch_table::remove_module(const std::string_view path)
+    {
+        const auto entry = std::ranges::find(this->modules_, path);
+        if (entry == this->modules_.end())
+        {
+            return;
+        }
+
+        const auto module_index = static_cast<uint32_t>(entry - this->modules_.begin());
+        std::erase_if(this->order_, [&](const uint32_t index) { return this->records_[index].module_index == module_index; });
+
+        this->compact();
+    }
+
+    const pointer_target* patch_table::get_pointer_target(const size_t row) const
+    {
+        const auto record = this->order_[row];
+        const auto entry = std::ranges::lower_bound(this->targets_, record, {}, &pointer_target::record);
+
+        return entry != this->targets_.end() && entry->record == record ? &*entry : nullptr;
+    }
+
+    bool patch_table::has_pointer_target(const uint32_t record) const
+    {
+        return std::ranges::binary_search(this->targets_, record, {}, &pointer_target::record);
+    }
+
+    // Records that no row refers to anymore are dropped, the rest is stored in row order
+    void patch_table::compact()
+    {
+        if (this->records_.size() == this->order_.size())
+        {
+            return;
+        }
+
+        std::vector<uint32_t> new_indices(this->records_.size(), std::numeric_limits<uint32_t>::max());
+        std::vector<patch_record> records{};
+        records.reserve(this->order_.size());
+
+        for (auto& index : this->order_)
+        {
+            new_indices[index] = static_cast<uint32_t>(records.size());
+            records.push_back(this->records_[index]);
+            index = new_indices[index];
+        }
+
+        std::erase_if(this->targets_, [&](pointer_target& target) {
+            target.record = new_indices[target.record];
+            return target.record == std::numeric_limits<uint32_t>::max();
+        });
+
+        std::ranges::sort(this->targets_, {}, &pointer_target::record);
+        this->records_ = std::move(records);
+    }
+
+    void patch_table::sort(const patch_sort_key key)
+    {
+        this->sort_key_ = key;
+        std::ranges::sort(this->order_, [this](const uint32_t left, const uint32_t right) { return this->is_before(left, right); });
+    }
+
+    void patch_table::clear()
+    {
+        this->modules_.clear();
+        this->records_.clear();
+        this->order_.clear();
+        this->targets_.clear();
+    }
+
+    // Longest patches come first when sorting by length, ties are broken by address
+    bool patch_table::is_before(const uint32_t left, const uint32_t right) const
+    {
+        const auto& left_record = this->records_[left];
+        const auto& right_record = this->records_[right];
+
+        switch (this->sort_key_)
+        {
+        case patch_sort_key::module: {
+            const auto& left_module = this->modules_[left_record.module_index];
+            const auto& right_module = this->modules_[right_record.module_index];
+
+            if (left_module != right_module)
+            {
+                return left_module < right_module;
+            }
+
+            break;
+        }
+
+        case patch_sort_key::length:
+            if (left_record.length != right_record.length)
+            {
+                return left_record.length > right_record.length;
+            }
+
+            break;
+
+        case patch_sort_key::address:
+            break;
+        }
+
+        return left_record.address < right_record.address;
+    }
+}
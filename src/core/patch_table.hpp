@@ -0,0 +1,96 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+
+#include "diff_engine.hpp"
+
+namespace momo
+{
+    struct patch_record
+    {
+        uint64_t address{};
+        uint32_t length{};
+        uint32_t module_index{};
+    };
+
+    // Where a changed pointer slot points now and where it should point
+    struct pointer_target
+    {
+        uint32_t record{};
+        uint64_t target{};
+        uint64_t expected{};
+    };
+
+    enum class patch_sort_key : uint8_t
+    {
+        module,
+        address,
+        length,
+    };
+
+    /*****************************************************************************
+     * Compact storage for the patches of a scan. Module paths are stored once
+     * and every record only refers to its module by index. Rows are viewed
+     * through an index that is kept in sort order as patches are added.
+     * Records only move when patches are removed. Changed pointer slots are
+     * records as well, their targets are kept on the side.
+     ****************************************************************************/
+
+    class patch_table
+    {
+      public:
+        // Returns the index the module already has if its path is known
+        uint32_t add_module(std::string path);
+        void add_patches(uint32_t module_index, std::span<const patch> patches);
+        void add_pointer_patches(uint32_t module_index, std::span<const pointer_patch> patches);
+
+        // Patches are matched by address and length and must be sorted by both. Changed pointer slots are kept.
+        void remove_patches(uint32_t module_index, std::span<const patch> patches);
+        void remove_module(std::string_view path);
+
+        size_t size() const
+        {
+            return this->order_.size();
+        }
+
+        const patch_record& get_row(const size_t row) const
+        {
+            return this->records_[this->order_[row]];
+        }
+
+        const std::string& get_module(const patch_record& record) const
+        {
+            return this->modules_[record.module_index];
+        }
+
+        // Only pointer slots have a target
+        const pointer_target* get_pointer_target(size_t row) const;
+
+        patch_sort_key get_sort_key() const
+        {
+            return this->sort_key_;
+        }
+
+        void sort(patch_sort_key key);
+        void clear();
+
+      private:
+        std::vector<std::string> modules_{};
+        std::vector<patch_record> records_{};
+        std::vector<uint32_t> order_{};
+
+        // Sorted by record
+        std::vector<pointer_target> targets_{};
+
+        patch_sort_key sort_key_{patch_sort_key::address};
+
+        void add_records(std::span<const patch_record> records);
+        void compact();
+        bool has_pointer_target(uint32_t record) const;
+        bool is_before(uint32_t left, uint32_t right) const;
+    };
+}
@@ -0,0 +1,712 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <optional>
+#include <algorithm>
+
+#include "win_pefile.hpp"
+#include "clean_image.hpp"
+#include "address_tables.hpp"
+#include "function_index.hpp"
+#include "buffer_accessor.hpp"
+
+namespace momo
+{
+    struct section_range
+    {
+        uint32_t virtual_address{};
+        uint32_t size{};
+        uint32_t file_offset{};
+    };
+
+    // Sorted by virtual address
+    using section_table = std::vector<section_range>;
+
+    namespace detail
+    {
+        template <typename SpanElement>
+        utils::safe_object_accessor<PEDosHeader_t, SpanElement> get_dos_header(const utils::safe_buffer_accessor<SpanElement>& buffer)
+        {
+            return buffer.template as<PEDosHeader_t>(0);
+        }
+
+        template <typename AddrType, typename SpanElement>
+        utils::safe_object_accessor<PENTHeaders_t<AddrType>, SpanElement> get_nt_headers(
+            const utils::safe_buffer_accessor<SpanElement>& buffer)
+        {
+            const auto dos_header = get_dos_header(buffer).get();
+            const auto nt_headers_offset = dos_header.e_lfanew;
+
+            return buffer.template as<PENTHeaders_t<AddrType>>(nt_headers_offset);
+        }
+
+        template <typename AddrType>
+        uint64_t get_first_section_offset(const PENTHeaders_t<AddrType>& nt_headers, const uint64_t nt_headers_offset)
+        {
+            const auto* nt_headers_addr = reinterpret_cast<const uint8_t*>(&nt_headers);
+            const size_t optional_header_offset =
+                reinterpret_cast<uintptr_t>(&(nt_headers.OptionalHeader)) - reinterpret_cast<uintptr_t>(&nt_headers);
+            const size_t optional_header_size = nt_headers.FileHeader.SizeOfOptionalHeader;
+            const auto* first_section_addr = nt_headers_addr + optional_header_offset + optional_header_size;
+
+            const auto first_section_absolute = reinterpret_cast<uint64_t>(first_section_addr);
+            const auto absolute_base = reinterpret_cast<uint64_t>(&nt_headers);
+            return nt_headers_offset + (first_section_absolute - absolute_base);
+        }
+
+        template <typename AddrType, typename SpanElement, typename Accessor>
+        void access_sections(const utils::safe_buffer_accessor<SpanElement> buffer, const PENTHeaders_t<AddrType>& nt_headers,
+                             const uint64_t nt_headers_offset, const Accessor& accessor)
+        {
+            const auto first_section_offset = get_first_section_offset(nt_headers, nt_headers_offset);
+            const auto sections = buffer.template as<IMAGE_SECTION_HEADER>(static_cast<size_t>(first_section_offset));
+
+            for (size_t i = 0; i < nt_headers.FileHeader.NumberOfSections; ++i)
+            {
+                const auto section = sections.get(i);
+
+                if (!accessor(section))
+                {
+                    break;
+                }
+            }
+        }
+
+        template <typename AddrType, typename SpanElement>
+        section_table get_section_table(const utils::safe_buffer_accessor<SpanElement> buffer, const PENTHeaders_t<AddrType>& nt_headers,
+                                        const uint64_t nt_headers_offset)
+        {
+            section_table result{};
+            result.reserve(nt_headers.FileHeader.NumberOfSections);
+
+            access_sections(buffer, nt_headers, nt_headers_offset, [&](const IMAGE_SECTION_HEADER& section) {
+                const auto size_of_data = std::min(section.SizeOfRawData, section.Misc.VirtualSize);
+                result.emplace_back(section.VirtualAddress, size_of_data, section.PointerToRawData);
+                return true;
+            });
+
+            std::ranges::sort(result, {}, &section_range::virtual_address);
+            return result;
+        }
+
+        inline std::optional<size_t> rva_to_file_offset(const section_table& sections, const uint32_t rva)
+        {
+            auto iter = std::ranges::upper_bound(sections, rva, {}, &section_range::virtual_address);
+            if (iter == sections.begin())
+            {
+                return std::nullopt;
+            }
+
+            std::advance(iter, -1);
+
+            const auto offset = rva - iter->virtual_address;
+            if (offset >= iter->size)
+            {
+                return std::nullopt;
+            }
+
+            return iter->file_offset + offset;
+        }
+
+        template <typename AddrType, typename SpanElement>
+        relocation_list parse_relocations(const utils::safe_buffer_accessor<SpanElement> buffer, const PENTHeaders_t<AddrType>& nt_headers,
+                                          const section_table& sections)
+        {
+            const auto* directory = &nt_headers.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+            if (directory->Size == 0)
+            {
+                return {};
+            }
+
+            auto relocation_offset = directory->VirtualAddress;
+            const auto relocation_end = relocation_offset + directory->Size;
+
+            auto relocation_file_offset = rva_to_file_offset(sections, relocation_offset);
+            if (!relocation_file_offset.has_value())
+            {
+                return {};
+            }
+
+            relocation_list result{};
+            result.reserve(directory->Size / sizeof(uint16_t));
+
+            while (relocation_offset < relocation_end)
+            {
+                const auto relocation = buffer.template as<IMAGE_BASE_RELOCATION>(*relocation_file_offset).get();
+
+                if (relocation.VirtualAddress <= 0 || relocation.SizeOfBlock <= sizeof(IMAGE_BASE_RELOCATION))
+                {
+                    break;
+                }
+
+                const auto data_size = relocation.SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION);
+                const auto entry_count = data_size / sizeof(uint16_t);
+
+                // Validate the block once instead of checking every single entry
+                const auto* entries = buffer.get_pointer_for_range(*relocation_file_offset + sizeof(IMAGE_BASE_RELOCATION),
+                                                                   entry_count * sizeof(uint16_t));
+
+                relocation_offset += relocation.SizeOfBlock;
+                *relocation_file_offset += relocation.SizeOfBlock;
+
+                for (size_t i = 0; i < entry_count; ++i)
+                {
+                    uint16_t entry{};
+                    memcpy(&entry, entries + (i * sizeof(uint16_t)), sizeof(entry));
+
+                    const int type = entry >> 12;
+                    const auto offset = static_cast<uint16_t>(entry & 0xfff);
+                    const auto rva = relocation.VirtualAddress + offset;
+
+                    switch (type)
+                    {
+                    case IMAGE_REL_BASED_ABSOLUTE:
+                        break;
+
+                    case IMAGE_REL_BASED_HIGHLOW:
+                        result.emplace_back(rva, static_cast<uint8_t>(sizeof(uint32_t)));
+                        break;
+
+                    case IMAGE_REL_BASED_DIR64:
+                        result.emplace_back(rva, static_cast<uint8_t>(sizeof(uint64_t)));
+                        break;
+
+                    default:
+                        throw std::runtime_error("Unknown relocation type: " + std::to_string(type));
+                    }
+                }
+            }
+
+            // Blocks are usually emitted in ascending order already
+            if (!std::ranges::is_sorted(result, {}, &relocation_entry::rva))
+            {
+                std::ranges::sort(result, {}, &relocation_entry::rva);
+            }
+
+            return result;
+        }
+
+        /*****************************************************************************
+         * Both the sections and the relocations are sorted, so assigning the
+         * relocations to their sections is a single merge over the two lists.
+         * Slots outside of the parsed sections, crossing their end or overlapping
+         * a previous slot are dropped.
+         ****************************************************************************/
+
+        inline void assign_relocations(std::vector<clean_section>& sections, const relocation_list& relocations)
+        {
+            auto relocation = relocations.begin();
+
+            for (auto& section : sections)
+            {
+                const auto section_end = static_cast<uint64_t>(section.rva) + section.data.size();
+
+                relocation = std::lower_bound(relocation, relocations.end(), section.rva,
+                                              [](const relocation_entry& entry, const uint32_t rva) { return entry.rva < rva; });
+
+                for (; relocation != relocations.end() && relocation->rva < section_end; ++relocation)
+                {
+                    const auto slot_end = static_cast<uint64_t>(relocation->rva) + relocation->size;
+                    const auto overlaps_previous =
+                        !section.relocations.empty() && relocation->rva < section.relocations.back().rva + section.relocations.back().size;
+
+                    if (slot_end <= section_end && !overlaps_previous)
+                    {
+                        section.relocations.emplace_back(*relocation);
+                    }
+                }
+            }
+        }
+
+        inline bool is_read_only_section(const IMAGE_SECTION_HEADER& section)
+        {
+            const auto is_writable = section.Characteristics & IMAGE_SCN_MEM_WRITE;
+            const auto is_discardable = section.Characteristics & IMAGE_SCN_MEM_DISCARDABLE;
+            const auto is_uninitialized = section.Characteristics & IMAGE_SCN_CNT_UNINITIALIZED_DATA;
+
+            return section.SizeOfRawData > 0 && !is_writable && !is_discardable && !is_uninitialized;
+        }
+
+        inline bool is_code_section(const IMAGE_SECTION_HEADER& section)
+        {
+            return is_read_only_section(section) && (section.Characteristics & IMAGE_SCN_MEM_EXECUTE);
+        }
+
+        inline bool is_data_section(const IMAGE_SECTION_HEADER& section)
+        {
+            return is_read_only_section(section) && !(section.Characteristics & IMAGE_SCN_MEM_EXECUTE);
+        }
+
+        template <typename AddrType, typename SpanElement, typename Filter>
+        std::vector<clean_section> parse_sections(const utils::safe_buffer_accessor<SpanElement> buffer,
+                                                  const PENTHeaders_t<AddrType>& nt_headers, const uint64_t nt_headers_offset,
+                                                  const Filter& filter)
+        {
+            std::vector<clean_section> result{};
+
+            access_sections(buffer, nt_headers, nt_headers_offset, [&](const IMAGE_SECTION_HEADER& section) {
+                if (!filter(section))
+                {
+                    return true;
+                }
+
+                const auto size_of_data = std::min(section.SizeOfRawData, section.Misc.VirtualSize);
+                const auto* byte_ptr = buffer.get_pointer_for_range(section.PointerToRawData, size_of_data);
+                const auto* section_ptr = reinterpret_cast<const uint8_t*>(byte_ptr);
+
+                auto& entry = result.emplace_back();
+                entry.rva = section.VirtualAddress;
+                entry.data = {section_ptr, size_of_data};
+
+                return true;
+            });
+
+            std::ranges::sort(result, {}, &clean_section::rva);
+            return result;
+        }
+
+        // Counts come from the file, so arrays are checked against the file size before anything is allocated for them
+        template <typename SpanElement>
+        bool is_array_in_file(const utils::safe_buffer_accessor<SpanElement> buffer, const size_t offset, const size_t count,
+                              const size_t element_size)
+        {
+            const auto size = buffer.get_buffer().size();
+            return offset <= size && count <= (size - offset) / element_size;
+        }
+
+        // Forwarded exports point to a name within the export directory instead of code
+        template <typename AddrType, typename SpanElement>
+        std::vector<export_slot> parse_export_slots(const utils::safe_buffer_accessor<SpanElement> buffer,
+                                                    const PENTHeaders_t<AddrType>& nt_headers, const section_table& sections)
+        {
+            const auto& directory = nt_headers.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+            if (directory.Size == 0)
+            {
+                return {};
+            }
+
+            const auto directory_offset = rva_to_file_offset(sections, directory.VirtualAddress);
+            if (!directory_offset)
+            {
+                return {};
+            }
+
+            const auto export_directory = buffer.template as<IMAGE_EXPORT_DIRECTORY>(*directory_offset).get();
+
+            const auto functions_offset = rva_to_file_offset(sections, export_directory.AddressOfFunctions);
+            if (!functions_offset || !is_array_in_file(buffer, *functions_offset, export_directory.NumberOfFunctions, sizeof(uint32_t)))
+            {
+                return {};
+            }
+
+            const auto function_rvas = buffer.template as<uint32_t>(*functions_offset);
+
+            std::vector<export_slot> slots(export_directory.NumberOfFunctions);
+
+            for (size_t i = 0; i < slots.size(); ++i)
+            {
+                auto& slot = slots[i];
+                slot.rva = static_cast<uint32_t>(export_directory.AddressOfFunctions + (i * sizeof(uint32_t)));
+                slot.function_rva = function_rvas.get(i);
+                slot.is_forwarder =
+                    slot.function_rva >= directory.VirtualAddress && slot.function_rva - directory.VirtualAddress < directory.Size;
+            }
+
+            const auto names_offset = rva_to_file_offset(sections, export_directory.AddressOfNames);
+            const auto ordinals_offset = rva_to_file_offset(sections, export_directory.AddressOfNameOrdinals);
+
+            const auto has_names = names_offset && ordinals_offset &&
+                                   is_array_in_file(buffer, *names_offset, export_directory.NumberOfNames, sizeof(uint32_t)) &&
+                                   is_array_in_file(buffer, *ordinals_offset, export_directory.NumberOfNames, sizeof(uint16_t));
+
+            if (has_names)
+            {
+                const auto name_rvas = buffer.template as<uint32_t>(*names_offset);
+                const auto ordinals = buffer.template as<uint16_t>(*ordinals_offset);
+
+                for (size_t i = 0; i < export_directory.NumberOfNames; ++i)
+                {
+                    const auto ordinal = ordinals.get(i);
+                    const auto name_offset = rva_to_file_offset(sections, name_rvas.get(i));
+
+                    if (ordinal < slots.size() && slots[ordinal].name.empty() && name_offset)
+                    {
+                        slots[ordinal].name = buffer.as_string(*name_offset);
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < slots.size(); ++i)
+            {
+                if (slots[i].name.empty())
+                {
+                    slots[i].name = "#" + std::to_string(export_directory.Base + i);
+                }
+            }
+
+            return slots;
+        }
+
+        template <typename AddrType, typename SpanElement>
+        void parse_exports(const utils::safe_buffer_accessor<SpanElement> buffer, const PENTHeaders_t<AddrType>& nt_headers,
+                           const section_table& sections, function_index& functions)
+        {
+            for (const auto& slot : parse_export_slots(buffer, nt_headers, sections))
+            {
+                if (slot.function_rva != 0 && !slot.is_forwarder)
+                {
+                    functions.add(slot.function_rva, slot.name);
+                }
+            }
+        }
+
+        // Modules without an import name table are looked up through the import address table of the file
+        template <typename AddrType, typename SpanElement>
+        std::vector<import_slot> parse_import_slots(const utils::safe_buffer_accessor<SpanElement> buffer,
+                                                    const PENTHeaders_t<AddrType>& nt_headers, const section_table& sections)
+        {
+            constexpr auto ordinal_flag = static_cast<AddrType>(1) << ((sizeof(AddrType) * 8) - 1);
+
+            const auto& directory = nt_headers.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+            const auto directory_offset = rva_to_file_offset(sections, directory.VirtualAddress);
+
+            if (directory.Size == 0 || !directory_offset)
+            {
+                return {};
+            }
+
+            std::vector<import_slot> slots{};
+
+            const auto descriptors = buffer.template as<IMAGE_IMPORT_DESCRIPTOR>(*directory_offset);
+            const auto descriptor_count = directory.Size / sizeof(IMAGE_IMPORT_DESCRIPTOR);
+
+            for (size_t i = 0; i < descriptor_count; ++i)
+            {
+                const auto descriptor = descriptors.get(i);
+                if (descriptor.FirstThunk == 0)
+                {
+                    break;
+                }
+
+                const auto name_offset = rva_to_file_offset(sections, descriptor.Name);
+                const auto thunks_rva = descriptor.OriginalFirstThunk != 0 ? descriptor.OriginalFirstThunk : descriptor.FirstThunk;
+                const auto thunks_offset = rva_to_file_offset(sections, thunks_rva);
+                const auto table_offset = rva_to_file_offset(sections, descriptor.FirstThunk);
+
+                if (!name_offset || !thunks_offset || !table_offset)
+                {
+                    continue;
+                }
+
+                const auto module_name = buffer.as_string(*name_offset) + "!";
+                const auto thunks = buffer.template as<AddrType>(*thunks_offset);
+                const auto table = buffer.template as<AddrType>(*table_offset);
+
+                for (size_t j = 0;; ++j)
+                {
+                    const auto thunk = thunks.get(j);
+                    if (thunk == 0)
+                    {
+                        break;
+                    }
+
+                    auto& slot = slots.emplace_back(import_slot{
+                        .rva = static_cast<uint32_t>(descriptor.FirstThunk + (j * sizeof(AddrType))),
+                        .file_value = table.get(j),
+                        .name = module_name,
+                    });
+
+                    if (thunk & ordinal_flag)
+                    {
+                        slot.name += "#" + std::to_string(thunk & 0xFFFF);
+                        continue;
+                    }
+
+                    // Skips the hint that precedes the name
+                    const auto import_name_offset = rva_to_file_offset(sections, static_cast<uint32_t>(thunk));
+                    slot.name += import_name_offset ? buffer.as_string(*import_name_offset + sizeof(uint16_t)) : "?";
+                }
+            }
+
+            std::ranges::sort(slots, {}, &import_slot::rva);
+            return slots;
+        }
+
+        struct runtime_function
+        {
+            uint32_t begin_address{};
+            uint32_t end_address{};
+            uint32_t unwind_info_address{};
+        };
+
+        // Only x64 images describe their functions in the exception directory
+        template <typename AddrType, typename SpanElement>
+        void parse_exception_directory(const utils::safe_buffer_accessor<SpanElement> buffer, const PENTHeaders_t<AddrType>& nt_headers,
+                                       const section_table& sections, function_index& functions)
+        {
+            if constexpr (sizeof(AddrType) == sizeof(uint64_t))
+            {
+                const auto& directory = nt_headers.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION];
+                const auto directory_offset = rva_to_file_offset(sections, directory.VirtualAddress);
+
+                if (directory.Size == 0 || !directory_offset)
+                {
+                    return;
+                }
+
+                const auto count = directory.Size / sizeof(runtime_function);
+                const auto* entries = buffer.get_pointer_for_range(*directory_offset, count * sizeof(runtime_function));
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    runtime_function entry{};
+                    memcpy(&entry, entries + (i * sizeof(runtime_function)), sizeof(entry));
+
+                    if (entry.begin_address != 0 && entry.begin_address < entry.end_address)
+                    {
+                        functions.add(entry.begin_address);
+                    }
+                }
+            }
+        }
+
+        template <typename AddrType, typename SpanElement>
+        function_index parse_function_index_variant(const utils::safe_buffer_accessor<SpanElement>& buffer)
+        {
+            const auto dos_header = get_dos_header(buffer).get();
+            const auto nt_headers_offset = dos_header.e_lfanew;
+            const auto nt_headers = get_nt_headers<AddrType>(buffer).get();
+            const auto sections = get_section_table(buffer, nt_headers, nt_headers_offset);
+
+            function_index functions{};
+            parse_exports(buffer, nt_headers, sections, functions);
+            parse_exception_directory(buffer, nt_headers, sections, functions);
+            functions.finalize();
+
+            return functions;
+        }
+
+        template <typename AddrType, typename SpanElement>
+        address_tables parse_address_tables_variant(const utils::safe_buffer_accessor<SpanElement>& buffer)
+        {
+            const auto dos_header = get_dos_header(buffer).get();
+            const auto nt_headers_offset = dos_header.e_lfanew;
+            const auto nt_headers = get_nt_headers<AddrType>(buffer).get();
+            const auto sections = get_section_table(buffer, nt_headers, nt_headers_offset);
+
+            return {
+                .pointer_size = sizeof(AddrType),
+                .imports = parse_import_slots(buffer, nt_headers, sections),
+                .exports = parse_export_slots(buffer, nt_headers, sections),
+            };
+        }
+
+        template <typename AddrType>
+        image_identity get_image_identity(const PENTHeaders_t<AddrType>& nt_headers)
+        {
+            return {
+                .time_date_stamp = nt_headers.FileHeader.TimeDateStamp,
+                .size_of_image = nt_headers.OptionalHeader.SizeOfImage,
+            };
+        }
+
+        template <typename AddrType, typename SpanElement>
+        image_headers parse_image_headers_variant(const utils::safe_buffer_accessor<SpanElement>& buffer)
+        {
+            const auto dos_header = get_dos_header(buffer).get();
+            const auto nt_headers_offset = dos_header.e_lfanew;
+            const auto nt_headers = get_nt_headers<AddrType>(buffer).get();
+
+            image_headers headers{};
+            headers.identity = get_image_identity(nt_headers);
+            headers.checksum = nt_headers.OptionalHeader.CheckSum;
+
+            access_sections(buffer, nt_headers, nt_headers_offset, [&](const IMAGE_SECTION_HEADER& section) {
+                auto& header = headers.sections.emplace_back(section_header{
+                    .rva = section.VirtualAddress,
+                    .virtual_size = section.Misc.VirtualSize,
+                    .raw_size = section.SizeOfRawData,
+                    .characteristics = section.Characteristics,
+                });
+
+                memcpy(header.name.data(), section.Name, header.name.size());
+                return true;
+            });
+
+            return headers;
+        }
+
+        // Sections without slots, like .rsrc, leave nothing behind
+        inline pointer_slot_table collect_pointer_slots(const std::vector<clean_section>& sections)
+        {
+            pointer_slot_table table{};
+
+            for (const auto& section : sections)
+            {
+                for (const auto& slot : section.relocations)
+                {
+                    const auto data = section.data.subspan(slot.rva - section.rva, slot.size);
+
+                    table.slots.emplace_back(slot);
+                    table.values.insert(table.values.end(), data.begin(), data.end());
+                }
+            }
+
+            return table;
+        }
+
+        template <typename AddrType, typename SpanElement>
+        relocation_list parse_relocations_variant(const utils::safe_buffer_accessor<SpanElement>& buffer)
+        {
+            const auto nt_headers_offset = get_dos_header(buffer).get().e_lfanew;
+            const auto nt_headers = get_nt_headers<AddrType>(buffer).get();
+
+            return parse_relocations(buffer, nt_headers, get_section_table(buffer, nt_headers, nt_headers_offset));
+        }
+
+        template <typename AddrType, typename SpanElement>
+        clean_image parse_pe_variant(const utils::safe_buffer_accessor<SpanElement>& buffer, const bool with_pointer_slots)
+        {
+            const auto dos_header = get_dos_header(buffer).get();
+            const auto nt_headers_offset = dos_header.e_lfanew;
+            const auto nt_headers = get_nt_headers<AddrType>(buffer).get();
+
+            clean_image image{};
+            image.image_base = nt_headers.OptionalHeader.ImageBase;
+            image.identity = get_image_identity(nt_headers);
+            image.sections = parse_sections(buffer, nt_headers, nt_headers_offset, is_code_section);
+
+            const auto section_table = get_section_table(buffer, nt_headers, nt_headers_offset);
+            const auto relocations = parse_relocations(buffer, nt_headers, section_table);
+            assign_relocations(image.sections, relocations);
+
+            if (with_pointer_slots)
+            {
+                auto data_sections = parse_sections(buffer, nt_headers, nt_headers_offset, is_data_section);
+                assign_relocations(data_sections, relocations);
+                image.pointer_slots = collect_pointer_slots(data_sections);
+            }
+
+            return image;
+        }
+    }
+
+    // Only the headers are accessed, so this is cheap even for large files
+    template <typename SpanElement>
+    image_identity get_image_identity(const utils::safe_buffer_accessor<SpanElement>& buffer)
+    {
+        const auto nt_headers = detail::get_nt_headers<uint64_t>(buffer);
+        const auto machine_type = nt_headers.get().FileHeader.Machine;
+
+        switch (machine_type)
+        {
+        case PEMachineType::I386:
+            return detail::get_image_identity(detail::get_nt_headers<uint32_t>(buffer).get());
+        case PEMachineType::AMD64:
+            return detail::get_image_identity(nt_headers.get());
+        default:
+            return {};
+        }
+    }
+
+    // Import and export address tables, as they are before the loader binds the imports
+    template <typename SpanElement>
+    address_tables parse_address_tables(const utils::safe_buffer_accessor<SpanElement>& buffer)
+    {
+        const auto nt_headers = detail::get_nt_headers<uint64_t>(buffer);
+        const auto machine_type = nt_headers.get().FileHeader.Machine;
+
+        switch (machine_type)
+        {
+        case PEMachineType::I386:
+            return detail::parse_address_tables_variant<uint32_t>(buffer);
+        case PEMachineType::AMD64:
+            return detail::parse_address_tables_variant<uint64_t>(buffer);
+        default:
+            return {};
+        }
+    }
+
+    // Works on headers mapped in memory as well, their layout is the same as in the file.
+    // Returns nothing if the buffer doesn't start with PE headers, for example because they were wiped in memory.
+    template <typename SpanElement>
+    std::optional<image_headers> parse_image_headers(const utils::safe_buffer_accessor<SpanElement>& buffer)
+    {
+        if (detail::get_dos_header(buffer).get().e_magic != PEDosHeader_t::k_Magic)
+        {
+            return std::nullopt;
+        }
+
+        const auto nt_headers = detail::get_nt_headers<uint64_t>(buffer).get();
+        if (nt_headers.Signature != PENTHeaders_t<uint64_t>::k_Signature)
+        {
+            return std::nullopt;
+        }
+
+        switch (nt_headers.FileHeader.Machine)
+        {
+        case PEMachineType::I386:
+            return detail::parse_image_headers_variant<uint32_t>(buffer);
+        case PEMachineType::AMD64:
+            return detail::parse_image_headers_variant<uint64_t>(buffer);
+        default:
+            return std::nullopt;
+        }
+    }
+
+    // The relocated pointer slots of the read-only data sections are only collected if requested, as most scans don't need them
+    template <typename SpanElement>
+    clean_image parse_pe_file(const utils::safe_buffer_accessor<SpanElement>& buffer, const bool with_pointer_slots = false)
+    {
+        const auto nt_headers = detail::get_nt_headers<uint64_t>(buffer);
+        const auto machine_type = nt_headers.get().FileHeader.Machine;
+
+        switch (machine_type)
+        {
+        case PEMachineType::I386:
+            return detail::parse_pe_variant<uint32_t>(buffer, with_pointer_slots);
+        case PEMachineType::AMD64:
+            return detail::parse_pe_variant<uint64_t>(buffer, with_pointer_slots);
+        default:
+            return {};
+        }
+    }
+
+    // All relocated slots of the image, sorted by rva, no matter which section they lie in
+    template <typename SpanElement>
+    relocation_list parse_relocation_table(const utils::safe_buffer_accessor<SpanElement>& buffer)
+    {
+        const auto nt_headers = detail::get_nt_headers<uint64_t>(buffer);
+        const auto machine_type = nt_headers.get().FileHeader.Machine;
+
+        switch (machine_type)
+        {
+        case PEMachineType::I386:
+            return detail::parse_relocations_variant<uint32_t>(buffer);
+        case PEMachineType::AMD64:
+            return detail::parse_relocations_variant<uint64_t>(buffer);
+        default:
+            return {};
+        }
+    }
+
+    // Exports and, on x64, the exception directory, so that functions can be attributed without any analysis
+    template <typename SpanElement>
+    function_index parse_function_index(const utils::safe_buffer_accessor<SpanElement>& buffer)
+    {
+        const auto nt_headers = detail::get_nt_headers<uint64_t>(buffer);
+        const auto machine_type = nt_headers.get().FileHeader.Machine;
+
+        switch (machine_type)
+        {
+        case PEMachineType::I386:
+            return detail::parse_function_index_variant<uint32_t>(buffer);
+        case PEMachineType::AMD64:
+            return detail::parse_function_index_variant<uint64_t>(buffer);
+        default:
+            return {};
+        }
+    }
+}
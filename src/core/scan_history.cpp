@@ -0,0 +1,171 @@
+#include "scan_history.hpp"
+
+#include <iterator>
+#include <algorithm>
+#include <unordered_set>
+
+namespace momo
+{
+    namespace
+    {
+        bool is_patch_before(const patch& left, const patch& right)
+        {
+            return left.address != right.address ? left.address < right.address : left.length < right.length;
+        }
+
+        std::vector<patch> get_sorted_patches(const std::vector<patch>& patches)
+        {
+            auto sorted = patches;
+            std::ranges::sort(sorted, is_patch_before);
+            return sorted;
+        }
+
+        std::vector<page_hash> get_sorted_pages(const std::vector<page_hash>& pages)
+        {
+            auto sorted = pages;
+            std::ranges::sort(sorted, {}, &page_hash::address);
+            return sorted;
+        }
+
+        void add_changed_page(std::vector<memory_range>& ranges, const uint64_t address, const uint64_t size)
+        {
+            if (!ranges.empty() && ranges.back().address + ranges.back().size == address)
+            {
+                ranges.back().size += size;
+                return;
+            }
+
+            ranges.emplace_back(address, size);
+        }
+
+        // Pages that were read only once are reported as changed, as their readability changed
+        std::vector<memory_range> get_changed_pages(const std::vector<page_hash>& old_pages, const std::vector<page_hash>& new_pages,
+                                                    const uint64_t page_size)
+        {
+            std::vector<memory_range> changed{};
+
+            auto old_page = old_pages.begin();
+            auto new_page = new_pages.begin();
+
+            while (old_page != old_pages.end() || new_page != new_pages.end())
+            {
+                if (new_page == new_pages.end() || (old_page != old_pages.end() && old_page->address < new_page->address))
+                {
+                    add_changed_page(changed, old_page->address, page_size);
+                    ++old_page;
+                }
+                else if (old_page == old_pages.end() || new_page->address < old_page->address)
+                {
+                    add_changed_page(changed, new_page->address, page_size);
+                    ++new_page;
+                }
+                else
+                {
+                    if (old_page->hash != new_page->hash)
+                    {
+                        add_changed_page(changed, new_page->address, page_size);
+                    }
+
+                    ++old_page;
+                    ++new_page;
+                }
+            }
+
+            return changed;
+        }
+    }
+
+    bool scan_history::contains(const module_info& module) const
+    {
+        const auto entry = this->modules_.find(module.base_address);
+        return entry != this->modules_.end() && entry->second.module.path == module.path;
+    }
+
+    module_changes scan_history::update(const module_info& module, const module_scan_result& result)
+    {
+        constexpr uint64_t page_size = 0x1000;
+
+        module_changes changes{};
+
+        auto patches = get_sorted_patches(result.patches);
+        auto pages = get_sorted_pages(result.page_hashes);
+
+        if (!this->contains(module))
+        {
+            changes.is_new = true;
+            changes.added_patches = patches;
+        }
+        else
+        {
+            const auto& state = this->modules_.at(module.base_address);
+
+            std::ranges::set_difference(patches, state.patches, std::back_inserter(changes.added_patches), is_patch_before);
+            std::ranges::set_difference(state.patches, patches, std::back_inserter(changes.removed_patches), is_patch_before);
+            changes.changed_pages = get_changed_pages(state.pages, pages, page_size);
+        }
+
+        this->modules_[module.base_address] = module_state{
+            .module = module,
+            .patches = std::move(patches),
+            .pages = std::move(pages),
+        };
+
+        return changes;
+    }
+
+    std::optional<module_baseline> scan_history::get_baseline(const module_info& module) const
+    {
+        if (!this->contains(module))
+        {
+            return std::nullopt;
+        }
+
+        const auto& state = this->modules_.at(module.base_address);
+        return module_baseline{state.patches, state.pages};
+    }
+
+    std::vector<removed_module> scan_history::remove(const std::string_view path)
+    {
+        std::vector<removed_module> removed{};
+
+        std::erase_if(this->modules_, [&](auto& entry) {
+            if (entry.second.module.path != path)
+            {
+                return false;
+            }
+
+            removed.push_back(removed_module{std::move(entry.second.module), std::move(entry.second.patches)});
+            return true;
+        });
+
+        return removed;
+    }
+
+    std::vector<removed_module> scan_history::remove_missing(const std::span<const module_info> loaded_modules)
+    {
+        std::unordered_set<uint64_t> loaded_bases{};
+        for (const auto& module : loaded_modules)
+        {
+            loaded_bases.insert(module.base_address);
+        }
+
+        std::vector<removed_module> removed{};
+
+        std::erase_if(this->modules_, [&](auto& entry) {
+            if (loaded_bases.contains(entry.first))
+            {
+                return false;
+            }
+
+            removed.push_back(removed_module{std::move(entry.second.module), std::move(entry.second.patches)});
+            return true;
+        });
+
+        return removed;
+    }
+
+    void scan_history::clear()
+    {
+        this->modules_.clear();
+    }
+}
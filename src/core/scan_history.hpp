@@ -0,0 +1,66 @@
+#pragma once
+
+#include <map>
+#include <span>
+#include <optional>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+
+#include "module_scanner.hpp"
+
+namespace momo
+{
+    struct module_changes
+    {
+        bool is_new{false};
+        std::vector<patch> added_patches{};
+        std::vector<patch> removed_patches{};
+        std::vector<memory_range> changed_pages{};
+
+        bool empty() const
+        {
+            return this->added_patches.empty() && this->removed_patches.empty() && this->changed_pages.empty();
+        }
+    };
+
+    struct removed_module
+    {
+        module_info module{};
+        std::vector<patch> patches{};
+    };
+
+    /*****************************************************************************
+     * Remembers the last complete scan result of every module, keyed by its
+     * base address, together with a hash of every page that was read.
+     * Updating a module with a new result yields what changed since then:
+     * patches that appeared or disappeared and pages whose content differs.
+     * A module with a different path at a known base is treated as new.
+     ****************************************************************************/
+
+    class scan_history
+    {
+      public:
+        bool contains(const module_info& module) const;
+        module_changes update(const module_info& module, const module_scan_result& result);
+
+        // The last result of the module, so that a rescan can skip it if none of its pages changed
+        std::optional<module_baseline> get_baseline(const module_info& module) const;
+
+        // Both return the modules that were forgotten, with their last known patches
+        std::vector<removed_module> remove(std::string_view path);
+        std::vector<removed_module> remove_missing(std::span<const module_info> loaded_modules);
+
+        void clear();
+
+      private:
+        struct module_state
+        {
+            module_info module{};
+            std::vector<patch> patches{};
+            std::vector<page_hash> pages{};
+        };
+
+        std::map<uint64_t, module_state> modules_{};
+    };
+}
@@ -0,0 +1,155 @@
+#include "scan_options.hpp"
+
+#include <array>
+#include <charconv>
+
+namespace momo
+{
+    namespace
+    {
+        using option_setter = void (*)(scan_options& options, std::string_view value);
+
+        struct option_definition
+        {
+            std::string_view name{};
+            option_setter setter{};
+        };
+
+        std::string_view trim(std::string_view text)
+        {
+            constexpr std::string_view whitespace = " \t\r\n";
+
+            const auto start = text.find_first_not_of(whitespace);
+            if (start == std::string_view::npos)
+            {
+                return {};
+            }
+
+            const auto end = text.find_last_not_of(whitespace);
+            return text.substr(start, end - start + 1);
+        }
+
+        void parse_size(const std::string_view value, size_t& target)
+        {
+            size_t result{};
+            const auto* end = value.data() + value.size();
+            const auto [ptr, ec] = std::from_chars(value.data(), end, result);
+
+            if (ec == std::errc{} && ptr == end)
+            {
+                target = result;
+            }
+        }
+
+        void parse_flag(const std::string_view value, bool& target)
+        {
+            if (value == "1" || value == "true")
+            {
+                target = true;
+            }
+            else if (value == "0" || value == "false")
+            {
+                target = false;
+            }
+        }
+
+        constexpr std::array option_definitions{
+            option_definition{
+                "parallel_diff_threshold",
+                [](scan_options& options, const std::string_view value) { parse_size(value, options.parallel_diff_threshold); },
+            },
+            option_definition{
+                "parallel_diff_chunk_size",
+                [](scan_options& options, const std::string_view value) { parse_size(value, options.parallel_diff_chunk_size); },
+            },
+            option_definition{
+                "initial_read_size",
+                [](scan_options& options, const std::string_view value) { parse_size(value, options.initial_read_size); },
+            },
+            option_definition{
+                "max_read_size",
+                [](scan_options& options, const std::string_view value) { parse_size(value, options.max_read_size); },
+            },
+            option_definition{
+                "prologue_size",
+                [](scan_options& options, const std::string_view value) { parse_size(value, options.prologue_size); },
+            },
+            option_definition{
+                "table_hooks",
+                [](scan_options& options, const std::string_view value) { parse_flag(value, options.table_hooks); },
+            },
+            option_definition{
+                "pointer_scan",
+                [](scan_options& options, const std::string_view value) { parse_flag(value, options.pointer_scan); },
+            },
+            option_definition{
+                "disk_cache",
+                [](scan_options& options, const std::string_view value) { parse_flag(value, options.use_disk_cache); },
+            },
+            option_definition{
+                "cache_directory",
+                [](scan_options& options, const std::string_view value) { options.cache_directory = value; },
+            },
+            option_definition{
+                "module_store",
+                [](scan_options& options, const std::string_view value) { options.module_store = value; },
+            },
+            option_definition{
+                "allowlist",
+                [](scan_options& options, const std::string_view value) { options.allowlist = value; },
+            },
+            option_definition{
+                "background",
+                [](scan_options& options, const std::string_view value) { parse_flag(value, options.background); },
+            },
+            option_definition{
+                "incremental",
+                [](scan_options& options, const std::string_view value) { parse_flag(value, options.incremental); },
+            },
+            option_definition{
+                "trace_file",
+                [](scan_options& options, const std::string_view value) { options.trace_file = value; },
+            },
+            option_definition{
+                "capture_file",
+                [](scan_options& options, const std::string_view value) { options.capture_file = value; },
+            },
+            option_definition{
+                "compress_capture",
+                [](scan_options& options, const std::string_view value) { parse_flag(value, options.compress_capture); },
+            },
+        };
+
+        void apply_option(scan_options& options, const std::string_view name, const std::string_view value)
+        {
+            for (const auto& definition : option_definitions)
+            {
+                if (definition.name == name)
+                {
+                    definition.setter(options, value);
+                    return;
+                }
+            }
+        }
+    }
+
+    scan_options parse_scan_options(std::string_view text)
+    {
+        scan_options options{};
+
+        while (!text.empty())
+        {
+            const auto separator = text.find(';');
+            const auto entry = text.substr(0, separator);
+            text = separator == std::string_view::npos ? std::string_view{} : text.substr(separator + 1);
+
+            const auto assignment = entry.find('=');
+            if (assignment != std::string_view::npos)
+            {
+                apply_option(options, trim(entry.substr(0, assignment)), trim(entry.substr(assignment + 1)));
+            }
+        }
+
+        return options;
+    }
+}
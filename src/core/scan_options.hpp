@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <string_view>
+
+namespace momo
+{
+    struct scan_options
+    {
+        // Sections larger than this are split into chunks that are diffed in parallel
+        size_t parallel_diff_threshold{16 * 1024 * 1024};
+        size_t parallel_diff_chunk_size{2 * 1024 * 1024};
+
+        // Memory is read in page aligned chunks that grow from the initial to the maximum size while reads succeed
+        size_t initial_read_size{64 * 1024};
+        size_t max_read_size{4 * 1024 * 1024};
+
+        // Only the first bytes of every function known from the exports and unwind data are compared.
+        // Zero compares every byte of the executable sections.
+        size_t prologue_size{32};
+
+        // Import and export address tables of all modules are checked for hooks as well
+        bool table_hooks{false};
+
+        // Relocated pointers in read-only data sections, like vtables, are compared as well
+        bool pointer_scan{false};
+
+        // Parsed images are persisted across runs. An empty directory selects the default location.
+        bool use_disk_cache{true};
+        std::string cache_directory{};
+
+        // Images are looked up by build in this module store before the recorded path is used, if set
+        std::string module_store{};
+
+        // Patches listed in this file are expected and not reported, if set
+        std::string allowlist{};
+
+        // Full scans run without blocking the UI, results are printed as modules finish
+        bool background{false};
+
+        // Modules are rescanned as the debugger loads them or suspends the process, and only changes are reported
+        bool incremental{false};
+
+        // Scan phases are written to this file in the Chrome trace format if set
+        std::string trace_file{};
+
+        // The scanned memory is captured into this file if set, so that it can be scanned again offline
+        std::string capture_file{};
+        bool compress_capture{true};
+    };
+
+    /*****************************************************************************
+     * Parses options of the form "key=value;key=value". Unknown keys and
+     * malformed values are ignored, so defaults stay in place.
+     ****************************************************************************/
+
+    scan_options parse_scan_options(std::string_view text);
+}
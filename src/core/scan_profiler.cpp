@@ -0,0 +1,176 @@
+#include "scan_profiler.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+
+namespace momo
+{
+    namespace
+    {
+        uint32_t get_thread_index()
+        {
+            static std::atomic_uint32_t next_index{0};
+            thread_local const auto index = next_index++;
+
+            return index;
+        }
+
+        std::string escape_json(const std::string_view text)
+        {
+            std::string result{};
+            result.reserve(text.size());
+
+            for (const auto c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    result.push_back('\\');
+                    result.push_back(c);
+                }
+                else if (static_cast<uint8_t>(c) < 0x20)
+                {
+                    char buffer[8]{};
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<uint8_t>(c));
+                    result.append(buffer);
+                }
+                else
+                {
+                    result.push_back(c);
+                }
+            }
+
+            return result;
+        }
+
+        uint64_t to_microseconds(const std::chrono::nanoseconds duration)
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+        }
+    }
+
+    std::string_view get_phase_name(const scan_phase phase)
+    {
+        switch (phase)
+        {
+        case scan_phase::load_image:
+            return "load_image";
+        case scan_phase::read_memory:
+            return "read_memory";
+        case scan_phase::diff:
+            return "diff";
+        case scan_phase::symbolize:
+            return "symbolize";
+        }
+
+        return "unknown";
+    }
+
+    std::chrono::nanoseconds scan_statistics::get_total_time() const
+    {
+        std::chrono::nanoseconds total{};
+
+        for (const auto time : this->phase_times)
+        {
+            total += time;
+        }
+
+        return total;
+    }
+
+    void scan_statistics::merge(const scan_statistics& statistics)
+    {
+        for (size_t i = 0; i < scan_phase_count; ++i)
+        {
+            this->phase_times[i] += statistics.phase_times[i];
+        }
+
+        this->bytes_read += statistics.bytes_read;
+        this->bytes_compared += statistics.bytes_compared;
+        this->relocated_slots += statistics.relocated_slots;
+        this->peak_buffer_size = std::max(this->peak_buffer_size, statistics.peak_buffer_size);
+    }
+
+    scan_profiler::scope::scope(scan_profiler& profiler, module_profile& profile, const scan_phase phase)
+        : profiler_(profiler),
+          profile_(profile),
+          phase_(phase),
+          start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    scan_profiler::scope::~scope()
+    {
+        const auto duration = std::chrono::steady_clock::now() - this->start_;
+        this->profile_.statistics.get_time(this->phase_) += duration;
+
+        if (this->profiler_.record_trace_)
+        {
+            this->profiler_.add_event({
+                .phase = this->phase_,
+                .profile = &this->profile_,
+                .thread_index = get_thread_index(),
+                .start = this->start_,
+                .duration = duration,
+            });
+        }
+    }
+
+    scan_profiler::scan_profiler(const bool record_trace)
+        : record_trace_(record_trace)
+    {
+    }
+
+    void scan_profiler::allocate_buffer(const uint64_t size)
+    {
+        const auto buffer_size = (this->buffer_size_ += size);
+
+        auto peak = this->peak_buffer_size_.load();
+        while (peak < buffer_size && !this->peak_buffer_size_.compare_exchange_weak(peak, buffer_size))
+        {
+        }
+    }
+
+    void scan_profiler::release_buffer(const uint64_t size)
+    {
+        this->buffer_size_ -= size;
+    }
+
+    std::chrono::nanoseconds scan_profiler::get_elapsed_time() const
+    {
+        return std::chrono::steady_clock::now() - this->start_;
+    }
+
+    void scan_profiler::add_event(const trace_event& event)
+    {
+        std::scoped_lock lock{this->mutex_};
+        this->events_.push_back(event);
+    }
+
+    bool scan_profiler::write_trace(const std::filesystem::path& path) const
+    {
+        std::ofstream stream{path, std::ios::trunc};
+        if (!stream)
+        {
+            return false;
+        }
+
+        stream << "{\"traceEvents\":[";
+
+        std::scoped_lock lock{this->mutex_};
+
+        for (size_t i = 0; i < this->events_.size(); ++i)
+        {
+            const auto& event = this->events_[i];
+
+            stream << (i ? ",\n" : "\n");
+            stream << "{\"name\":\"" << get_phase_name(event.phase) << "\",\"cat\":\"scan\",\"ph\":\"X\"";
+            stream << ",\"ts\":" << to_microseconds(event.start - this->start_) << ",\"dur\":" << to_microseconds(event.duration);
+            stream << ",\"pid\":1,\"tid\":" << event.thread_index;
+            stream << ",\"args\":{\"module\":\"" << escape_json(event.profile->name) << "\"}}";
+        }
+
+        stream << "\n]}\n";
+        return static_cast<bool>(stream);
+    }
+}
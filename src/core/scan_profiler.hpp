@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace momo
+{
+    enum class scan_phase : uint8_t
+    {
+        load_image,
+        read_memory,
+        diff,
+        symbolize,
+    };
+
+    constexpr size_t scan_phase_count = 4;
+
+    std::string_view get_phase_name(scan_phase phase);
+
+    struct scan_statistics
+    {
+        std::array<std::chrono::nanoseconds, scan_phase_count> phase_times{};
+
+        uint64_t bytes_read{};
+        uint64_t bytes_compared{};
+        uint64_t relocated_slots{};
+        uint64_t peak_buffer_size{};
+
+        std::chrono::nanoseconds& get_time(const scan_phase phase)
+        {
+            return this->phase_times[static_cast<size_t>(phase)];
+        }
+
+        std::chrono::nanoseconds get_time(const scan_phase phase) const
+        {
+            return this->phase_times[static_cast<size_t>(phase)];
+        }
+
+        std::chrono::nanoseconds get_total_time() const;
+
+        // Sums up the counters, except for the peak which is the maximum
+        void merge(const scan_statistics& statistics);
+    };
+
+    // Only touched by the thread that scans the module, and by the main thread once the scan is finished
+    struct module_profile
+    {
+        std::string name{};
+        scan_statistics statistics{};
+    };
+
+    /*****************************************************************************
+     * Collects timings of all scan phases. Every measured phase is added to
+     * the statistics of its module and, if enabled, recorded as an event
+     * that can be written out in the Chrome trace format.
+     ****************************************************************************/
+
+    class scan_profiler
+    {
+      public:
+        class scope
+        {
+          public:
+            scope(scan_profiler& profiler, module_profile& profile, scan_phase phase);
+            ~scope();
+
+            scope(scope&&) = delete;
+            scope(const scope&) = delete;
+            scope& operator=(scope&&) = delete;
+            scope& operator=(const scope&) = delete;
+
+          private:
+            scan_profiler& profiler_;
+            module_profile& profile_;
+            scan_phase phase_{};
+            std::chrono::steady_clock::time_point start_{};
+        };
+
+        explicit scan_profiler(bool record_trace);
+
+        // Tracks the memory of read buffers that are alive at the same time
+        void allocate_buffer(uint64_t size);
+        void release_buffer(uint64_t size);
+
+        uint64_t get_peak_buffer_size() const
+        {
+            return this->peak_buffer_size_;
+        }
+
+        // Running total over all modules, which can be read while the scan is in progress
+        void add_compared_bytes(const uint64_t size)
+        {
+            this->compared_bytes_.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        uint64_t get_compared_bytes() const
+        {
+            return this->compared_bytes_.load(std::memory_order_relaxed);
+        }
+
+        std::chrono::nanoseconds get_elapsed_time() const;
+
+        bool write_trace(const std::filesystem::path& path) const;
+
+      private:
+        struct trace_event
+        {
+            scan_phase phase{};
+            const module_profile* profile{};
+            uint32_t thread_index{};
+            std::chrono::steady_clock::time_point start{};
+            std::chrono::nanoseconds duration{};
+        };
+
+        bool record_trace_{false};
+        std::chrono::steady_clock::time_point start_{std::chrono::steady_clock::now()};
+
+        std::atomic_uint64_t buffer_size_{0};
+        std::atomic_uint64_t peak_buffer_size_{0};
+        std::atomic_uint64_t compared_bytes_{0};
+
+        mutable std::mutex mutex_{};
+        std::vector<trace_event> events_{};
+
+        void add_event(const trace_event& event);
+    };
+}
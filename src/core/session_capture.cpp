@@ -0,0 +1,413 @@
+#include "session_capture.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include "compression.hpp"
+#include "buffer_accessor.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr uint32_t capture_magic = 0x43534650; // PFSC
+        constexpr uint32_t capture_version = 1;
+
+        constexpr size_t chunk_size = 64 * 1024;
+
+        struct capture_header
+        {
+            uint32_t magic{};
+            uint32_t version{};
+            uint64_t chunk_offset{};
+            uint64_t chunk_count{};
+            uint64_t module_offset{};
+            uint64_t module_count{};
+        };
+
+        struct capture_module
+        {
+            uint64_t base_address{};
+            uint64_t size{};
+            uint64_t file_size{};
+            int64_t last_write_time{};
+            uint32_t time_date_stamp{};
+            uint32_t size_of_image{};
+            uint32_t path_length{};
+            uint32_t flags{};
+        };
+
+        constexpr uint32_t has_file_identity = 1;
+        constexpr uint32_t has_image_identity = 2;
+
+        using buffer_accessor = utils::safe_buffer_accessor<const std::byte>;
+
+        template <typename T>
+        void write_object(std::ofstream& stream, const T& object)
+        {
+            stream.write(reinterpret_cast<const char*>(&object), sizeof(object));
+        }
+
+        capture_module to_capture_module(const captured_module& entry)
+        {
+            const auto& module = entry.module;
+
+            capture_module result{
+                .base_address = module.base_address,
+                .size = module.size,
+                .path_length = static_cast<uint32_t>(module.path.size()),
+            };
+
+            if (entry.file)
+            {
+                result.flags |= has_file_identity;
+                result.file_size = entry.file->size;
+                result.last_write_time = entry.file->last_write_time;
+            }
+
+            if (module.identity)
+            {
+                result.flags |= has_image_identity;
+                result.time_date_stamp = module.identity->time_date_stamp;
+                result.size_of_image = module.identity->size_of_image;
+            }
+
+            return result;
+        }
+
+        captured_module from_capture_module(const capture_module& entry, std::string path)
+        {
+            captured_module result{};
+            result.module.path = std::move(path);
+            result.module.base_address = entry.base_address;
+            result.module.size = entry.size;
+
+            if (entry.flags & has_file_identity)
+            {
+                result.file = file_identity{entry.file_size, entry.last_write_time};
+            }
+
+            if (entry.flags & has_image_identity)
+            {
+                result.module.identity = image_identity{entry.time_date_stamp, entry.size_of_image};
+            }
+
+            return result;
+        }
+    }
+
+    session_writer::session_writer(const std::filesystem::path& path, const bool compress)
+        : stream_(path, std::ios::binary | std::ios::trunc),
+          compress_(compress)
+    {
+        // The header is rewritten once the index is known
+        write_object(this->stream_, capture_header{});
+        this->offset_ = sizeof(capture_header);
+    }
+
+    // Chunks are compressed before taking the lock, so threads only serialize on the write itself
+    void session_writer::add_memory(const uint64_t address, const std::span<const uint8_t> data)
+    {
+        for (size_t offset = 0; offset < data.size(); offset += chunk_size)
+        {
+            const auto chunk_data = data.subspan(offset, std::min(chunk_size, data.size() - offset));
+
+            std::vector<uint8_t> compressed{};
+            if (this->compress_)
+            {
+                compressed = utils::compress_block(chunk_data);
+            }
+
+            const auto use_compressed = this->compress_ && compressed.size() < chunk_data.size();
+            const auto stored_data = use_compressed ? std::span<const uint8_t>(compressed) : chunk_data;
+
+            std::scoped_lock lock{this->mutex_};
+
+            this->chunks_.push_back({
+                .address = address + offset,
+                .file_offset = this->offset_,
+                .size = static_cast<uint32_t>(chunk_data.size()),
+                .stored_size = static_cast<uint32_t>(stored_data.size()),
+            });
+
+            this->stream_.write(reinterpret_cast<const char*>(stored_data.data()), static_cast<std::streamsize>(stored_data.size()));
+            this->offset_ += stored_data.size();
+        }
+    }
+
+    void session_writer::add_module(const captured_module& module)
+    {
+        std::scoped_lock lock{this->mutex_};
+        this->modules_.push_back(module);
+    }
+
+    uint64_t session_writer::finish()
+    {
+        std::scoped_lock lock{this->mutex_};
+
+        capture_header header{
+            .magic = capture_magic,
+            .version = capture_version,
+            .chunk_offset = this->offset_,
+            .chunk_count = this->chunks_.size(),
+            .module_count = this->modules_.size(),
+        };
+
+        for (const auto& chunk : this->chunks_)
+        {
+            write_object(this->stream_, chunk);
+        }
+
+        header.module_offset = header.chunk_offset + (this->chunks_.size() * sizeof(session_chunk));
+        auto size = header.module_offset;
+
+        for (const auto& module : this->modules_)
+        {
+            const auto& path = module.module.path;
+
+            write_object(this->stream_, to_capture_module(module));
+            this->stream_.write(path.data(), static_cast<std::streamsize>(path.size()));
+
+            size += sizeof(capture_module) + path.size();
+        }
+
+        this->stream_.seekp(0);
+        write_object(this->stream_, header);
+        this->stream_.close();
+
+        return this->stream_ ? size : 0;
+    }
+
+    capturing_memory_source::capturing_memory_source(memory_source& source, session_writer& writer)
+        : source_(source),
+          writer_(writer)
+    {
+    }
+
+    // Deferred, so that the memory is recorded by the thread that waits for the read, once the buffer is filled
+    std::future<bool> capturing_memory_source::read_memory(const uint64_t address, const std::span<uint8_t> buffer)
+    {
+        return std::async(std::launch::deferred, [this, address, buffer, result = this->source_.read_memory(address, buffer)]() mutable {
+            const auto success = result.get();
+            if (success)
+            {
+                this->writer_.add_memory(address, buffer);
+            }
+
+            return success;
+        });
+    }
+
+    std::span<const uint8_t> capturing_memory_source::get_memory_view(const uint64_t address, const size_t size)
+    {
+        const auto view = this->source_.get_memory_view(address, size);
+        if (!view.empty())
+        {
+            this->writer_.add_memory(address, view);
+        }
+
+        return view;
+    }
+
+    session_capture::session_capture(const std::filesystem::path& path)
+        : file_(path)
+    {
+        const buffer_accessor buffer{this->file_.get_data()};
+        const auto header = buffer.as<capture_header>(0).get();
+
+        if (header.magic != capture_magic || header.version != capture_version)
+        {
+            throw std::runtime_error("Not a session capture: " + path.string());
+        }
+
+        // The count comes from the file, so the table is checked to lie within it before anything is allocated for it
+        const auto chunk_offset = static_cast<size_t>(header.chunk_offset);
+        if (header.chunk_count > buffer.get_buffer().size() / sizeof(session_chunk))
+        {
+            throw std::runtime_error("Invalid chunk table in session capture: " + path.string());
+        }
+
+        buffer.validate(chunk_offset, static_cast<size_t>(header.chunk_count) * sizeof(session_chunk));
+        const auto chunks = buffer.as<session_chunk>(chunk_offset);
+
+        std::vector<session_chunk> stored_chunks{};
+        stored_chunks.reserve(static_cast<size_t>(header.chunk_count));
+
+        for (size_t i = 0; i < header.chunk_count; ++i)
+        {
+            const auto entry = chunks.get(i);
+            buffer.validate(static_cast<size_t>(entry.file_offset), entry.stored_size);
+
+            if (entry.stored_size > entry.size || entry.address + entry.size < entry.address)
+            {
+                throw std::runtime_error("Invalid chunk in session capture: " + path.string());
+            }
+
+            if (entry.size)
+            {
+                stored_chunks.push_back(entry);
+            }
+        }
+
+        // Chunks that overlap an earlier one, because a region was captured twice with different extents, keep their tail
+        std::ranges::stable_sort(stored_chunks, {}, &session_chunk::address);
+        this->chunks_.reserve(stored_chunks.size());
+
+        for (const auto& entry : stored_chunks)
+        {
+            const auto covered_until = this->chunks_.empty() ? entry.address : this->chunks_.back().address + this->chunks_.back().size;
+            const auto chunk_end = entry.address + entry.size;
+
+            if (chunk_end <= covered_until)
+            {
+                continue;
+            }
+
+            const auto start = std::max(entry.address, covered_until);
+
+            this->chunks_.push_back(chunk_range{
+                .address = start,
+                .size = chunk_end - start,
+                .chunk_offset = start - entry.address,
+                .chunk = entry,
+            });
+        }
+
+        auto module_offset = static_cast<size_t>(header.module_offset);
+
+        for (size_t i = 0; i < header.module_count; ++i)
+        {
+            const auto entry = buffer.as<capture_module>(module_offset).get();
+            module_offset += sizeof(capture_module);
+
+            const auto* path_data = buffer.get_pointer_for_range(module_offset, entry.path_length);
+            module_offset += entry.path_length;
+
+            this->modules_.push_back(from_capture_module(entry, {reinterpret_cast<const char*>(path_data), entry.path_length}));
+        }
+    }
+
+    std::vector<module_info> session_capture::get_modules()
+    {
+        std::vector<module_info> modules{};
+        modules.reserve(this->modules_.size());
+
+        for (const auto& module : this->modules_)
+        {
+            modules.push_back(module.module);
+        }
+
+        return modules;
+    }
+
+    std::vector<session_capture::chunk_range>::const_iterator session_capture::find_chunk(const uint64_t address) const
+    {
+        auto entry = std::ranges::upper_bound(this->chunks_, address, {}, &chunk_range::address);
+        if (entry == this->chunks_.begin())
+        {
+            return this->chunks_.end();
+        }
+
+        --entry;
+        return address < entry->address + entry->size ? entry : this->chunks_.end();
+    }
+
+    bool session_capture::read_chunk(const session_chunk& chunk, const uint64_t offset, const std::span<uint8_t> buffer) const
+    {
+        const auto* data = reinterpret_cast<const uint8_t*>(this->file_.get_data().data()) + chunk.file_offset;
+
+        if (chunk.stored_size == chunk.size)
+        {
+            memcpy(buffer.data(), data + offset, buffer.size());
+            return true;
+        }
+
+        const std::span<const uint8_t> stored_data{data, chunk.stored_size};
+
+        if (offset == 0 && buffer.size() == chunk.size)
+        {
+            return utils::decompress_block(stored_data, buffer);
+        }
+
+        std::vector<uint8_t> chunk_data(chunk.size);
+        if (!utils::decompress_block(stored_data, chunk_data))
+        {
+            return false;
+        }
+
+        memcpy(buffer.data(), chunk_data.data() + offset, buffer.size());
+        return true;
+    }
+
+    // Reads may span multiple chunks, as long as there is no gap between them
+    std::future<bool> session_capture::read_memory(uint64_t address, std::span<uint8_t> buffer)
+    {
+        auto entry = this->find_chunk(address);
+
+        while (!buffer.empty())
+        {
+            if (entry == this->chunks_.end() || address < entry->address || address >= entry->address + entry->size)
+            {
+                return make_ready_read_result(false);
+            }
+
+            const auto offset = address - entry->address;
+            const auto size = static_cast<size_t>(std::min<uint64_t>(buffer.size(), entry->size - offset));
+
+            if (!this->read_chunk(entry->chunk, entry->chunk_offset + offset, buffer.subspan(0, size)))
+            {
+                return make_ready_read_result(false);
+            }
+
+            buffer = buffer.subspan(size);
+            address += size;
+            ++entry;
+        }
+
+        return make_ready_read_result(true);
+    }
+
+    // Uncompressed chunks that follow each other in memory and in the file form one view
+    std::span<const uint8_t> session_capture::get_memory_view(const uint64_t address, const size_t size)
+    {
+        const auto is_stored_raw = [](const chunk_range& range) { return range.chunk.stored_size == range.chunk.size; };
+        const auto get_file_offset = [](const chunk_range& range) { return range.chunk.file_offset + range.chunk_offset; };
+
+        auto entry = this->find_chunk(address);
+        if (entry == this->chunks_.end() || !is_stored_raw(*entry))
+        {
+            return {};
+        }
+
+        const auto start_offset = get_file_offset(*entry) + (address - entry->address);
+        auto end = entry->address + entry->size;
+
+        while (end - address < size)
+        {
+            const auto previous = entry++;
+
+            const auto is_contiguous = entry != this->chunks_.end() && entry->address == end && is_stored_raw(*entry) &&
+                                       get_file_offset(*entry) == get_file_offset(*previous) + previous->size;
+            if (!is_contiguous)
+            {
+                return {};
+            }
+
+            end += entry->size;
+        }
+
+        const auto* data = reinterpret_cast<const uint8_t*>(this->file_.get_data().data());
+        return {data + start_offset, size};
+    }
+
+    bool session_capture::is_session_capture(const std::filesystem::path& path)
+    {
+        std::ifstream stream{path, std::ios::binary};
+
+        uint32_t magic{};
+        stream.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+
+        return stream && magic == capture_magic;
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include "loaded_image.hpp"
+#include "mapped_file.hpp"
+#include "memory_source.hpp"
+
+namespace momo
+{
+    struct captured_module
+    {
+        module_info module{};
+        std::optional<file_identity> file{};
+    };
+
+    // Stored as is in the chunk index of the file
+    struct session_chunk
+    {
+        uint64_t address{};
+        uint64_t file_offset{};
+        uint32_t size{};
+        uint32_t stored_size{};
+    };
+
+    /*****************************************************************************
+     * Streams captured memory into a session file. Memory is stored in
+     * chunks, each compressed on its own if that makes it smaller, followed
+     * by an index of all chunks and the module table. Captures only hold the
+     * memory that was scanned, which is a small part of a full dump.
+     * Thread-safe.
+     ****************************************************************************/
+
+    class session_writer
+    {
+      public:
+        session_writer(const std::filesystem::path& path, bool compress);
+
+        bool is_open() const
+        {
+            return this->stream_.is_open();
+        }
+
+        void add_memory(uint64_t address, std::span<const uint8_t> data);
+        void add_module(const captured_module& module);
+
+        // Writes the index and returns the size of the capture, or 0 if writing failed
+        uint64_t finish();
+
+      private:
+        std::mutex mutex_{};
+        std::ofstream stream_{};
+        bool compress_{};
+
+        uint64_t offset_{};
+        std::vector<session_chunk> chunks_{};
+        std::vector<captured_module> modules_{};
+    };
+
+    // Passes reads through and records the memory that was read successfully
+    class capturing_memory_source : public memory_source
+    {
+      public:
+        capturing_memory_source(memory_source& source, session_writer& writer);
+
+        std::future<bool> read_memory(uint64_t address, std::span<uint8_t> buffer) override;
+        std::span<const uint8_t> get_memory_view(uint64_t address, size_t size) override;
+
+      private:
+        memory_source& source_;
+        session_writer& writer_;
+    };
+
+    /*****************************************************************************
+     * Reads a session file. The file is mapped, so uncompressed chunks are
+     * served without copies. Compressed chunks are decompressed on access.
+     * Throws if the file is not a valid capture.
+     ****************************************************************************/
+
+    class session_capture : public memory_source, public module_enumerator
+    {
+      public:
+        explicit session_capture(const std::filesystem::path& path);
+
+        std::vector<module_info> get_modules() override;
+        std::future<bool> read_memory(uint64_t address, std::span<uint8_t> buffer) override;
+        std::span<const uint8_t> get_memory_view(uint64_t address, size_t size) override;
+
+        const std::vector<captured_module>& get_captured_modules() const
+        {
+            return this->modules_;
+        }
+
+        static bool is_session_capture(const std::filesystem::path& path);
+
+      private:
+        // The part of a stored chunk that no earlier chunk covers, memory that was read more than once is only kept once
+        struct chunk_range
+        {
+            uint64_t address{};
+            uint64_t size{};
+            uint64_t chunk_offset{};
+            session_chunk chunk{};
+        };
+
+        utils::mapped_file file_{};
+
+        // Sorted by address and not overlapping
+        std::vector<chunk_range> chunks_{};
+        std::vector<captured_module> modules_{};
+
+        std::vector<chunk_range>::const_iterator find_chunk(uint64_t address) const;
+        bool read_chunk(const session_chunk& chunk, uint64_t offset, std::span<uint8_t> buffer) const;
+    };
+}
@@ -0,0 +1,105 @@
+#include "symbol_index.hpp"
+
+#include <cstdio>
+#include <cinttypes>
+#include <algorithm>
+
+namespace momo
+{
+    void symbol_index::add(const std::span<const symbol_entry> entries)
+    {
+        const auto is_before = [](const symbol_range& left, const symbol_range& right) { return left.start < right.start; };
+
+        std::vector<symbol_range> added{};
+        added.reserve(entries.size());
+
+        for (const auto& entry : entries)
+        {
+            added.push_back({
+                .start = entry.start,
+                .end = std::max(entry.end, entry.start + 1),
+                .base = entry.base,
+                .name_offset = static_cast<uint32_t>(this->names_.size()),
+                .name_length = static_cast<uint32_t>(entry.name.size()),
+            });
+
+            this->names_.append(entry.name);
+        }
+
+        std::ranges::stable_sort(added, is_before);
+
+        std::vector<symbol_range> pieces{};
+        uint64_t added_until = 0;
+
+        // Ends are sorted as well, as the ranges don't overlap
+        for (const auto& range : added)
+        {
+            auto position = std::max(range.start, added_until);
+
+            for (auto known = std::ranges::upper_bound(this->ranges_, position, {}, &symbol_range::end);
+                 known != this->ranges_.end() && known->start < range.end; ++known)
+            {
+                if (position < known->start)
+                {
+                    auto& piece = pieces.emplace_back(range);
+                    piece.start = position;
+                    piece.end = known->start;
+                }
+
+                position = std::max(position, known->end);
+            }
+
+            if (position < range.end)
+            {
+                auto& piece = pieces.emplace_back(range);
+                piece.start = position;
+            }
+
+            added_until = std::max(added_until, range.end);
+        }
+
+        const auto old_size = static_cast<ptrdiff_t>(this->ranges_.size());
+        this->ranges_.insert(this->ranges_.end(), pieces.begin(), pieces.end());
+
+        std::inplace_merge(this->ranges_.begin(), this->ranges_.begin() + old_size, this->ranges_.end(), is_before);
+    }
+
+    std::optional<symbol_location> symbol_index::find(const uint64_t address) const
+    {
+        const auto next = std::ranges::upper_bound(this->ranges_, address, {}, &symbol_range::start);
+        if (next == this->ranges_.begin())
+        {
+            return std::nullopt;
+        }
+
+        const auto& range = *(next - 1);
+        if (address >= range.end)
+        {
+            return std::nullopt;
+        }
+
+        return symbol_location{
+            .name = std::string_view(this->names_).substr(range.name_offset, range.name_length),
+            .offset = address - range.base,
+        };
+    }
+
+    void symbol_index::clear()
+    {
+        this->ranges_.clear();
+        this->names_.clear();
+    }
+
+    std::string format_symbol(const symbol_location& location)
+    {
+        if (location.name.empty() || location.offset == 0)
+        {
+            return std::string(location.name);
+        }
+
+        char offset[24]{};
+        snprintf(offset, sizeof(offset), "+0x%" PRIX64, location.offset);
+
+        return std::string(location.name) + offset;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace momo
+{
+    struct symbol_entry
+    {
+        uint64_t start{};
+        uint64_t end{};
+
+        // Offsets are relative to this, which differs from start for function chunks
+        uint64_t base{};
+        std::string name{};
+    };
+
+    struct symbol_location
+    {
+        std::string_view name{};
+        uint64_t offset{};
+    };
+
+    /*****************************************************************************
+     * Named address ranges, e.g. functions and their chunks. Ranges are kept
+     * sorted and are looked up by binary search. Entries are added in batches,
+     * which are sorted on their own and merged. Known ranges take precedence,
+     * a new range that overlaps them only fills the gaps in between.
+     * Entries with an empty name remember that an address has no symbol.
+     ****************************************************************************/
+
+    class symbol_index
+    {
+      public:
+        void add(std::span<const symbol_entry> entries);
+        std::optional<symbol_location> find(uint64_t address) const;
+
+        size_t size() const
+        {
+            return this->ranges_.size();
+        }
+
+        void clear();
+
+      private:
+        struct symbol_range
+        {
+            uint64_t start{};
+            uint64_t end{};
+            uint64_t base{};
+            uint32_t name_offset{};
+            uint32_t name_length{};
+        };
+
+        std::vector<symbol_range> ranges_{};
+        std::string names_{};
+    };
+
+    // Formats the location as name+0x10, or just the name at offset 0
+    std::string format_symbol(const symbol_location& location);
+}
@@ -0,0 +1,292 @@
+#include "table_hooks.hpp"
+#include "hash_set.hpp"
+#include "module_scanner.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t page_size = 0x1000;
+
+        struct checked_module
+        {
+            size_t index{};
+            std::shared_ptr<const loaded_image> image{};
+        };
+
+        struct loaded_modules
+        {
+            std::vector<checked_module> checked{};
+
+            // Sorted by address, imports that point into these can't be verified
+            std::vector<memory_range> skipped{};
+
+            bool is_skipped(const uint64_t address) const
+            {
+                const auto entry = std::ranges::upper_bound(this->skipped, address, {}, &memory_range::address);
+                return entry != this->skipped.begin() && address - std::prev(entry)->address < std::prev(entry)->size;
+            }
+        };
+
+        loaded_modules load_images(memory_source& memory, image_cache& cache, const std::span<const module_info> modules)
+        {
+            loaded_modules result{};
+            result.checked.reserve(modules.size());
+
+            for (size_t i = 0; i < modules.size(); ++i)
+            {
+                const auto& module = modules[i];
+                std::shared_ptr<const loaded_image> image{};
+
+                try
+                {
+                    image = cache.get_image(module.path);
+                }
+                catch (...)
+                {
+                    // Just ignore all issues
+                }
+
+                const auto headers = image ? read_module_headers(memory, module.base_address) : std::nullopt;
+
+                const auto is_same_build = image && (!module.identity || *module.identity == image->image.identity) &&
+                                           (!headers || headers->identity == image->image.identity);
+                if (!is_same_build)
+                {
+                    result.skipped.emplace_back(module.base_address, module.size);
+                    continue;
+                }
+
+                result.checked.emplace_back(i, std::move(image));
+            }
+
+            std::ranges::sort(result.skipped, {}, &memory_range::address);
+            return result;
+        }
+
+        utils::hash_set<uint64_t> collect_export_addresses(const std::span<const module_info> modules,
+                                                           const std::vector<checked_module>& checked_modules)
+        {
+            size_t count = 0;
+            for (const auto& module : checked_modules)
+            {
+                count += module.image->tables.exports.size();
+            }
+
+            utils::hash_set<uint64_t> addresses{};
+            addresses.reserve(count);
+
+            for (const auto& module : checked_modules)
+            {
+                const auto base_address = modules[module.index].base_address;
+
+                for (const auto& slot : module.image->tables.exports)
+                {
+                    if (slot.function_rva != 0 && !slot.is_forwarder)
+                    {
+                        addresses.insert(base_address + slot.function_rva);
+                    }
+                }
+            }
+
+            return addresses;
+        }
+
+        struct table_data
+        {
+            uint64_t address{};
+            std::vector<uint8_t> data{};
+            std::vector<memory_range> unreadable{};
+
+            bool is_readable(const uint64_t slot_address, const size_t size) const
+            {
+                return std::ranges::none_of(this->unreadable, [&](const memory_range& range) {
+                    return slot_address < range.address + range.size && range.address < slot_address + size;
+                });
+            }
+        };
+
+        // Read with a single request first, then page by page, so that one bad page only hides the slots on it
+        table_data read_table(memory_source& memory, const uint64_t address, const size_t size)
+        {
+            table_data table{.address = address, .data = std::vector<uint8_t>(size)};
+            if (memory.read_memory(address, table.data).get())
+            {
+                return table;
+            }
+
+            size_t offset = 0;
+            while (offset < size)
+            {
+                const auto page_end = ((address + offset) & ~static_cast<uint64_t>(page_size - 1)) + page_size;
+                const auto chunk = std::min(static_cast<size_t>(page_end - (address + offset)), size - offset);
+
+                if (!memory.read_memory(address + offset, std::span(table.data).subspan(offset, chunk)).get())
+                {
+                    auto& ranges = table.unreadable;
+                    if (!ranges.empty() && ranges.back().address + ranges.back().size == address + offset)
+                    {
+                        ranges.back().size += chunk;
+                    }
+                    else
+                    {
+                        ranges.emplace_back(address + offset, chunk);
+                    }
+                }
+
+                offset += chunk;
+            }
+
+            return table;
+        }
+
+        void add_unreadable_ranges(const table_data& table, std::vector<memory_range>& ranges)
+        {
+            ranges.insert(ranges.end(), table.unreadable.begin(), table.unreadable.end());
+        }
+
+        uint64_t read_pointer(const uint8_t* data, const uint32_t pointer_size)
+        {
+            if (pointer_size == sizeof(uint32_t))
+            {
+                uint32_t value{};
+                memcpy(&value, data, sizeof(value));
+                return value;
+            }
+
+            uint64_t value{};
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        // Descriptors are terminated by a null slot, so slots at most one pointer apart belong to the same table
+        std::vector<std::span<const import_slot>> get_import_runs(const std::span<const import_slot> imports, const uint32_t pointer_size)
+        {
+            std::vector<std::span<const import_slot>> runs{};
+
+            size_t run_start = 0;
+            for (size_t i = 1; i <= imports.size(); ++i)
+            {
+                if (i == imports.size() || imports[i].rva <= imports[i - 1].rva ||
+                    imports[i].rva - imports[i - 1].rva > 2 * static_cast<uint64_t>(pointer_size))
+                {
+                    runs.emplace_back(imports.subspan(run_start, i - run_start));
+                    run_start = i;
+                }
+            }
+
+            return runs;
+        }
+
+        void check_imports(memory_source& memory, const module_info& module, const size_t module_index, const address_tables& tables,
+                           const utils::hash_set<uint64_t>& exports, const loaded_modules& loaded, table_hook_result& result)
+        {
+            const auto& imports = tables.imports;
+            if (imports.empty() || (tables.pointer_size != sizeof(uint32_t) && tables.pointer_size != sizeof(uint64_t)))
+            {
+                return;
+            }
+
+            for (const auto run : get_import_runs(imports, tables.pointer_size))
+            {
+                const auto first_rva = run.front().rva;
+                const auto size = run.back().rva + tables.pointer_size - first_rva;
+
+                const auto table = read_table(memory, module.base_address + first_rva, size);
+                add_unreadable_ranges(table, result.unreadable_ranges);
+
+                for (const auto& slot : run)
+                {
+                    const auto slot_address = module.base_address + slot.rva;
+                    if (!table.is_readable(slot_address, tables.pointer_size))
+                    {
+                        continue;
+                    }
+
+                    const auto value = read_pointer(table.data.data() + (slot.rva - first_rva), tables.pointer_size);
+
+                    // Slots that were never bound still hold their file value
+                    if (value == 0 || value == slot.file_value || exports.contains(value))
+                    {
+                        continue;
+                    }
+
+                    result.hooks.emplace_back(table_hook{
+                        .table = address_table_type::import_table,
+                        .module_index = module_index,
+                        .slot_address = slot_address,
+                        .target = value,
+                        .name = slot.name,
+                        .unverifiable = loaded.is_skipped(value),
+                    });
+                }
+            }
+        }
+
+        void check_exports(memory_source& memory, const module_info& module, const size_t module_index, const address_tables& tables,
+                           table_hook_result& result)
+        {
+            const auto& exports = tables.exports;
+            if (exports.empty())
+            {
+                return;
+            }
+
+            const auto table = read_table(memory, module.base_address + exports.front().rva, exports.size() * sizeof(uint32_t));
+            add_unreadable_ranges(table, result.unreadable_ranges);
+
+            for (size_t i = 0; i < exports.size(); ++i)
+            {
+                const auto& slot = exports[i];
+                if (!table.is_readable(module.base_address + slot.rva, sizeof(uint32_t)))
+                {
+                    continue;
+                }
+
+                uint32_t rva{};
+                memcpy(&rva, table.data.data() + (i * sizeof(rva)), sizeof(rva));
+
+                if (rva == slot.function_rva)
+                {
+                    continue;
+                }
+
+                result.hooks.emplace_back(table_hook{
+                    .table = address_table_type::export_table,
+                    .module_index = module_index,
+                    .slot_address = module.base_address + slot.rva,
+                    .target = module.base_address + rva,
+                    .expected = module.base_address + slot.function_rva,
+                    .name = slot.name,
+                });
+            }
+        }
+    }
+
+    table_hook_result find_table_hooks(memory_source& memory, image_cache& cache, const std::span<const module_info> modules)
+    {
+        const auto loaded = load_images(memory, cache, modules);
+        const auto exports = collect_export_addresses(modules, loaded.checked);
+
+        table_hook_result result{};
+
+        for (const auto& checked_module : loaded.checked)
+        {
+            const auto& module = modules[checked_module.index];
+            const auto& tables = checked_module.image->tables;
+
+            check_imports(memory, module, checked_module.index, tables, exports, loaded, result);
+            check_exports(memory, module, checked_module.index, tables, result);
+        }
+
+        return result;
+    }
+
+    const char* get_table_name(const address_table_type table)
+    {
+        return table == address_table_type::import_table ? "IAT" : "EAT";
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <optional>
+
+#include "image_cache.hpp"
+#include "memory_source.hpp"
+#include "module_scanner.hpp"
+
+namespace momo
+{
+    enum class address_table_type : uint8_t
+    {
+        import_table,
+        export_table,
+    };
+
+    struct table_hook
+    {
+        address_table_type table{};
+        size_t module_index{};
+        uint64_t slot_address{};
+        uint64_t target{};
+
+        // Only known for export entries, whose original value is stored in the file
+        std::optional<uint64_t> expected{};
+
+        std::string name{};
+
+        // The target lies in a module whose exports couldn't be loaded, so the slot may well be bound correctly
+        bool unverifiable{false};
+    };
+
+    struct table_hook_result
+    {
+        std::vector<table_hook> hooks{};
+        std::vector<memory_range> unreadable_ranges{};
+    };
+
+    /*****************************************************************************
+     * Checks the import and export address tables of all modules. The exports
+     * of every module are collected into one hash set first, so that every
+     * bound import slot is validated with a single lookup, no matter which
+     * module it imports from. Export entries are compared to the file. Every
+     * run of adjacent slots is read with a single request, pages that can't
+     * be read are retried one by one and reported. Modules whose image can't
+     * be loaded or is a different build than the one in memory are skipped,
+     * import slots that point into them are reported as unverifiable.
+     ****************************************************************************/
+
+    table_hook_result find_table_hooks(memory_source& memory, image_cache& cache, std::span<const module_info> modules);
+
+    // IAT or EAT
+    const char* get_table_name(address_table_type table);
+}
@@ -0,0 +1,42 @@
+#include "task_queue.hpp"
+
+namespace momo::utils
+{
+    void task_queue::post(task task)
+    {
+        {
+            std::scoped_lock lock{this->mutex_};
+            this->tasks_.emplace_back(std::move(task));
+        }
+
+        this->condition_variable_.notify_all();
+    }
+
+    void task_queue::notify()
+    {
+        {
+            std::scoped_lock lock{this->mutex_};
+            this->notified_ = true;
+        }
+
+        this->condition_variable_.notify_all();
+    }
+
+    void task_queue::run(const std::chrono::milliseconds timeout)
+    {
+        std::deque<task> tasks{};
+
+        {
+            std::unique_lock lock{this->mutex_};
+            this->condition_variable_.wait_for(lock, timeout, [this] { return this->notified_ || !this->tasks_.empty(); });
+
+            this->notified_ = false;
+            tasks.swap(this->tasks_);
+        }
+
+        for (auto& task : tasks)
+        {
+            task();
+        }
+    }
+}
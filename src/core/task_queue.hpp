@@ -0,0 +1,58 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+namespace momo::utils
+{
+    /*****************************************************************************
+     * Lets worker threads run code on the thread that owns the queue, which
+     * has to pump it regularly. Used for APIs that are not thread-safe.
+     ****************************************************************************/
+
+    class task_queue
+    {
+      public:
+        using task = std::function<void()>;
+
+        template <typename Function>
+        std::future<std::invoke_result_t<Function>> execute_async(Function&& function)
+        {
+            using result_type = std::invoke_result_t<Function>;
+
+            auto packaged_task = std::make_shared<std::packaged_task<result_type()>>(std::forward<Function>(function));
+            auto future = packaged_task->get_future();
+
+            this->post([packaged_task] { (*packaged_task)(); });
+
+            return future;
+        }
+
+        // Blocks until the owning thread has executed the function
+        template <typename Function>
+        std::invoke_result_t<Function> execute(Function&& function)
+        {
+            return this->execute_async(std::forward<Function>(function)).get();
+        }
+
+        void post(task task);
+
+        // Wakes up a thread waiting in run, even if nothing was posted
+        void notify();
+
+        // Executes all pending tasks, waiting up to timeout for the first one
+        void run(std::chrono::milliseconds timeout = {});
+
+      private:
+        std::mutex mutex_{};
+        std::condition_variable condition_variable_{};
+        std::deque<task> tasks_{};
+        bool notified_{false};
+    };
+}
@@ -0,0 +1,148 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <exception>
+
+namespace momo::utils
+{
+    thread_pool::thread_pool(const size_t thread_count)
+    {
+        this->threads_.reserve(thread_count);
+
+        for (size_t i = 0; i < std::max(thread_count, static_cast<size_t>(1)); ++i)
+        {
+            this->threads_.emplace_back([this] { this->work(); });
+        }
+    }
+
+    thread_pool::~thread_pool()
+    {
+        {
+            std::scoped_lock lock{this->mutex_};
+            this->stop_ = true;
+        }
+
+        this->condition_variable_.notify_all();
+
+        for (auto& thread : this->threads_)
+        {
+            thread.join();
+        }
+    }
+
+    void thread_pool::schedule(task task)
+    {
+        {
+            std::scoped_lock lock{this->mutex_};
+            this->tasks_.emplace_back(std::move(task));
+        }
+
+        this->condition_variable_.notify_one();
+    }
+
+    void thread_pool::parallel_for(const size_t count, const std::function<void(size_t)>& function)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        // Helpers may only get to run after all items are done, so they must not reference the stack
+        struct shared_state
+        {
+            std::atomic_size_t next_index{0};
+            size_t count{};
+            const std::function<void(size_t)>* function{};
+
+            std::mutex mutex{};
+            std::condition_variable condition_variable{};
+            size_t completed{};
+            std::exception_ptr exception{};
+        };
+
+        auto state = std::make_shared<shared_state>();
+        state->count = count;
+        state->function = &function;
+
+        const auto work = [](shared_state& s) {
+            while (true)
+            {
+                const auto index = s.next_index++;
+                if (index >= s.count)
+                {
+                    return;
+                }
+
+                std::exception_ptr exception{};
+
+                try
+                {
+                    (*s.function)(index);
+                }
+                catch (...)
+                {
+                    exception = std::current_exception();
+                }
+
+                {
+                    std::scoped_lock lock{s.mutex};
+                    ++s.completed;
+
+                    if (exception && !s.exception)
+                    {
+                        s.exception = exception;
+                    }
+                }
+
+                s.condition_variable.notify_all();
+            }
+        };
+
+        const auto helper_count = std::min(count, this->threads_.size()) - 1;
+        for (size_t i = 0; i < helper_count; ++i)
+        {
+            this->schedule([state, work] { work(*state); });
+        }
+
+        work(*state);
+
+        std::unique_lock lock{state->mutex};
+        state->condition_variable.wait(lock, [&] { return state->completed == state->count; });
+
+        if (state->exception)
+        {
+            std::rethrow_exception(state->exception);
+        }
+    }
+
+    size_t thread_pool::get_default_thread_count()
+    {
+        return std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    // Pending tasks are still executed when the pool is destroyed
+    void thread_pool::work()
+    {
+        while (true)
+        {
+            task current_task{};
+
+            {
+                std::unique_lock lock{this->mutex_};
+                this->condition_variable_.wait(lock, [this] { return this->stop_ || !this->tasks_.empty(); });
+
+                if (this->tasks_.empty())
+                {
+                    return;
+                }
+
+                current_task = std::move(this->tasks_.front());
+                this->tasks_.pop_front();
+            }
+
+            current_task();
+        }
+    }
+}
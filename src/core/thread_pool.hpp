@@ -0,0 +1,47 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace momo::utils
+{
+    class thread_pool
+    {
+      public:
+        using task = std::function<void()>;
+
+        explicit thread_pool(size_t thread_count = get_default_thread_count());
+        ~thread_pool();
+
+        thread_pool(thread_pool&&) = delete;
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(thread_pool&&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        void schedule(task task);
+
+        // The calling thread processes items as well, so this can be used from within pool tasks
+        void parallel_for(size_t count, const std::function<void(size_t)>& function);
+
+        size_t get_thread_count() const
+        {
+            return this->threads_.size();
+        }
+
+        static size_t get_default_thread_count();
+
+      private:
+        std::mutex mutex_{};
+        std::condition_variable condition_variable_{};
+        std::deque<task> tasks_{};
+        bool stop_{false};
+
+        std::vector<std::thread> threads_{};
+
+        void work();
+    };
+}
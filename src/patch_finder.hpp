@@ -1,6 +0,0 @@
-#pragma once
-
-namespace momo
-{
-    void find_patches();
-}
@@ -0,0 +1,262 @@
+#include "patch_chooser.hpp"
+
+#include <array>
+#include <limits>
+#include <vector>
+#include <cinttypes>
+#include <filesystem>
+
+#include "symbolizer.hpp"
+
+#include "ida_sdk.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr const char* chooser_title = "Patches";
+
+        /*****************************************************************************
+         * Shows the patch table with virtual rows. IDA only asks for the rows
+         * that are visible, so symbol names are resolved on first display, in
+         * batches of neighbouring rows. Changed pointer slots also show where
+         * they point now and where they should point.
+         ****************************************************************************/
+
+        class patch_chooser : public chooser_t
+        {
+          public:
+            patch_chooser()
+                : chooser_t(CH_KEEP | CH_CAN_REFRESH, static_cast<int>(column_widths.size()), column_widths.data(), column_names.data(),
+                            chooser_title)
+            {
+            }
+
+            patch_table& get_table()
+            {
+                return this->table_;
+            }
+
+            void clear()
+            {
+                this->table_.clear();
+                this->invalidate_rows();
+            }
+
+            void sort(const patch_sort_key key)
+            {
+                this->table_.sort(key);
+                this->invalidate_rows();
+            }
+
+            // Rows move when patches are added or sorted
+            void invalidate_rows()
+            {
+                this->resolved_window_ = no_window;
+            }
+
+            size_t idaapi get_count() const override
+            {
+                return this->table_.size();
+            }
+
+            void idaapi get_row(qstrvec_t* columns, int* /*icon*/, chooser_item_attrs_t* /*attributes*/, const size_t row) const override
+            {
+                const auto& record = this->table_.get_row(row);
+                auto& values = *columns;
+
+                values[0].sprnt("%" PRIX64, record.address);
+                values[1].sprnt("%" PRIX32, record.length);
+                values[2] = std::filesystem::path(this->table_.get_module(record)).filename().string().c_str();
+                this->resolve_window(row);
+                values[3] = get_symbol(record.address).c_str();
+
+                if (const auto* target = this->table_.get_pointer_target(row))
+                {
+                    values[4].sprnt("0x%" PRIX64 " (%s), expected 0x%" PRIX64, target->target, get_symbol(target->target).c_str(),
+                                    target->expected);
+                }
+            }
+
+            ea_t idaapi get_ea(const size_t row) const override
+            {
+                return static_cast<ea_t>(this->table_.get_row(row).address);
+            }
+
+            cbret_t idaapi enter(const size_t row) override
+            {
+                jumpto(this->get_ea(row));
+                return {};
+            }
+
+          private:
+            static constexpr std::array<int, 5> column_widths{16 | CHCOL_HEX, 8 | CHCOL_HEX, 20 | CHCOL_PATH, 40, 40};
+            static constexpr std::array<const char*, 5> column_names{"Address", "Length", "Module", "Symbol", "Pointer target"};
+
+            static constexpr size_t window_size = 64;
+            static constexpr size_t no_window = std::numeric_limits<size_t>::max();
+
+            patch_table table_{};
+            mutable size_t resolved_window_{no_window};
+
+            // Rows are requested one by one, so the rows around the requested one are resolved together
+            void resolve_window(const size_t row) const
+            {
+                const auto window = row / window_size;
+                if (window == this->resolved_window_)
+                {
+                    return;
+                }
+
+                const auto end = std::min(this->table_.size(), (window + 1) * window_size);
+
+                std::vector<uint64_t> addresses{};
+                for (auto i = window * window_size; i < end; ++i)
+                {
+                    addresses.push_back(this->table_.get_row(i).address);
+
+                    if (const auto* target = this->table_.get_pointer_target(i))
+                    {
+                        addresses.push_back(target->target);
+                    }
+                }
+
+                resolve_symbols(addresses);
+                this->resolved_window_ = window;
+            }
+        };
+
+        patch_chooser& get_chooser()
+        {
+            static patch_chooser chooser{};
+            return chooser;
+        }
+
+        // IDA's own column sorting would fetch every row and resolve all symbols, so sorting is offered in the popup instead
+        class sort_action_handler : public action_handler_t
+        {
+          public:
+            explicit sort_action_handler(const patch_sort_key key)
+                : key_(key)
+            {
+            }
+
+            int idaapi activate(action_activation_ctx_t* /*context*/) override
+            {
+                get_chooser().sort(this->key_);
+                refresh_patch_chooser();
+                return 1;
+            }
+
+            action_state_t idaapi update(action_update_ctx_t* context) override
+            {
+                return context->widget_title == chooser_title ? AST_ENABLE_FOR_WIDGET : AST_DISABLE_FOR_WIDGET;
+            }
+
+          private:
+            patch_sort_key key_{};
+        };
+
+        struct sort_action
+        {
+            const char* name{};
+            const char* label{};
+            sort_action_handler* handler{};
+        };
+
+        std::array<sort_action, 3>& get_sort_actions()
+        {
+            static sort_action_handler by_module{patch_sort_key::module};
+            static sort_action_handler by_address{patch_sort_key::address};
+            static sort_action_handler by_length{patch_sort_key::length};
+
+            static std::array<sort_action, 3> actions{
+                sort_action{"patch_finder:sort_by_module", "Sort by module", &by_module},
+                sort_action{"patch_finder:sort_by_address", "Sort by address", &by_address},
+                sort_action{"patch_finder:sort_by_length", "Sort by length", &by_length},
+            };
+
+            return actions;
+        }
+
+        ssize_t idaapi on_ui_event(void* /*user_data*/, const int notification_code, va_list va)
+        {
+            if (notification_code != ui_populating_widget_popup)
+            {
+                return 0;
+            }
+
+            auto* widget = va_arg(va, TWidget*);
+            auto* popup = va_arg(va, TPopupMenu*);
+
+            qstring title{};
+            if (get_widget_title(&title, widget) && title == chooser_title)
+            {
+                for (const auto& action : get_sort_actions())
+                {
+                    attach_action_to_popup(widget, popup, action.name);
+                }
+            }
+
+            return 0;
+        }
+
+        bool actions_registered = false;
+
+        void register_sort_actions()
+        {
+            if (actions_registered)
+            {
+                return;
+            }
+
+            for (const auto& action : get_sort_actions())
+            {
+                register_action(ACTION_DESC_LITERAL(action.name, action.label, action.handler, nullptr, nullptr, -1));
+            }
+
+            hook_to_notification_point(HT_UI, on_ui_event);
+            actions_registered = true;
+        }
+    }
+
+    patch_table& get_patch_table()
+    {
+        return get_chooser().get_table();
+    }
+
+    void clear_patch_chooser()
+    {
+        get_chooser().clear();
+        refresh_patch_chooser();
+    }
+
+    void show_patch_chooser()
+    {
+        register_sort_actions();
+        get_chooser().choose();
+    }
+
+    void refresh_patch_chooser()
+    {
+        get_chooser().invalidate_rows();
+        refresh_chooser(chooser_title);
+    }
+
+    void close_patch_chooser()
+    {
+        close_chooser(chooser_title);
+
+        if (actions_registered)
+        {
+            unhook_from_notification_point(HT_UI, on_ui_event);
+
+            for (const auto& action : get_sort_actions())
+            {
+                unregister_action(action.name);
+            }
+
+            actions_registered = false;
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "patch_table.hpp"
+
+namespace momo
+{
+    // Results of the last full scan, only to be used from the main thread
+    patch_table& get_patch_table();
+
+    // Drops all results. Resolved symbols stay cached until the module layout changes.
+    void clear_patch_chooser();
+
+    // Opens the chooser or updates it after the table changed
+    void show_patch_chooser();
+    void refresh_patch_chooser();
+
+    // Closes the chooser and removes its actions when the plugin is unloaded
+    void close_patch_chooser();
+}
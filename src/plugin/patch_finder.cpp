@@ -0,0 +1,1127 @@
+#include "patch_finder.hpp"
+
+#include <atomic>
+#include <memory>
+#include <cstdarg>
+#include <cinttypes>
+#include <algorithm>
+#include <filesystem>
+
+#include "task_queue.hpp"
+#include "symbolizer.hpp"
+#include "patch_chooser.hpp"
+#include "image_cache.hpp"
+#include "module_store.hpp"
+#include "thread_pool.hpp"
+#include "patch_allowlist.hpp"
+#include "table_hooks.hpp"
+#include "scan_history.hpp"
+#include "module_scanner.hpp"
+#include "session_capture.hpp"
+
+#include "ida_sdk.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        struct module_result
+        {
+            bool finished{false};
+            bool complete{false};
+            module_scan_result result{};
+
+            // Why the module couldn't be scanned, for example because the image on disk is a different build
+            std::string error{};
+            module_profile profile{};
+
+            // What the last scan of the module found, if the reporter keeps track of it
+            std::optional<module_baseline> baseline{};
+        };
+
+        class scan_reporter
+        {
+          public:
+            virtual ~scan_reporter() = default;
+
+            // Called on the main thread in module order, returns the number of reported patches
+            virtual size_t report_module(scan_profiler& profiler, const module_info& module, module_result& result) = 0;
+            virtual void report_total(size_t total_patches) = 0;
+
+            // Called on the main thread before the module is scanned
+            virtual std::optional<module_baseline> get_baseline(const module_info&)
+            {
+                return std::nullopt;
+            }
+        };
+
+        // Only used on the main thread, where IDA's API can be called directly
+        class direct_memory_source : public memory_source
+        {
+          public:
+            std::future<bool> read_memory(const uint64_t address, const std::span<uint8_t> buffer) override
+            {
+                const auto size = static_cast<ssize_t>(buffer.size());
+                return make_ready_read_result(get_bytes(buffer.data(), size, static_cast<ea_t>(address)) == size);
+            }
+        };
+
+        // With remote debugging, the paths of modules usually only exist on the target
+        module_info get_module_info(const modinfo_t& modinfo, const module_store* store)
+        {
+            module_info module{
+                .path = modinfo.name.c_str(),
+                .base_address = modinfo.base,
+                .size = modinfo.size,
+            };
+
+            if (store)
+            {
+                direct_memory_source memory{};
+                const auto headers = read_module_headers(memory, module.base_address);
+
+                if (headers)
+                {
+                    module.identity = headers->identity;
+                    store->resolve_module(module);
+                }
+            }
+
+            return module;
+        }
+
+        class debugger_module_enumerator : public module_enumerator
+        {
+          public:
+            explicit debugger_module_enumerator(const module_store* store)
+                : store_(store)
+            {
+            }
+
+            std::vector<module_info> get_modules() override
+            {
+                std::vector<module_info> modules{};
+
+                modinfo_t modinfo{};
+                bool ok = get_first_module(&modinfo);
+
+                while (ok)
+                {
+                    modules.push_back(get_module_info(modinfo, this->store_));
+                    ok = get_next_module(&modinfo);
+                }
+
+                return modules;
+            }
+
+          private:
+            const module_store* store_{};
+        };
+
+        // IDA's API must only be used from the thread that runs find_patches, so reads are marshalled to it
+        class debugger_memory_source : public memory_source
+        {
+          public:
+            explicit debugger_memory_source(utils::task_queue& main_thread)
+                : main_thread_(main_thread)
+            {
+            }
+
+            std::future<bool> read_memory(const uint64_t address, const std::span<uint8_t> buffer) override
+            {
+                return this->main_thread_.execute_async([address, buffer] {
+                    const auto size = static_cast<ssize_t>(buffer.size());
+                    return get_bytes(buffer.data(), size, static_cast<ea_t>(address)) == size;
+                });
+            }
+
+          private:
+            utils::task_queue& main_thread_;
+        };
+
+        image_cache& get_image_cache()
+        {
+            static image_cache cache{};
+            return cache;
+        }
+
+        // Shared by all scans, so that the rescans of incremental scans don't start new threads on every library load
+        std::unique_ptr<utils::thread_pool>& get_thread_pool_instance()
+        {
+            static std::unique_ptr<utils::thread_pool> pool{};
+            return pool;
+        }
+
+        utils::thread_pool& get_thread_pool()
+        {
+            auto& pool = get_thread_pool_instance();
+            if (!pool)
+            {
+                pool = std::make_unique<utils::thread_pool>();
+            }
+
+            return *pool;
+        }
+
+        // The index is only loaded again if the store changes
+        const module_store* get_module_store(const scan_options& options)
+        {
+            static std::optional<module_store> store{};
+
+            if (options.module_store.empty())
+            {
+                return nullptr;
+            }
+
+            if (!store || store->get_directory() != options.module_store)
+            {
+                store.emplace(options.module_store);
+            }
+
+            return &*store;
+        }
+
+        // Loaded again if the file changes. Scans keep the allowlist they started with alive.
+        std::shared_ptr<const patch_allowlist> get_patch_allowlist(const scan_options& options)
+        {
+            static std::string loaded_path{};
+            static std::optional<file_identity> loaded_identity{};
+            static std::shared_ptr<const patch_allowlist> allowlist{};
+
+            if (options.allowlist.empty())
+            {
+                return {};
+            }
+
+            const auto identity = get_file_identity(options.allowlist);
+            if (allowlist && loaded_path == options.allowlist && loaded_identity == identity)
+            {
+                return allowlist;
+            }
+
+            loaded_path = options.allowlist;
+            loaded_identity = identity;
+            allowlist.reset();
+
+            try
+            {
+                auto entries = std::make_shared<patch_allowlist>();
+                entries->load(options.allowlist);
+                allowlist = std::move(entries);
+
+                msg("Loaded %zu allowed patches from %s\n", allowlist->size(), options.allowlist.c_str());
+            }
+            catch (const std::exception& e)
+            {
+                msg("Failed to load allowlist: %s\n", e.what());
+            }
+
+            return allowlist;
+        }
+
+        std::filesystem::path get_cache_directory(const scan_options& options)
+        {
+            if (!options.use_disk_cache)
+            {
+                return {};
+            }
+
+            if (!options.cache_directory.empty())
+            {
+                return options.cache_directory;
+            }
+
+            return std::filesystem::path(get_user_idadir()) / "patch-finder" / "cache";
+        }
+
+        void log_unreadable_ranges(const std::vector<memory_range>& ranges)
+        {
+            for (const auto& range : ranges)
+            {
+                msg("\t0x%" PRIX64 " (0x%" PRIX64 "): <unreadable>\n", range.address, range.size);
+            }
+        }
+
+        // Patches are collected in the chooser, only a summary of every module is printed
+        class patch_reporter : public scan_reporter
+        {
+          public:
+            size_t report_module(scan_profiler& /*profiler*/, const module_info& module, module_result& result) override
+            {
+                const auto& patches = result.result.patches;
+                const auto& pointer_patches = result.result.pointer_patches;
+                const auto& unreadable_ranges = result.result.unreadable_ranges;
+
+                if (!result.error.empty())
+                {
+                    msg("%s: %s\n", module.path.c_str(), result.error.c_str());
+                }
+
+                if (patches.empty() && pointer_patches.empty() && unreadable_ranges.empty())
+                {
+                    return 0;
+                }
+
+                msg("%s: %zu patches\n", module.path.c_str(), patches.size() + pointer_patches.size());
+                log_unreadable_ranges(unreadable_ranges);
+
+                if (!patches.empty() || !pointer_patches.empty())
+                {
+                    auto& table = get_patch_table();
+                    const auto module_index = table.add_module(module.path);
+
+                    table.add_patches(module_index, patches);
+                    table.add_pointer_patches(module_index, pointer_patches);
+                    refresh_patch_chooser();
+                }
+
+                return patches.size() + pointer_patches.size();
+            }
+
+            void report_total(const size_t total_patches) override
+            {
+                msg("Total patches found: %zu\n", total_patches);
+
+                if (total_patches > 0)
+                {
+                    show_patch_chooser();
+                }
+            }
+        };
+
+        double to_seconds(const std::chrono::nanoseconds duration)
+        {
+            return std::chrono::duration<double>(duration).count();
+        }
+
+        double to_mebibytes(const uint64_t bytes)
+        {
+            return static_cast<double>(bytes) / (1024.0 * 1024.0);
+        }
+
+        void open_capture(std::optional<session_writer>& capture, const scan_options& options)
+        {
+            if (options.capture_file.empty())
+            {
+                return;
+            }
+
+            capture.emplace(options.capture_file, options.compress_capture);
+
+            if (!capture->is_open())
+            {
+                msg("Failed to create capture %s\n", options.capture_file.c_str());
+                capture.reset();
+            }
+        }
+
+        // Modules are recorded with the identity of their image, so that later scans can verify the files on disk
+        void finish_capture(session_writer& capture, const std::vector<module_info>& modules, const std::string& path)
+        {
+            for (const auto& module : modules)
+            {
+                captured_module entry{
+                    .module = module,
+                    .file = get_file_identity(module.path),
+                };
+
+                const auto image = get_image_cache().get_image(module.path);
+                if (image)
+                {
+                    entry.module.identity = image->image.identity;
+                }
+
+                capture.add_module(entry);
+            }
+
+            const auto size = capture.finish();
+            if (size)
+            {
+                msg("Capture written to %s (%" PRIu64 " bytes)\n", path.c_str(), size);
+            }
+            else
+            {
+                msg("Failed to write capture %s\n", path.c_str());
+            }
+        }
+
+        // Phase times are summed over all threads, so they can exceed the wall time
+        void log_scan_statistics(const scan_profiler& profiler, const std::vector<module_result>& results)
+        {
+            constexpr size_t slowest_module_count = 5;
+
+            scan_statistics total{};
+            std::vector<const module_profile*> profiles{};
+            profiles.reserve(results.size());
+
+            for (const auto& result : results)
+            {
+                total.merge(result.profile.statistics);
+                profiles.push_back(&result.profile);
+            }
+
+            const auto wall_time = to_seconds(profiler.get_elapsed_time());
+
+            msg("\nScan statistics:\n");
+            msg("\tWall time: %.3f s\n", wall_time);
+
+            for (size_t i = 0; i < scan_phase_count; ++i)
+            {
+                const auto phase = static_cast<scan_phase>(i);
+                msg("\t%-12s %.3f s\n", std::string(get_phase_name(phase)).c_str(), to_seconds(total.get_time(phase)));
+            }
+
+            const auto read_time = to_seconds(total.get_time(scan_phase::read_memory));
+            const auto diff_time = to_seconds(total.get_time(scan_phase::diff));
+
+            msg("\tBytes read: %.2f MiB (%.1f MiB/s)\n", to_mebibytes(total.bytes_read),
+                read_time > 0 ? to_mebibytes(total.bytes_read) / read_time : 0.0);
+            msg("\tBytes compared: %.2f MiB (%.1f MiB/s)\n", to_mebibytes(total.bytes_compared),
+                diff_time > 0 ? to_mebibytes(total.bytes_compared) / diff_time : 0.0);
+            msg("\tRelocated slots: %" PRIu64 "\n", total.relocated_slots);
+            msg("\tPeak buffer memory: %.2f MiB\n", to_mebibytes(profiler.get_peak_buffer_size()));
+
+            msg("\tSlowest modules:\n");
+
+            const auto count = std::min(slowest_module_count, profiles.size());
+            std::ranges::partial_sort(profiles, profiles.begin() + static_cast<ptrdiff_t>(count), std::greater{},
+                                      [](const module_profile* profile) { return profile->statistics.get_total_time(); });
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto& profile = *profiles[i];
+                msg("\t\t%.3f s: %s\n", to_seconds(profile.statistics.get_total_time()), profile.name.c_str());
+            }
+        }
+
+        struct scan_progress
+        {
+            size_t finished_modules{};
+            size_t total_modules{};
+            uint64_t compared_bytes{};
+            size_t found_patches{};
+        };
+
+        /*****************************************************************************
+         * Modules are scanned on a thread pool. Workers marshal every memory read
+         * through the main thread queue, which the owner has to pump. Results are
+         * reported in module order as soon as they become available.
+         * Statistics, captures and traces are only written for full scans.
+         ****************************************************************************/
+
+        class module_scan
+        {
+          public:
+            module_scan(const scan_options& options, std::vector<module_info> modules, scan_reporter& reporter, const bool is_full_scan)
+                : options_(options),
+                  modules_(std::move(modules)),
+                  reporter_(reporter),
+                  is_full_scan_(is_full_scan),
+                  results_(this->modules_.size()),
+                  profiler_(is_full_scan && !options.trace_file.empty()),
+                  allowlist_(get_patch_allowlist(options)),
+                  pool_(get_thread_pool())
+            {
+                get_image_cache().set_cache_directory(get_cache_directory(this->options_));
+
+                if (this->is_full_scan_)
+                {
+                    open_capture(this->capture_, this->options_);
+                }
+
+                if (this->capture_)
+                {
+                    this->capturing_memory_.emplace(this->debugger_memory_, *this->capture_);
+                }
+
+                memory_source& memory =
+                    this->capturing_memory_ ? static_cast<memory_source&>(*this->capturing_memory_) : this->debugger_memory_;
+                this->context_.emplace(this->options_, memory, this->pool_, this->cancelled_, this->profiler_, this->options_.incremental,
+                                       this->allowlist_.get());
+
+                for (size_t i = 0; i < this->modules_.size(); ++i)
+                {
+                    this->results_[i].profile.name = this->modules_[i].path;
+                    this->results_[i].baseline = this->reporter_.get_baseline(this->modules_[i]);
+                }
+
+                for (const auto index : get_scan_order(this->modules_))
+                {
+                    this->pool_.schedule([this, index] { this->scan_module(index); });
+                }
+            }
+
+            // Workers block on reads that only the main thread executes, so they are drained here.
+            // Workers signal completion under the result lock, so none of them touches the scan after this.
+            ~module_scan()
+            {
+                this->cancel();
+
+                while (this->get_progress().finished_modules < this->modules_.size())
+                {
+                    this->main_thread_.run(std::chrono::milliseconds(10));
+                }
+            }
+
+            module_scan(module_scan&&) = delete;
+            module_scan(const module_scan&) = delete;
+            module_scan& operator=(module_scan&&) = delete;
+            module_scan& operator=(const module_scan&) = delete;
+
+            // Executes pending reads and reports finished modules, returns true once all modules are done
+            bool pump(const std::chrono::milliseconds timeout)
+            {
+                this->main_thread_.run(timeout);
+
+                std::unique_lock lock{this->result_mutex_};
+
+                while (this->next_module_ < this->results_.size() && this->results_[this->next_module_].finished)
+                {
+                    auto& result = this->results_[this->next_module_];
+
+                    lock.unlock();
+                    this->total_patches_ += this->reporter_.report_module(this->profiler_, this->modules_[this->next_module_], result);
+                    lock.lock();
+
+                    // Only the profile is kept for the statistics
+                    result.result = {};
+                    result.baseline.reset();
+
+                    ++this->next_module_;
+                }
+
+                return this->next_module_ == this->results_.size();
+            }
+
+            void cancel()
+            {
+                this->cancelled_ = true;
+            }
+
+            bool is_cancelled() const
+            {
+                return this->cancelled_;
+            }
+
+            scan_progress get_progress()
+            {
+                std::scoped_lock lock{this->result_mutex_};
+
+                return {
+                    .finished_modules = this->finished_modules_,
+                    .total_modules = this->modules_.size(),
+                    .compared_bytes = this->profiler_.get_compared_bytes(),
+                    .found_patches = this->found_patches_,
+                };
+            }
+
+            // Reports the total once all modules are done, followed by statistics, capture and trace of full scans
+            void finish()
+            {
+                this->reporter_.report_total(this->total_patches_);
+
+                if (!this->is_full_scan_)
+                {
+                    return;
+                }
+
+                log_scan_statistics(this->profiler_, this->results_);
+
+                if (this->capture_)
+                {
+                    finish_capture(*this->capture_, this->modules_, this->options_.capture_file);
+                }
+
+                if (!this->options_.trace_file.empty())
+                {
+                    if (this->profiler_.write_trace(this->options_.trace_file))
+                    {
+                        msg("Trace written to %s\n", this->options_.trace_file.c_str());
+                    }
+                    else
+                    {
+                        msg("Failed to write trace to %s\n", this->options_.trace_file.c_str());
+                    }
+                }
+            }
+
+          private:
+            scan_options options_{};
+            std::vector<module_info> modules_{};
+            scan_reporter& reporter_;
+            bool is_full_scan_{false};
+
+            std::atomic_bool cancelled_{false};
+            utils::task_queue main_thread_{};
+
+            std::mutex result_mutex_{};
+            std::vector<module_result> results_{};
+            size_t finished_modules_{0};
+            size_t found_patches_{0};
+
+            size_t next_module_{0};
+            size_t total_patches_{0};
+
+            scan_profiler profiler_;
+            std::shared_ptr<const patch_allowlist> allowlist_{};
+            std::optional<session_writer> capture_{};
+            debugger_memory_source debugger_memory_{this->main_thread_};
+            std::optional<capturing_memory_source> capturing_memory_{};
+            utils::thread_pool& pool_;
+            std::optional<module_scan_context> context_{};
+
+            void scan_module(const size_t index)
+            {
+                module_scan_result result{};
+                std::string error{};
+                bool complete = false;
+
+                auto context = *this->context_;
+                const auto& baseline = this->results_[index].baseline;
+                context.baseline = baseline ? &*baseline : nullptr;
+
+                try
+                {
+                    result = scan_module_file(context, get_image_cache(), this->modules_[index], this->results_[index].profile);
+                    complete = !this->cancelled_;
+                }
+                catch (const std::exception& e)
+                {
+                    error = e.what();
+                }
+                catch (...)
+                {
+                    // Just ignore all issues
+                }
+
+                {
+                    std::scoped_lock lock{this->result_mutex_};
+                    this->found_patches_ += result.patches.size();
+
+                    auto& entry = this->results_[index];
+                    entry.finished = true;
+                    entry.complete = complete;
+                    entry.result = std::move(result);
+                    entry.error = std::move(error);
+
+                    ++this->finished_modules_;
+
+                    this->main_thread_.notify();
+                }
+            }
+        };
+
+        void log_progress(const scan_progress& progress)
+        {
+            msg("Scanning modules (%zu/%zu), %.1f MiB compared, %zu patches found\n", progress.finished_modules, progress.total_modules,
+                to_mebibytes(progress.compared_bytes), progress.found_patches);
+        }
+
+        // The wait box must already be shown and is hidden once all modules are done
+        void scan_modules(const scan_options& options, std::vector<module_info> modules, scan_reporter& reporter, const bool is_full_scan)
+        {
+            module_scan scan{options, std::move(modules), reporter, is_full_scan};
+
+            while (!scan.pump(std::chrono::milliseconds(100)))
+            {
+                const auto progress = scan.get_progress();
+                replace_wait_box("Scanning modules (%zu/%zu), %.1f MiB compared, %zu patches found...", progress.finished_modules,
+                                 progress.total_modules, to_mebibytes(progress.compared_bytes), progress.found_patches);
+
+                if (!scan.is_cancelled() && user_cancelled())
+                {
+                    msg("Operation cancelled by user\n");
+                    scan.cancel();
+                }
+            }
+
+            hide_wait_box();
+            scan.finish();
+        }
+
+        // Only reads two tables per module, so this runs on the main thread
+        void check_table_hooks(const scan_options& options)
+        {
+            show_wait_box("NODELAY\nChecking import and export address tables...");
+
+            auto& cache = get_image_cache();
+            cache.set_cache_directory(get_cache_directory(options));
+
+            const auto modules = debugger_module_enumerator{get_module_store(options)}.get_modules();
+            set_symbol_modules(modules, cache);
+
+            direct_memory_source memory{};
+            const auto result = find_table_hooks(memory, cache, modules);
+
+            hide_wait_box();
+
+            for (const auto& hook : result.hooks)
+            {
+                const auto name = std::filesystem::path(modules[hook.module_index].path).filename().string();
+                msg("%s 0x%" PRIX64 " (%s): %s -> 0x%" PRIX64 " (%s)%s\n", get_table_name(hook.table), hook.slot_address, name.c_str(),
+                    hook.name.c_str(), hook.target, get_symbol(hook.target).c_str(), hook.unverifiable ? " <unverifiable>" : "");
+            }
+
+            log_unreadable_ranges(result.unreadable_ranges);
+            msg("Address table hooks found: %zu\n", result.hooks.size());
+        }
+
+        /*****************************************************************************
+         * Runs a full scan without blocking IDA. The main thread queue is pumped
+         * from a UI timer instead of a modal wait box, so reads and symbolization
+         * still run on the main thread while the user keeps working. Modules are
+         * printed as soon as they are done and progress is logged periodically.
+         ****************************************************************************/
+
+        class background_scan
+        {
+          public:
+            background_scan() = default;
+
+            ~background_scan()
+            {
+                this->stop();
+            }
+
+            background_scan(background_scan&&) = delete;
+            background_scan(const background_scan&) = delete;
+            background_scan& operator=(background_scan&&) = delete;
+            background_scan& operator=(const background_scan&) = delete;
+
+            bool is_running() const
+            {
+                return this->scan_ != nullptr;
+            }
+
+            void start(const scan_options& options, std::vector<module_info> modules)
+            {
+                this->stop();
+
+                clear_patch_chooser();
+                show_patch_chooser();
+
+                this->scan_ = std::make_unique<module_scan>(options, std::move(modules), this->reporter_, true);
+                this->last_progress_ = std::chrono::steady_clock::now();
+                this->timer_ = register_timer(timer_interval, on_timer, this);
+
+                msg("Scanning in the background, run the plugin again to cancel\n");
+            }
+
+            void cancel()
+            {
+                if (this->scan_ && !this->scan_->is_cancelled())
+                {
+                    msg("Cancelling background scan...\n");
+                    this->scan_->cancel();
+                }
+            }
+
+            scan_progress get_progress() const
+            {
+                return this->scan_ ? this->scan_->get_progress() : scan_progress{};
+            }
+
+            // Drops the scan without reporting what is still pending
+            void stop()
+            {
+                if (this->timer_)
+                {
+                    unregister_timer(this->timer_);
+                    this->timer_ = nullptr;
+                }
+
+                this->scan_.reset();
+            }
+
+          private:
+            static constexpr int timer_interval = 10;
+            static constexpr std::chrono::seconds progress_interval{2};
+
+            patch_reporter reporter_{};
+            std::unique_ptr<module_scan> scan_{};
+            qtimer_t timer_{};
+            std::chrono::steady_clock::time_point last_progress_{};
+
+            static int idaapi on_timer(void* user_data)
+            {
+                auto& self = *static_cast<background_scan*>(user_data);
+
+                if (!self.scan_->pump({}))
+                {
+                    const auto now = std::chrono::steady_clock::now();
+                    if (now - self.last_progress_ >= progress_interval)
+                    {
+                        self.last_progress_ = now;
+                        log_progress(self.scan_->get_progress());
+                    }
+
+                    return timer_interval;
+                }
+
+                self.scan_->finish();
+                self.scan_.reset();
+                self.timer_ = nullptr;
+
+                return -1;
+            }
+        };
+
+        background_scan& get_background_scan()
+        {
+            static background_scan scan{};
+            return scan;
+        }
+
+        // The chooser follows the scan history, only a summary of what changed is printed
+        size_t report_module_changes(const module_info& module, const module_changes& changes, const module_scan_result& result)
+        {
+            // Unreadable ranges are only listed the first time, pages that became unreadable show up as changed
+            const auto has_unreadable_ranges = changes.is_new && !result.unreadable_ranges.empty();
+            if (changes.empty() && !has_unreadable_ranges)
+            {
+                return 0;
+            }
+
+            auto& table = get_patch_table();
+
+            // Patches of an earlier instance of the module are in the history no longer
+            if (changes.is_new)
+            {
+                table.remove_module(module.path);
+            }
+
+            const auto module_index = table.add_module(module.path);
+            table.remove_patches(module_index, changes.removed_patches);
+            table.add_patches(module_index, changes.added_patches);
+            refresh_patch_chooser();
+
+            msg("%s: %zu patches added, %zu removed\n", module.path.c_str(), changes.added_patches.size(), changes.removed_patches.size());
+
+            for (const auto& range : changes.changed_pages)
+            {
+                msg("\t* 0x%" PRIX64 " (0x%" PRIX64 "): <changed>\n", range.address, range.size);
+            }
+
+            if (changes.is_new)
+            {
+                log_unreadable_ranges(result.unreadable_ranges);
+            }
+
+            return changes.added_patches.size() + changes.removed_patches.size();
+        }
+
+        /*****************************************************************************
+         * Keeps the results of earlier scans for as long as the process lives.
+         * Modules are scanned as soon as the debugger reports them as loaded and
+         * all modules are rescanned once the process stays suspended for a
+         * moment. Modules whose pages all hash the same as at their last scan
+         * are not compared again. Only patches that appeared or disappeared and
+         * pages whose content changed since the last scan are reported.
+         ****************************************************************************/
+
+        class incremental_scanner : public scan_reporter
+        {
+          public:
+            incremental_scanner() = default;
+
+            ~incremental_scanner() override
+            {
+                this->stop();
+            }
+
+            incremental_scanner(incremental_scanner&&) = delete;
+            incremental_scanner(const incremental_scanner&) = delete;
+            incremental_scanner& operator=(incremental_scanner&&) = delete;
+            incremental_scanner& operator=(const incremental_scanner&) = delete;
+
+            void start(const scan_options& options)
+            {
+                this->options_ = options;
+
+                if (!this->hooked_)
+                {
+                    // The chooser lists what the history knows about, which starts out empty
+                    clear_patch_chooser();
+                    this->hooked_ = hook_to_notification_point(HT_DBG, on_debugger_event, this);
+                }
+            }
+
+            void stop()
+            {
+                if (this->hooked_)
+                {
+                    unhook_from_notification_point(HT_DBG, on_debugger_event, this);
+                    this->hooked_ = false;
+                }
+
+                if (this->timer_)
+                {
+                    unregister_timer(this->timer_);
+                    this->timer_ = nullptr;
+                }
+
+                this->forget_process();
+            }
+
+            void rescan()
+            {
+                show_wait_box("NODELAY\nFinding modules...");
+
+                const auto modules = debugger_module_enumerator{get_module_store(this->options_)}.get_modules();
+                this->forget_modules(this->history_.remove_missing(modules));
+                set_symbol_modules(modules, get_image_cache());
+
+                this->scan(modules, true);
+                this->scan_pending_modules();
+            }
+
+            size_t report_module(scan_profiler& /*profiler*/, const module_info& module, module_result& result) override
+            {
+                // Cancelled or failed scans would look like all patches disappeared
+                if (!result.complete)
+                {
+                    return 0;
+                }
+
+                const auto changes = this->history_.update(module, result.result);
+                return report_module_changes(module, changes, result.result);
+            }
+
+            void report_total(const size_t total_patches) override
+            {
+                msg("Patches added or removed: %zu\n", total_patches);
+
+                if (total_patches > 0)
+                {
+                    show_patch_chooser();
+                }
+            }
+
+            std::optional<module_baseline> get_baseline(const module_info& module) override
+            {
+                return this->history_.get_baseline(module);
+            }
+
+          private:
+            static constexpr int timer_interval = 100;
+
+            // Suspends that follow each other quickly, like single steps, only lead to one rescan
+            static constexpr std::chrono::milliseconds rescan_delay{1000};
+
+            scan_options options_{};
+            scan_history history_{};
+            bool hooked_{false};
+            bool scanning_{false};
+
+            // Modules that were loaded while a scan was running
+            std::vector<module_info> pending_modules_{};
+
+            qtimer_t timer_{};
+            std::chrono::steady_clock::time_point rescan_time_{};
+
+            void schedule_rescan()
+            {
+                this->rescan_time_ = std::chrono::steady_clock::now() + rescan_delay;
+
+                if (!this->timer_)
+                {
+                    this->timer_ = register_timer(timer_interval, on_timer, this);
+                }
+            }
+
+            // A process that was resumed in the meantime is rescanned on its next suspend
+            static int idaapi on_timer(void* user_data)
+            {
+                auto& self = *static_cast<incremental_scanner*>(user_data);
+
+                if (get_process_state() == DSTATE_SUSP && (self.scanning_ || std::chrono::steady_clock::now() < self.rescan_time_))
+                {
+                    return timer_interval;
+                }
+
+                self.timer_ = nullptr;
+
+                if (get_process_state() == DSTATE_SUSP)
+                {
+                    self.rescan();
+                }
+
+                return -1;
+            }
+
+            void scan(const std::vector<module_info>& modules, const bool is_full_scan)
+            {
+                // The wait box processes UI events, which can deliver further debugger events
+                if (this->scanning_)
+                {
+                    hide_wait_box();
+                    return;
+                }
+
+                this->scanning_ = true;
+                scan_modules(this->options_, modules, *this, is_full_scan);
+                this->scanning_ = false;
+            }
+
+            void scan_loaded_module(const modinfo_t& modinfo)
+            {
+                this->pending_modules_.push_back(get_module_info(modinfo, get_module_store(this->options_)));
+
+                // The module is picked up once the running scan is done
+                if (!this->scanning_)
+                {
+                    this->scan_pending_modules();
+                }
+            }
+
+            void scan_pending_modules()
+            {
+                while (!this->pending_modules_.empty())
+                {
+                    const auto modules = std::move(this->pending_modules_);
+                    this->pending_modules_.clear();
+
+                    // The symbolizer only resolves addresses within modules it knows about
+                    set_symbol_modules(debugger_module_enumerator{get_module_store(this->options_)}.get_modules(), get_image_cache());
+
+                    show_wait_box("NODELAY\nScanning %s...", modules.size() == 1 ? modules.front().path.c_str() : "loaded modules");
+                    this->scan(modules, false);
+                }
+            }
+
+            void forget_unloaded_module(const std::string& path)
+            {
+                std::erase_if(this->pending_modules_, [&](const module_info& module) { return module.path == path; });
+                this->forget_modules(this->history_.remove(path));
+            }
+
+            void forget_process()
+            {
+                this->history_.clear();
+                this->pending_modules_.clear();
+            }
+
+            void forget_modules(const std::vector<removed_module>& modules)
+            {
+                for (const auto& module : modules)
+                {
+                    msg("%s unloaded, %zu patches removed\n", module.module.path.c_str(), module.patches.size());
+                    get_patch_table().remove_module(module.module.path);
+                }
+
+                if (!modules.empty())
+                {
+                    refresh_patch_chooser();
+                }
+            }
+
+            static ssize_t idaapi on_debugger_event(void* user_data, const int notification_code, va_list va)
+            {
+                auto& scanner = *static_cast<incremental_scanner*>(user_data);
+
+                switch (notification_code)
+                {
+                case dbg_process_start:
+                case dbg_process_attach:
+                    scanner.forget_process();
+                    clear_patch_chooser();
+                    break;
+
+                case dbg_process_exit:
+                case dbg_process_detach:
+                    scanner.forget_process();
+                    break;
+
+                case dbg_library_load:
+                    scanner.scan_loaded_module(va_arg(va, const debug_event_t*)->modinfo());
+                    break;
+
+                case dbg_library_unload:
+                    scanner.forget_unloaded_module(va_arg(va, const debug_event_t*)->info().c_str());
+                    break;
+
+                case dbg_suspend_process:
+                    scanner.schedule_rescan();
+                    break;
+
+                default:
+                    break;
+                }
+
+                return 0;
+            }
+        };
+
+        incremental_scanner& get_incremental_scanner()
+        {
+            static incremental_scanner scanner{};
+            return scanner;
+        }
+    }
+
+    void find_patches(const scan_options& options)
+    {
+        auto& background = get_background_scan();
+
+        if (background.is_running())
+        {
+            const auto progress = background.get_progress();
+            if (ask_yn(ASKBTN_NO, "HIDECANCEL\nA background scan is running (%zu/%zu modules). Cancel it?", progress.finished_modules,
+                       progress.total_modules) == ASKBTN_YES)
+            {
+                background.cancel();
+            }
+
+            return;
+        }
+
+        msg("Finding patches...\n");
+
+        if (!is_debugger_on())
+        {
+            msg("Debugger must be active to find patches!\n");
+            return;
+        }
+
+        if (options.table_hooks)
+        {
+            check_table_hooks(options);
+        }
+
+        if (options.incremental)
+        {
+            auto& scanner = get_incremental_scanner();
+            scanner.start(options);
+            scanner.rescan();
+            return;
+        }
+
+        if (options.background)
+        {
+            auto modules = debugger_module_enumerator{get_module_store(options)}.get_modules();
+            set_symbol_modules(modules, get_image_cache());
+
+            background.start(options, std::move(modules));
+            return;
+        }
+
+        show_wait_box("NODELAY\nFinding modules...");
+
+        auto modules = debugger_module_enumerator{get_module_store(options)}.get_modules();
+        set_symbol_modules(modules, get_image_cache());
+
+        clear_patch_chooser();
+
+        patch_reporter reporter{};
+        scan_modules(options, std::move(modules), reporter, true);
+    }
+
+    void stop_scanning()
+    {
+        get_background_scan().stop();
+        get_incremental_scanner().stop();
+
+        // No scan is left, so the workers are joined here rather than while the plugin is unloaded
+        get_thread_pool_instance().reset();
+    }
+}
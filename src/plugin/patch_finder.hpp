@@ -0,0 +1,11 @@
+#pragma once
+
+#include "scan_options.hpp"
+
+namespace momo
+{
+    void find_patches(const scan_options& options);
+
+    // Drops a running background scan, unhooks the debugger events that incremental scans listen to and stops the scan threads
+    void stop_scanning();
+}
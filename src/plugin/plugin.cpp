@@ -1,5 +1,6 @@
 #include "ida_sdk.hpp"
 #include "patch_finder.hpp"
+#include "patch_chooser.hpp"
 
 namespace momo
 {
@@ -9,18 +10,28 @@ namespace momo
         {
             constexpr const char* name = "Patch Finder";
 
+            // Kept loaded, as the results chooser and incremental scans outlive a run
             plugmod_t* idaapi initialize()
             {
-                return PLUGIN_OK;
+                return PLUGIN_KEEP;
             }
 
             void idaapi terminate()
             {
+                stop_scanning();
+                close_patch_chooser();
+            }
+
+            // Options can be passed on the command line: -Opatch_finder:key=value;key=value
+            scan_options get_scan_options()
+            {
+                const auto* options = get_plugin_options("patch_finder");
+                return parse_scan_options(options ? options : "");
             }
 
             bool idaapi run(size_t /*arg*/)
             {
-                find_patches();
+                find_patches(get_scan_options());
                 return true;
             }
 
@@ -28,7 +39,7 @@ namespace momo
             {
                 return {
                     .version = IDP_INTERFACE_VERSION,
-                    .flags = PLUGIN_UNL,
+                    .flags = 0,
                     .init = plugin::initialize,
                     .term = plugin::terminate,
                     .run = plugin::run,
@@ -0,0 +1,216 @@
+#include "symbolizer.hpp"
+
+#include <cstdio>
+#include <vector>
+#include <cinttypes>
+#include <algorithm>
+
+#include "symbol_index.hpp"
+
+#include "ida_sdk.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr int name_flags = GN_DEMANGLED | GN_VISIBLE | GN_SHORT | GN_LOCAL;
+
+        struct symbol_cache
+        {
+            symbol_index index{};
+            uint64_t module_layout{};
+
+            // Sorted by base address
+            std::vector<module_info> modules{};
+            image_cache* images{};
+        };
+
+        symbol_cache& get_symbol_cache()
+        {
+            static symbol_cache cache{};
+            return cache;
+        }
+
+        std::string get_name(const ea_t address)
+        {
+            qstring name{};
+            get_ea_name(&name, address, name_flags);
+            return name.c_str();
+        }
+
+        const module_info* find_module(const std::vector<module_info>& modules, const uint64_t address)
+        {
+            const auto next = std::ranges::upper_bound(modules, address, {}, &module_info::base_address);
+            if (next == modules.begin())
+            {
+                return nullptr;
+            }
+
+            const auto& module = *(next - 1);
+            return address - module.base_address < module.size ? &module : nullptr;
+        }
+
+        // The range ends where IDA knows the next function, so that analyzed code is still looked up in IDA
+        std::optional<symbol_entry> lookup_image_symbol(const uint64_t address)
+        {
+            const auto& cache = get_symbol_cache();
+
+            const auto* module = find_module(cache.modules, address);
+            if (!module || !cache.images)
+            {
+                return std::nullopt;
+            }
+
+            const auto image = cache.images->get_image(module->path);
+            const auto function = image ? image->functions.find(static_cast<uint32_t>(address - module->base_address)) : std::nullopt;
+
+            if (!function)
+            {
+                return std::nullopt;
+            }
+
+            symbol_entry entry{
+                .start = module->base_address + function->rva,
+                .end = module->base_address + std::min<uint64_t>(function->end_rva, module->size),
+                .base = module->base_address + function->rva,
+                .name = std::string(function->name),
+            };
+
+            const auto* next_function = get_next_func(static_cast<ea_t>(address));
+            if (next_function && next_function->start_ea < entry.end)
+            {
+                entry.end = next_function->start_ea;
+            }
+
+            if (entry.name.empty())
+            {
+                char name[32]{};
+                snprintf(name, sizeof(name), "sub_%" PRIX64, entry.start);
+                entry.name = name;
+            }
+
+            return entry;
+        }
+
+        // Code that doesn't belong to a function only gets a name if a label starts right at the address
+        symbol_entry lookup_symbol(const uint64_t address)
+        {
+            const auto ea = static_cast<ea_t>(address);
+
+            const auto* chunk = get_fchunk(ea);
+            const auto* function = get_func(ea);
+
+            if (!chunk || !function)
+            {
+                auto name = get_name(ea);
+
+                if (name.empty())
+                {
+                    auto image_symbol = lookup_image_symbol(address);
+                    if (image_symbol)
+                    {
+                        return std::move(*image_symbol);
+                    }
+                }
+
+                return {
+                    .start = address,
+                    .end = address + 1,
+                    .base = address,
+                    .name = std::move(name),
+                };
+            }
+
+            return {
+                .start = chunk->start_ea,
+                .end = chunk->end_ea,
+                .base = function->start_ea,
+                .name = get_name(function->start_ea),
+            };
+        }
+
+        uint64_t hash_module_layout(const std::span<const module_info> modules)
+        {
+            constexpr uint64_t prime = 0x100000001B3;
+            uint64_t hash = 0xCBF29CE484222325;
+
+            const auto add = [&](const uint64_t value) { hash = (hash ^ value) * prime; };
+
+            for (const auto& module : modules)
+            {
+                add(module.base_address);
+                add(module.size);
+
+                for (const auto c : module.path)
+                {
+                    add(static_cast<uint8_t>(c));
+                }
+            }
+
+            return hash;
+        }
+    }
+
+    void resolve_symbols(const std::span<const uint64_t> addresses)
+    {
+        auto& index = get_symbol_cache().index;
+
+        std::vector<uint64_t> missing{};
+        missing.reserve(addresses.size());
+
+        for (const auto address : addresses)
+        {
+            if (!index.find(address))
+            {
+                missing.push_back(address);
+            }
+        }
+
+        std::ranges::sort(missing);
+
+        std::vector<symbol_entry> entries{};
+
+        for (const auto address : missing)
+        {
+            // Sorted addresses that fall into the chunk that was just resolved are covered by it
+            if (!entries.empty() && address >= entries.back().start && address < entries.back().end)
+            {
+                continue;
+            }
+
+            entries.push_back(lookup_symbol(address));
+        }
+
+        index.add(entries);
+    }
+
+    std::string get_symbol(const uint64_t address)
+    {
+        const auto& index = get_symbol_cache().index;
+
+        auto location = index.find(address);
+        if (!location)
+        {
+            resolve_symbols({&address, 1});
+            location = index.find(address);
+        }
+
+        return location ? format_symbol(*location) : std::string{};
+    }
+
+    void set_symbol_modules(const std::span<const module_info> modules, image_cache& images)
+    {
+        auto& cache = get_symbol_cache();
+
+        cache.images = &images;
+        cache.modules.assign(modules.begin(), modules.end());
+        std::ranges::sort(cache.modules, {}, &module_info::base_address);
+
+        const auto layout = hash_module_layout(modules);
+        if (layout != cache.module_layout)
+        {
+            cache.index.clear();
+            cache.module_layout = layout;
+        }
+    }
+}
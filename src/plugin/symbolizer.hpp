@@ -0,0 +1,28 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <cstdint>
+
+#include "image_cache.hpp"
+#include "memory_source.hpp"
+
+namespace momo
+{
+    /*****************************************************************************
+     * Resolves addresses to function+offset. Addresses are sorted and every
+     * function chunk is looked up and demangled only once, the results are
+     * cached for the debugging session. The cache is dropped when the module
+     * layout changes, as addresses may then belong to different code.
+     * Addresses that IDA knows nothing about are attributed to the nearest
+     * export or unwind entry of the module image instead.
+     * Only to be used from the main thread.
+     ****************************************************************************/
+
+    void resolve_symbols(std::span<const uint64_t> addresses);
+
+    // Resolves the address on its own if it wasn't part of an earlier batch
+    std::string get_symbol(uint64_t address);
+
+    void set_symbol_modules(std::span<const module_info> modules, image_cache& images);
+}
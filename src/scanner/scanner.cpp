@@ -0,0 +1,533 @@
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <limits>
+#include <cstdlib>
+#include <optional>
+#include <cinttypes>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <string_view>
+
+#include "image_cache.hpp"
+#include "thread_pool.hpp"
+#include "scan_options.hpp"
+#include "symbol_index.hpp"
+#include "module_store.hpp"
+#include "table_hooks.hpp"
+#include "module_scanner.hpp"
+#include "patch_allowlist.hpp"
+#include "minidump.hpp"
+#include "memory_snapshot.hpp"
+#include "session_capture.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        struct scanner_options
+        {
+            scan_options scan{};
+            size_t jobs{utils::thread_pool::get_default_thread_count()};
+            std::vector<std::filesystem::path> image_directories{};
+            std::filesystem::path store_directory{};
+            std::vector<std::filesystem::path> store_sources{};
+            std::filesystem::path allowlist_output{};
+            std::vector<std::filesystem::path> snapshots{};
+        };
+
+        struct job_report
+        {
+            std::string text{};
+            size_t patches{};
+            size_t allowed_patches{};
+            std::vector<allowed_patch> found_patches{};
+            bool failed{false};
+        };
+
+        void print_usage()
+        {
+            puts("Usage: patch-finder-scanner [options] <snapshot>...\n"
+                 "  --jobs <count>      Number of snapshots that are scanned at the same time\n"
+                 "  --options <text>    Scan options in the form key=value;key=value\n"
+                 "  --images <dir>      Directory to look up module images by file name, if their\n"
+                 "                      recorded path doesn't exist. Can be passed multiple times.\n"
+                 "  --store <dir>       Module store to look up images by build. Takes precedence\n"
+                 "                      over the recorded path and --images.\n"
+                 "  --populate <dir>    Copies the images below the directory into the store before\n"
+                 "                      scanning. Can be passed multiple times.\n"
+                 "  --write-allowlist <file>\n"
+                 "                      Writes all reported patches into an allowlist, which can be\n"
+                 "                      passed back with allowlist=<file>. The binary format is used\n"
+                 "                      if the file name ends in .bin, the text format otherwise.\n"
+                 "\n"
+                 "A snapshot is a Windows minidump, a session captured by the plugin or a manifest:\n"
+                 "  memory <address> <file>         raw bytes starting at address\n"
+                 "  module <base> <size> <image>    loaded module and its file on disk\n"
+                 "\n"
+                 "Only function prologues are compared unless prologue_size=0 is set. Parsed images\n"
+                 "are only cached on disk if cache_directory is set.");
+        }
+
+        std::optional<scanner_options> parse_arguments(const int argc, char** argv)
+        {
+            scanner_options options{};
+
+            for (int i = 1; i < argc; ++i)
+            {
+                const std::string_view argument = argv[i];
+
+                if (argument == "--jobs" && i + 1 < argc)
+                {
+                    options.jobs = std::max<size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+                }
+                else if (argument == "--options" && i + 1 < argc)
+                {
+                    options.scan = parse_scan_options(argv[++i]);
+                }
+                else if (argument == "--images" && i + 1 < argc)
+                {
+                    options.image_directories.emplace_back(argv[++i]);
+                }
+                else if (argument == "--store" && i + 1 < argc)
+                {
+                    options.store_directory = argv[++i];
+                }
+                else if (argument == "--populate" && i + 1 < argc)
+                {
+                    options.store_sources.emplace_back(argv[++i]);
+                }
+                else if (argument == "--write-allowlist" && i + 1 < argc)
+                {
+                    options.allowlist_output = argv[++i];
+                }
+                else if (argument.starts_with("--"))
+                {
+                    return std::nullopt;
+                }
+                else
+                {
+                    options.snapshots.emplace_back(argument);
+                }
+            }
+
+            const auto populates_store = !options.store_directory.empty() && !options.store_sources.empty();
+            if (options.snapshots.empty() && !populates_store)
+            {
+                return std::nullopt;
+            }
+
+            return options;
+        }
+
+        template <typename... Args>
+        void append_format(std::string& text, const char* format, Args... args)
+        {
+            char buffer[1024]{};
+            snprintf(buffer, sizeof(buffer), format, args...);
+            text.append(buffer);
+        }
+
+        // Patches are attributed to the nearest export or unwind entry of the image, as there is no analysis
+        std::string get_patch_location(const module_info& module, const function_index* functions, const uint64_t address)
+        {
+            const auto name = std::filesystem::path(module.path).filename().string();
+            const auto rva = address - module.base_address;
+
+            char buffer[64]{};
+
+            const auto is_valid_rva = rva <= std::numeric_limits<uint32_t>::max();
+            const auto function = functions && is_valid_rva ? functions->find(static_cast<uint32_t>(rva)) : std::nullopt;
+
+            if (!function)
+            {
+                snprintf(buffer, sizeof(buffer), "+0x%" PRIX64, rva);
+                return name + buffer;
+            }
+
+            std::string function_name{function->name};
+
+            if (function_name.empty())
+            {
+                snprintf(buffer, sizeof(buffer), "sub_%" PRIX64, module.base_address + function->rva);
+                function_name = buffer;
+            }
+
+            return name + "!" + format_symbol({.name = function_name, .offset = rva - function->rva});
+        }
+
+        const module_info* find_module_at(const std::vector<module_info>& modules, const uint64_t address)
+        {
+            for (const auto& module : modules)
+            {
+                if (address >= module.base_address && address - module.base_address < module.size)
+                {
+                    return &module;
+                }
+            }
+
+            return nullptr;
+        }
+
+        std::string get_address_location(const std::vector<module_info>& modules, image_cache& cache, const uint64_t address)
+        {
+            const auto* module = find_module_at(modules, address);
+            if (!module)
+            {
+                return "<unknown>";
+            }
+
+            const auto image = cache.get_image(module->path);
+            return get_patch_location(*module, image ? &image->functions : nullptr, address);
+        }
+
+        void append_module_report(std::string& text, const std::vector<module_info>& modules, image_cache& cache, const module_info& module,
+                                  const function_index* functions, const module_scan_result& result)
+        {
+            if (result.patches.empty() && result.pointer_patches.empty() && result.unreadable_ranges.empty())
+            {
+                return;
+            }
+
+            append_format(text, "\n%s\n\n", module.path.c_str());
+
+            for (const auto& patch : result.patches)
+            {
+                append_format(text, "\t0x%" PRIX64 " (0x%" PRIX64 "): %s\n", patch.address, patch.length,
+                              get_patch_location(module, functions, patch.address).c_str());
+            }
+
+            // Slots lie in data, so they aren't attributed to the function before them
+            for (const auto& patch : result.pointer_patches)
+            {
+                append_format(text, "\t0x%" PRIX64 " (0x%" PRIX64 "): %s -> 0x%" PRIX64 " (%s), expected 0x%" PRIX64 "\n", patch.address,
+                              patch.size, get_patch_location(module, nullptr, patch.address).c_str(), patch.target,
+                              get_address_location(modules, cache, patch.target).c_str(), patch.expected);
+            }
+
+            for (const auto& range : result.unreadable_ranges)
+            {
+                append_format(text, "\t0x%" PRIX64 " (0x%" PRIX64 "): <unreadable>\n", range.address, range.size);
+            }
+
+            text.append("\n");
+        }
+
+        void append_table_hooks(std::string& text, const std::vector<module_info>& modules, image_cache& cache,
+                                const table_hook_result& result)
+        {
+            if (result.hooks.empty() && result.unreadable_ranges.empty())
+            {
+                return;
+            }
+
+            text.append("\nAddress table hooks\n\n");
+
+            for (const auto& hook : result.hooks)
+            {
+                const auto& module = modules[hook.module_index];
+                const auto name = std::filesystem::path(module.path).filename().string();
+
+                const auto target = get_address_location(modules, cache, hook.target);
+
+                append_format(text, "\t%s 0x%" PRIX64 " (%s): %s -> 0x%" PRIX64 " (%s)%s\n", get_table_name(hook.table),
+                              hook.slot_address, name.c_str(), hook.name.c_str(), hook.target, target.c_str(),
+                              hook.unverifiable ? " <unverifiable>" : "");
+            }
+
+            for (const auto& range : result.unreadable_ranges)
+            {
+                append_format(text, "\t0x%" PRIX64 " (0x%" PRIX64 "): <unreadable>\n", range.address, range.size);
+            }
+
+            text.append("\n");
+        }
+
+        // The scan result only records where patches are, so the patched bytes are read again
+        void collect_found_patches(memory_source& memory, const module_info& module, const image_identity& identity,
+                                   const module_scan_result& result, std::vector<allowed_patch>& entries)
+        {
+            std::vector<uint8_t> buffer{};
+
+            const auto add_patch = [&](const uint64_t address, const uint64_t length) {
+                buffer.resize(static_cast<size_t>(length));
+                if (memory.read_memory(address, buffer).get())
+                {
+                    entries.emplace_back(make_allowed_patch(identity, address - module.base_address, buffer));
+                }
+            };
+
+            for (const auto& patch : result.patches)
+            {
+                add_patch(patch.address, patch.length);
+            }
+
+            for (const auto& patch : result.pointer_patches)
+            {
+                add_patch(patch.address, patch.size);
+            }
+        }
+
+        // Snapshots that don't record the identity of their modules still contain their headers
+        void resolve_store_path(module_info& module, const module_store& store, memory_source& memory)
+        {
+            if (!module.identity)
+            {
+                const auto headers = read_module_headers(memory, module.base_address);
+                if (headers)
+                {
+                    module.identity = headers->identity;
+                }
+            }
+
+            store.resolve_module(module);
+        }
+
+        // Snapshots taken on other machines record paths that only exist there
+        void resolve_image_path(module_info& module, const std::vector<std::filesystem::path>& image_directories)
+        {
+            std::error_code ec{};
+            if (image_directories.empty() || std::filesystem::exists(module.path, ec))
+            {
+                return;
+            }
+
+            const auto separator = module.path.find_last_of("/\\");
+            const auto file_name = separator == std::string::npos ? module.path : module.path.substr(separator + 1);
+
+            for (const auto& directory : image_directories)
+            {
+                const auto path = directory / file_name;
+                if (std::filesystem::exists(path, ec))
+                {
+                    module.path = path.string();
+                    return;
+                }
+            }
+        }
+
+        template <typename Source>
+        std::unique_ptr<memory_source> open_source(const std::filesystem::path& path, std::vector<module_info>& modules)
+        {
+            auto source = std::make_unique<Source>(path);
+            modules = source->get_modules();
+
+            return source;
+        }
+
+        job_report scan_snapshot(const scanner_options& options, utils::thread_pool& pool, image_cache& cache, const module_store* store,
+                                 const patch_allowlist* allowlist, const std::filesystem::path& snapshot)
+        {
+            job_report report{};
+            append_format(report.text, "== %s ==\n", snapshot.string().c_str());
+
+            try
+            {
+                std::vector<module_info> modules{};
+                std::unique_ptr<memory_source> memory{};
+
+                if (minidump::is_minidump(snapshot))
+                {
+                    memory = open_source<minidump>(snapshot, modules);
+                }
+                else if (session_capture::is_session_capture(snapshot))
+                {
+                    memory = open_source<session_capture>(snapshot, modules);
+                }
+                else
+                {
+                    memory = open_source<memory_snapshot>(snapshot, modules);
+                }
+
+                const std::atomic_bool cancelled{false};
+                scan_profiler profiler{false};
+
+                const module_scan_context context{options.scan, *memory, pool, cancelled, profiler, false, allowlist};
+
+                for (auto& module : modules)
+                {
+                    if (store)
+                    {
+                        resolve_store_path(module, *store, *memory);
+                    }
+
+                    resolve_image_path(module, options.image_directories);
+
+                    module_profile profile{};
+                    module_scan_result result{};
+
+                    try
+                    {
+                        result = scan_module_file(context, cache, module, profile);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        append_format(report.text, "\n%s: %s\n", module.path.c_str(), e.what());
+                    }
+
+                    const auto image = cache.get_image(module.path);
+                    append_module_report(report.text, modules, cache, module, image ? &image->functions : nullptr, result);
+                    report.patches += result.patches.size() + result.pointer_patches.size();
+                    report.allowed_patches += result.allowed_patches;
+
+                    if (!options.allowlist_output.empty() && image)
+                    {
+                        collect_found_patches(*memory, module, image->image.identity, result, report.found_patches);
+                    }
+                }
+
+                if (options.scan.table_hooks)
+                {
+                    const auto hooks = find_table_hooks(*memory, cache, modules);
+                    append_table_hooks(report.text, modules, cache, hooks);
+                    report.patches += hooks.hooks.size();
+                }
+
+                append_format(report.text, "Total patches found: %zu", report.patches);
+
+                if (report.allowed_patches > 0)
+                {
+                    append_format(report.text, " (%zu allowed)", report.allowed_patches);
+                }
+
+                report.text.append("\n\n");
+            }
+            catch (const std::exception& e)
+            {
+                append_format(report.text, "Failed to scan snapshot: %s\n\n", e.what());
+                report.failed = true;
+            }
+
+            return report;
+        }
+
+        /*****************************************************************************
+         * Every snapshot is a job. Jobs run in parallel and share one image
+         * cache, as snapshots of the same system mostly contain the same
+         * modules. Reports are printed as soon as a job is finished.
+         ****************************************************************************/
+
+        bool run_scanner(const scanner_options& options)
+        {
+            image_cache cache{};
+            if (options.scan.use_disk_cache && !options.scan.cache_directory.empty())
+            {
+                cache.set_cache_directory(options.scan.cache_directory);
+            }
+
+            std::optional<module_store> store{};
+            if (!options.store_directory.empty())
+            {
+                store.emplace(options.store_directory);
+
+                try
+                {
+                    for (const auto& directory : options.store_sources)
+                    {
+                        const auto added = store->add_directory(directory);
+                        fprintf(stderr, "Added %zu images from %s to the module store\n", added, directory.string().c_str());
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    fprintf(stderr, "Failed to populate the module store: %s\n", e.what());
+                    return false;
+                }
+            }
+
+            if (options.snapshots.empty())
+            {
+                return true;
+            }
+
+            patch_allowlist allowlist{};
+            if (!options.scan.allowlist.empty())
+            {
+                try
+                {
+                    allowlist.load(options.scan.allowlist);
+                    fprintf(stderr, "Loaded %zu allowed patches from %s\n", allowlist.size(), options.scan.allowlist.c_str());
+                }
+                catch (const std::exception& e)
+                {
+                    fprintf(stderr, "Failed to load allowlist: %s\n", e.what());
+                    return false;
+                }
+            }
+
+            utils::thread_pool pool{};
+            std::mutex output_mutex{};
+            std::atomic_bool failed{false};
+
+            // Patches found in several snapshots are only written once
+            utils::hash_set<allowed_patch, allowed_patch_hash> known_patches{};
+            std::vector<allowed_patch> found_patches{};
+
+            const auto start = std::chrono::steady_clock::now();
+
+            {
+                utils::thread_pool jobs{options.jobs};
+
+                for (const auto& snapshot : options.snapshots)
+                {
+                    jobs.schedule([&] {
+                        const auto report = scan_snapshot(options, pool, cache, store ? &*store : nullptr, &allowlist, snapshot);
+
+                        std::scoped_lock lock{output_mutex};
+                        fputs(report.text.c_str(), stdout);
+                        fflush(stdout);
+
+                        for (const auto& entry : report.found_patches)
+                        {
+                            if (known_patches.insert(entry))
+                            {
+                                found_patches.push_back(entry);
+                            }
+                        }
+
+                        if (report.failed)
+                        {
+                            failed = true;
+                        }
+                    });
+                }
+            }
+
+            const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            fprintf(stderr, "Scanned %zu snapshots in %.3f s\n", options.snapshots.size(), seconds);
+
+            if (!options.allowlist_output.empty())
+            {
+                try
+                {
+                    write_patch_allowlist(options.allowlist_output, found_patches, options.allowlist_output.extension() == ".bin");
+                    fprintf(stderr, "Wrote %zu patches to %s\n", found_patches.size(), options.allowlist_output.string().c_str());
+                }
+                catch (const std::exception& e)
+                {
+                    fprintf(stderr, "%s\n", e.what());
+                    return false;
+                }
+            }
+
+            return !failed;
+        }
+    }
+}
+
+int main(const int argc, char** argv)
+{
+    const auto options = momo::parse_arguments(argc, argv);
+    if (!options)
+    {
+        momo::print_usage();
+        return 1;
+    }
+
+    return momo::run_scanner(*options) ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+#include "compression.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t iterations = 300;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            size_t failures{};
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        void fail(test_state& state, const char* name, const char* reason, const size_t size)
+        {
+            ++state.failures;
+            fprintf(stderr, "%s: %s (%zu bytes)\n", name, reason, size);
+        }
+
+        // A stream that is cut short may only be accepted if all that was cut off is the empty last sequence
+        void check_round_trip(test_state& state, const char* name, const std::vector<uint8_t>& input)
+        {
+            const auto compressed = utils::compress_block(input);
+
+            std::vector<uint8_t> output(input.size());
+            if (!utils::decompress_block(compressed, output) || output != input)
+            {
+                fail(state, name, "round trip failed", input.size());
+                return;
+            }
+
+            if (!compressed.empty())
+            {
+                const auto truncated_size = get_random(state, 0, compressed.size() - 1);
+                std::ranges::fill(output, 0);
+
+                if (utils::decompress_block(std::span(compressed).subspan(0, truncated_size), output) && output != input)
+                {
+                    fail(state, name, "truncated stream was accepted", input.size());
+                }
+            }
+
+            std::vector<uint8_t> larger_output(input.size() + 1);
+            if (utils::decompress_block(compressed, larger_output))
+            {
+                fail(state, name, "larger output was accepted", input.size());
+            }
+
+            if (!input.empty())
+            {
+                std::vector<uint8_t> smaller_output(input.size() - 1);
+                if (utils::decompress_block(compressed, smaller_output))
+                {
+                    fail(state, name, "smaller output was accepted", input.size());
+                }
+            }
+        }
+
+        std::vector<uint8_t> generate_random_data(test_state& state, const size_t size)
+        {
+            std::vector<uint8_t> data(size);
+            for (auto& value : data)
+            {
+                value = static_cast<uint8_t>(state.random());
+            }
+
+            return data;
+        }
+
+        // Padding, short repeated patterns and copies of earlier data, some of them further back than a match can reach
+        std::vector<uint8_t> generate_code_like_data(test_state& state)
+        {
+            std::vector<uint8_t> data{};
+            const auto size = get_random(state, 0, 0x30000);
+
+            while (data.size() < size)
+            {
+                const auto length = std::min(get_random(state, 1, get_random(state, 0, 3) == 0 ? 0x2000 : 64), size - data.size());
+
+                switch (get_random(state, 0, 3))
+                {
+                case 0:
+                    data.insert(data.end(), length, get_random(state, 0, 1) == 0 ? 0xCC : 0x00);
+                    break;
+
+                case 1: {
+                    const auto pattern = generate_random_data(state, get_random(state, 1, 8));
+                    for (size_t i = 0; i < length; ++i)
+                    {
+                        data.push_back(pattern[i % pattern.size()]);
+                    }
+                    break;
+                }
+
+                case 2:
+                    if (!data.empty())
+                    {
+                        const auto source = get_random(state, 0, data.size() - 1);
+                        for (size_t i = 0; i < length; ++i)
+                        {
+                            data.push_back(data[source + (i % (data.size() - source))]);
+                        }
+                        break;
+                    }
+
+                    [[fallthrough]];
+
+                default: {
+                    const auto literals = generate_random_data(state, length);
+                    data.insert(data.end(), literals.begin(), literals.end());
+                    break;
+                }
+                }
+            }
+
+            return data;
+        }
+
+        void test_fixed_inputs(test_state& state)
+        {
+            check_round_trip(state, "empty input", {});
+            check_round_trip(state, "single byte", {0x90});
+            check_round_trip(state, "incompressible input", generate_random_data(state, 0x10000));
+
+            // Longer than the token can hold and longer than the maximum match offset
+            check_round_trip(state, "long match", std::vector<uint8_t>(0x20000, 0xCC));
+
+            auto far_copy = generate_random_data(state, 0x100);
+            far_copy.resize(0x10100 + 0x100);
+            std::copy_n(far_copy.begin(), 0x100, far_copy.begin() + 0x10100);
+            check_round_trip(state, "match beyond the maximum offset", far_copy);
+
+            std::vector<uint8_t> output(0x100);
+            if (utils::decompress_block({}, output))
+            {
+                fail(state, "empty stream", "accepted for a non-empty output", output.size());
+            }
+        }
+
+        // Random streams must be rejected or decompressed without reading or writing out of bounds
+        void test_malformed_streams(test_state& state)
+        {
+            const auto stream = generate_random_data(state, get_random(state, 0, 64));
+            std::vector<uint8_t> output(get_random(state, 0, 0x400));
+
+            (void)utils::decompress_block(stream, output);
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+            test_fixed_inputs(state);
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                check_round_trip(state, "code like data", generate_code_like_data(state));
+                test_malformed_streams(state);
+            }
+
+            printf("compression: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
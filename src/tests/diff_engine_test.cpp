@@ -0,0 +1,486 @@
+#include <array>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <algorithm>
+#include <exception>
+
+#include "diff_engine.hpp"
+#include "thread_pool.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr uint64_t base_address = 0x7ff700001000;
+        constexpr size_t iterations = 300;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            const char* kernel{};
+            size_t failures{};
+        };
+
+        struct test_case
+        {
+            std::vector<uint8_t> clean{};
+            std::vector<uint8_t> runtime{};
+
+            // Sections start at an unaligned offset into the buffers, so the kernels see unaligned loads
+            size_t offset{};
+            size_t size{};
+
+            relocation_list relocations{};
+            int64_t delta{};
+
+            std::span<const uint8_t> get_clean_data() const
+            {
+                return std::span(this->clean).subspan(this->offset, this->size);
+            }
+
+            std::span<const uint8_t> get_runtime_data() const
+            {
+                return std::span(this->runtime).subspan(this->offset, this->size);
+            }
+
+            clean_section get_section() const
+            {
+                return clean_section{
+                    .rva = 0x1000,
+                    .data = this->get_clean_data(),
+                    .relocations = this->relocations,
+                };
+            }
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        template <typename T>
+        void add_to_value(uint8_t* data, const int64_t delta)
+        {
+            T value{};
+            memcpy(&value, data, sizeof(value));
+            value += static_cast<T>(delta);
+            memcpy(data, &value, sizeof(value));
+        }
+
+        void relocate(std::span<uint8_t> data, const uint32_t rva, const relocation_list& relocations, const int64_t delta)
+        {
+            for (const auto& relocation : relocations)
+            {
+                auto* slot = data.data() + (relocation.rva - rva);
+
+                if (relocation.size == sizeof(uint64_t))
+                {
+                    add_to_value<uint64_t>(slot, delta);
+                }
+                else
+                {
+                    add_to_value<uint32_t>(slot, delta);
+                }
+            }
+        }
+
+        // Runs start at random offsets, at block edges of the kernels or right next to them
+        size_t get_run_start(test_state& state, const size_t size)
+        {
+            if (get_random(state, 0, 1) == 0)
+            {
+                return get_random(state, 0, size - 1);
+            }
+
+            constexpr std::array<size_t, 4> block_sizes{8, 16, 32, 64};
+            const auto block_size = block_sizes[get_random(state, 0, block_sizes.size() - 1)];
+            const auto edge = get_random(state, 1, (size / block_size) + 1) * block_size;
+
+            // One byte before the edge, at the edge or one byte after it
+            return std::min(edge + get_random(state, 0, 2) - 1, size - 1);
+        }
+
+        test_case generate_test_case(test_state& state, const bool with_relocations)
+        {
+            test_case test{};
+            test.offset = get_random(state, 0, 63);
+            test.size = get_random(state, 1, 0x4000);
+
+            test.clean.resize(test.offset + test.size);
+            for (auto& value : test.clean)
+            {
+                value = static_cast<uint8_t>(state.random());
+            }
+
+            auto section_data = std::span(test.clean).subspan(test.offset);
+
+            if (with_relocations)
+            {
+                // Long stretches of slots next to each other, like vtables, and isolated slots in between
+                const auto slot_size = get_random(state, 0, 1) == 0 ? sizeof(uint32_t) : sizeof(uint64_t);
+                size_t position = get_random(state, 0, 16);
+
+                while (position + slot_size <= test.size)
+                {
+                    test.relocations.emplace_back(static_cast<uint32_t>(0x1000 + position), static_cast<uint8_t>(slot_size));
+                    position += slot_size + (get_random(state, 0, 3) == 0 ? get_random(state, 1, 100) : 0);
+                }
+
+                test.delta = get_random(state, 0, 7) == 0 ? 0 : static_cast<int64_t>(state.random());
+            }
+
+            test.runtime.assign(test.clean.begin(), test.clean.end());
+
+            auto runtime_data = std::span(test.runtime).subspan(test.offset);
+            relocate(runtime_data, 0x1000, test.relocations, test.delta);
+
+            const auto run_count = get_random(state, 0, 24);
+            for (size_t i = 0; i < run_count; ++i)
+            {
+                const auto start = get_run_start(state, test.size);
+                const auto length = std::min(get_random(state, 1, get_random(state, 0, 3) == 0 ? 300 : 12), test.size - start);
+
+                for (size_t j = start; j < start + length; ++j)
+                {
+                    runtime_data[j] = static_cast<uint8_t>(section_data[j] ^ get_random(state, 1, 255));
+                }
+            }
+
+            return test;
+        }
+
+        // Compares byte by byte what the runtime data should look like
+        std::optional<std::vector<patch>> get_reference_differences(const std::span<const uint8_t> expected,
+                                                                    const std::span<const uint8_t> runtime, const diff_range range,
+                                                                    const size_t max_differences)
+        {
+            std::vector<patch> patches{};
+            size_t differences = 0;
+
+            for (auto i = range.begin; i < range.end; ++i)
+            {
+                if (expected[i] == runtime[i])
+                {
+                    continue;
+                }
+
+                ++differences;
+
+                if (!patches.empty() && patches.back().address + patches.back().length == base_address + i)
+                {
+                    ++patches.back().length;
+                }
+                else
+                {
+                    patches.emplace_back(base_address + i, 1);
+                }
+            }
+
+            if (differences > max_differences)
+            {
+                return std::nullopt;
+            }
+
+            return patches;
+        }
+
+        size_t count_differences(const std::optional<std::vector<patch>>& patches)
+        {
+            size_t differences = 0;
+
+            for (const auto& entry : patches.value_or(std::vector<patch>{}))
+            {
+                differences += entry.length;
+            }
+
+            return differences;
+        }
+
+        // Unlimited, exactly the number of differing bytes, one less, or anything
+        size_t get_max_differences(test_state& state, const size_t differences)
+        {
+            switch (get_random(state, 0, 3))
+            {
+            case 0:
+                return std::numeric_limits<size_t>::max();
+            case 1:
+                return differences;
+            case 2:
+                return differences > 0 ? differences - 1 : 0;
+            default:
+                return get_random(state, 0, differences + 8);
+            }
+        }
+
+        void check(test_state& state, const char* name, const std::optional<std::vector<patch>>& actual,
+                   const std::optional<std::vector<patch>>& expected)
+        {
+            const auto matches = [&] {
+                if (!actual || !expected)
+                {
+                    return actual.has_value() == expected.has_value();
+                }
+
+                return std::ranges::equal(*actual, *expected, [](const patch& left, const patch& right) {
+                    return left.address == right.address && left.length == right.length;
+                });
+            };
+
+            if (matches())
+            {
+                return;
+            }
+
+            ++state.failures;
+            fprintf(stderr, "%s (%s): got %s with %zu bytes, expected %s with %zu bytes\n", name, state.kernel,
+                    actual ? "patches" : "no result", count_differences(actual), expected ? "patches" : "no result",
+                    count_differences(expected));
+        }
+
+        void test_plain_differences(test_state& state)
+        {
+            const auto test = generate_test_case(state, false);
+            const diff_range range{0, test.size};
+
+            const auto all = get_reference_differences(test.get_clean_data(), test.get_runtime_data(), range,
+                                                       std::numeric_limits<size_t>::max());
+            const auto max_differences = get_max_differences(state, count_differences(all));
+
+            check(state, "find_differences", find_differences(test.get_clean_data(), test.get_runtime_data(), base_address, max_differences),
+                  get_reference_differences(test.get_clean_data(), test.get_runtime_data(), range, max_differences));
+        }
+
+        void test_relocated_differences(test_state& state, utils::thread_pool& pool)
+        {
+            const auto test = generate_test_case(state, true);
+            const auto section = test.get_section();
+            const auto runtime = test.get_runtime_data();
+
+            std::vector<uint8_t> expected(section.data.begin(), section.data.end());
+            relocate(expected, section.rva, section.relocations, test.delta);
+
+            const auto all = get_reference_differences(expected, runtime, {0, test.size}, std::numeric_limits<size_t>::max());
+            const auto max_differences = get_max_differences(state, count_differences(all));
+
+            check(state, "find_differences (relocated)", find_differences(section, runtime, test.delta, base_address, max_differences),
+                  get_reference_differences(expected, runtime, {0, test.size}, max_differences));
+
+            auto begin = get_random(state, 0, test.size);
+            auto end = get_random(state, 0, test.size);
+            const auto range = align_to_relocations(section, {std::min(begin, end), std::max(begin, end)});
+
+            const auto range_all = get_reference_differences(expected, runtime, range, std::numeric_limits<size_t>::max());
+            const auto range_max_differences = get_max_differences(state, count_differences(range_all));
+            const auto range_expected = get_reference_differences(expected, runtime, range, range_max_differences);
+
+            check(state, "find_differences (range)",
+                  find_differences(section, runtime, test.delta, base_address, range, range_max_differences), range_expected);
+
+            const auto chunk_size = get_random(state, 0, 1) == 0 ? get_random(state, 1, 64) : get_random(state, 64, 0x2000);
+            check(state, "find_differences (pool)",
+                  find_differences(pool, section, runtime, test.delta, base_address, range, range_max_differences, chunk_size),
+                  range_expected);
+        }
+
+        struct pointer_test_case
+        {
+            relocation_list slots{};
+            std::vector<uint8_t> clean_values{};
+
+            // Starts at runtime_rva and covers all slots
+            std::vector<uint8_t> runtime{};
+        };
+
+        constexpr uint32_t runtime_rva = 0x2000;
+
+        template <typename T>
+        uint64_t load_value(const uint8_t* data)
+        {
+            T value{};
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        uint64_t load_slot_value(const uint8_t* data, const size_t size)
+        {
+            return size == sizeof(uint64_t) ? load_value<uint64_t>(data) : load_value<uint32_t>(data);
+        }
+
+        // Runs of slots of the same size with gaps of all sizes in between, some of them changed
+        pointer_test_case generate_pointer_test_case(test_state& state, const int64_t delta)
+        {
+            pointer_test_case test{};
+            size_t position = get_random(state, 0, 16);
+
+            const auto run_count = get_random(state, 1, 12);
+            for (size_t run = 0; run < run_count; ++run)
+            {
+                const auto slot_size = get_random(state, 0, 1) == 0 ? sizeof(uint32_t) : sizeof(uint64_t);
+                const auto slot_count = get_random(state, 1, 40);
+
+                for (size_t i = 0; i < slot_count; ++i)
+                {
+                    test.slots.emplace_back(static_cast<uint32_t>(runtime_rva + position), static_cast<uint8_t>(slot_size));
+                    position += slot_size;
+                }
+
+                position += get_random(state, 0, 3) == 0 ? get_random(state, 0x1000, 0x3000) : get_random(state, 1, 64);
+            }
+
+            test.runtime.resize(position);
+            for (auto& value : test.runtime)
+            {
+                value = static_cast<uint8_t>(state.random());
+            }
+
+            for (const auto& slot : test.slots)
+            {
+                auto* runtime = test.runtime.data() + (slot.rva - runtime_rva);
+                test.clean_values.insert(test.clean_values.end(), runtime, runtime + slot.size);
+
+                if (get_random(state, 0, 9) != 0)
+                {
+                    if (slot.size == sizeof(uint64_t))
+                    {
+                        add_to_value<uint64_t>(runtime, delta);
+                    }
+                    else
+                    {
+                        add_to_value<uint32_t>(runtime, delta);
+                    }
+                }
+            }
+
+            return test;
+        }
+
+        std::vector<pointer_patch> get_reference_pointer_differences(const pointer_test_case& test, const std::span<const uint8_t> runtime,
+                                                                     const uint32_t rva, const std::span<const uint8_t> clean_values,
+                                                                     const int64_t delta)
+        {
+            std::vector<pointer_patch> patches{};
+            size_t value_offset = 0;
+
+            for (const auto& slot : test.slots)
+            {
+                const auto offset = value_offset;
+                value_offset += slot.size;
+
+                if (slot.rva < rva || slot.rva + slot.size > rva + runtime.size() || offset + slot.size > clean_values.size())
+                {
+                    continue;
+                }
+
+                const auto mask = slot.size == sizeof(uint64_t) ? ~0ULL : 0xFFFFFFFFULL;
+                const auto target = load_slot_value(runtime.data() + (slot.rva - rva), slot.size);
+                const auto expected = (load_slot_value(clean_values.data() + offset, slot.size) + static_cast<uint64_t>(delta)) & mask;
+
+                if (target != expected)
+                {
+                    patches.emplace_back(base_address + slot.rva, slot.size, target, expected);
+                }
+            }
+
+            return patches;
+        }
+
+        void check_pointer_patches(test_state& state, const char* name, const std::vector<pointer_patch>& actual,
+                                   const std::vector<pointer_patch>& expected)
+        {
+            const auto matches = std::ranges::equal(actual, expected, [](const pointer_patch& left, const pointer_patch& right) {
+                return left.address == right.address && left.size == right.size && left.target == right.target &&
+                       left.expected == right.expected;
+            });
+
+            if (matches)
+            {
+                return;
+            }
+
+            ++state.failures;
+            fprintf(stderr, "%s (%s): got %zu pointer patches, expected %zu\n", name, state.kernel, actual.size(), expected.size());
+        }
+
+        // The runtime data and the clean values often only cover the slots in the middle
+        void test_pointer_differences(test_state& state)
+        {
+            const auto delta = get_random(state, 0, 7) == 0 ? 0 : static_cast<int64_t>(state.random());
+            const auto test = generate_pointer_test_case(state, delta);
+
+            auto begin = get_random(state, 0, 1) == 0 ? 0 : get_random(state, 0, test.runtime.size());
+            auto end = get_random(state, 0, 1) == 0 ? test.runtime.size() : get_random(state, begin, test.runtime.size());
+
+            const auto rva = static_cast<uint32_t>(runtime_rva + begin);
+            const auto runtime = std::span(test.runtime).subspan(begin, end - begin);
+
+            const auto value_count = get_random(state, 0, 1) == 0 ? test.clean_values.size() : get_random(state, 0, test.clean_values.size());
+            const auto clean_values = std::span(test.clean_values).subspan(0, value_count);
+
+            check_pointer_patches(state, "find_pointer_differences",
+                                  find_pointer_differences(test.slots, clean_values, runtime, rva, delta, base_address),
+                                  get_reference_pointer_differences(test, runtime, rva, clean_values, delta));
+        }
+
+        const char* get_kernel_name(const diff_kernel_type type)
+        {
+            switch (type)
+            {
+            case diff_kernel_type::avx2:
+                return "avx2";
+            case diff_kernel_type::sse2:
+                return "sse2";
+            default:
+                return "word";
+            }
+        }
+
+        size_t run_tests()
+        {
+            utils::thread_pool pool{4};
+            size_t failures = 0;
+
+            for (const auto type : {diff_kernel_type::word, diff_kernel_type::sse2, diff_kernel_type::avx2})
+            {
+                test_state state{};
+                state.kernel = get_kernel_name(type);
+
+                if (!is_diff_kernel_supported(type))
+                {
+                    printf("Skipping %s kernel, it isn't supported\n", state.kernel);
+                    continue;
+                }
+
+                set_diff_kernel(type);
+
+                for (size_t i = 0; i < iterations; ++i)
+                {
+                    test_plain_differences(state);
+                    test_relocated_differences(state, pool);
+                    test_pointer_differences(state);
+                }
+
+                printf("%s kernel: %zu failures\n", state.kernel, state.failures);
+                failures += state.failures;
+            }
+
+            return failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,294 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+
+#include "disk_cache.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t iterations = 30;
+
+        // Offsets into the entry, the header is followed by the path and the section table
+        constexpr size_t version_offset = 4;
+        constexpr size_t section_count_offset = 40;
+        constexpr size_t pointer_slot_count_offset = 52;
+        constexpr size_t header_size = 64;
+        constexpr size_t relocation_count_offset = 4;
+
+        const std::filesystem::path image_path{"C:\\Windows\\System32\\ntdll.dll"};
+        constexpr file_identity file{0x1F8000, 0x1DA0000000000};
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            std::filesystem::path directory{};
+            size_t failures{};
+        };
+
+        struct test_image
+        {
+            std::vector<std::vector<uint8_t>> section_data{};
+            clean_image image{};
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        void fail(test_state& state, const char* name, const char* reason)
+        {
+            ++state.failures;
+            fprintf(stderr, "%s: %s\n", name, reason);
+        }
+
+        test_image generate_image(test_state& state, const bool with_pointer_slots)
+        {
+            test_image test{};
+            test.image.image_base = 0x180000000;
+            test.image.identity = {0x12345678, 0x1F8000};
+
+            test.section_data.resize(get_random(state, 1, 4));
+            uint32_t rva = 0x1000;
+
+            for (auto& data : test.section_data)
+            {
+                data.resize(get_random(state, 1, 0x3000));
+                for (auto& value : data)
+                {
+                    value = static_cast<uint8_t>(state.random());
+                }
+
+                auto& section = test.image.sections.emplace_back();
+                section.rva = rva;
+                section.data = data;
+
+                for (size_t offset = get_random(state, 0, 16); offset + 8 <= data.size(); offset += get_random(state, 8, 64))
+                {
+                    section.relocations.emplace_back(static_cast<uint32_t>(rva + offset), static_cast<uint8_t>(8));
+                }
+
+                rva += static_cast<uint32_t>((data.size() + 0xFFF) & ~size_t{0xFFF});
+            }
+
+            if (with_pointer_slots)
+            {
+                auto& table = test.image.pointer_slots.emplace();
+                for (auto count = get_random(state, 0, 50); count > 0; --count)
+                {
+                    table.slots.emplace_back(rva, static_cast<uint8_t>(8));
+                    rva += 8;
+
+                    for (size_t i = 0; i < 8; ++i)
+                    {
+                        table.values.push_back(static_cast<uint8_t>(state.random()));
+                    }
+                }
+            }
+
+            return test;
+        }
+
+        bool has_same_relocations(const relocation_list& left, const relocation_list& right)
+        {
+            return std::ranges::equal(left, right, [](const relocation_entry& a, const relocation_entry& b) {
+                return a.rva == b.rva && a.size == b.size;
+            });
+        }
+
+        bool is_same_image(const clean_image& left, const clean_image& right)
+        {
+            const auto same_sections = std::ranges::equal(left.sections, right.sections, [](const clean_section& a, const clean_section& b) {
+                return a.rva == b.rva && std::ranges::equal(a.data, b.data) && has_same_relocations(a.relocations, b.relocations);
+            });
+
+            const auto same_slots = left.pointer_slots.has_value() == right.pointer_slots.has_value() &&
+                                    (!left.pointer_slots || (has_same_relocations(left.pointer_slots->slots, right.pointer_slots->slots) &&
+                                                             left.pointer_slots->values == right.pointer_slots->values));
+
+            return same_sections && same_slots && left.image_base == right.image_base && left.identity == right.identity;
+        }
+
+        std::vector<std::filesystem::path> get_entries(const test_state& state)
+        {
+            std::vector<std::filesystem::path> entries{};
+            for (const auto& entry : std::filesystem::directory_iterator(state.directory))
+            {
+                entries.push_back(entry.path());
+            }
+
+            return entries;
+        }
+
+        std::vector<char> read_file(const std::filesystem::path& path)
+        {
+            std::ifstream stream{path, std::ios::binary};
+            return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+        }
+
+        void write_file(const std::filesystem::path& path, const std::span<const char> data)
+        {
+            std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+            stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+
+        template <typename T>
+        void put(std::vector<char>& data, const size_t offset, const T value)
+        {
+            memcpy(data.data() + offset, &value, sizeof(value));
+        }
+
+        std::shared_ptr<loaded_image> load(const test_state& state, const clean_image& image, const bool with_pointer_slots = false)
+        {
+            return load_cached_image(state.directory, image_path, file, image.identity, with_pointer_slots);
+        }
+
+        // Entries are written under a temporary name and renamed, so only the entry itself is left behind
+        void test_round_trip(test_state& state)
+        {
+            std::filesystem::remove_all(state.directory);
+
+            const auto with_pointer_slots = get_random(state, 0, 1) == 0;
+            const auto test = generate_image(state, with_pointer_slots);
+
+            store_cached_image(state.directory, image_path, file, test.image);
+
+            const auto entries = get_entries(state);
+            if (entries.size() != 1 || entries.front().extension() != ".bin")
+            {
+                fail(state, "store", "directory doesn't hold exactly the entry");
+                return;
+            }
+
+            const auto loaded = load(state, test.image, with_pointer_slots);
+            if (!loaded || !is_same_image(loaded->image, test.image))
+            {
+                fail(state, "round trip", "image differs");
+            }
+
+            if (!with_pointer_slots && load(state, test.image, true))
+            {
+                fail(state, "pointer slots", "entry without slots was used for a pointer scan");
+            }
+
+            auto other_file = file;
+            other_file.last_write_time += 1;
+
+            auto other_identity = test.image.identity;
+            other_identity.size_of_image += 0x1000;
+
+            if (load_cached_image(state.directory, image_path, other_file, test.image.identity, false) ||
+                load_cached_image(state.directory, image_path, file, other_identity, false) ||
+                load_cached_image(state.directory, "C:\\Windows\\System32\\kernel32.dll", file, test.image.identity, false))
+            {
+                fail(state, "identity", "entry of another file was used");
+            }
+
+            // Storing again replaces the entry
+            const auto replacement = generate_image(state, true);
+            store_cached_image(state.directory, image_path, file, replacement.image);
+
+            const auto reloaded = load(state, replacement.image, true);
+            if (get_entries(state).size() != 1 || !reloaded || !is_same_image(reloaded->image, replacement.image))
+            {
+                fail(state, "replace", "entry was not replaced");
+            }
+        }
+
+        // Broken entries are a miss, no matter where they are cut or what their counts claim
+        void test_broken_entries(test_state& state)
+        {
+            std::filesystem::remove_all(state.directory);
+
+            const auto test = generate_image(state, true);
+            store_cached_image(state.directory, image_path, file, test.image);
+
+            const auto entry_path = get_entries(state).front();
+            const auto valid = read_file(entry_path);
+
+            const auto expect_miss = [&](const char* name, const std::vector<char>& data) {
+                write_file(entry_path, data);
+
+                try
+                {
+                    if (load(state, test.image, true))
+                    {
+                        fail(state, name, "entry was used");
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    fail(state, name, e.what());
+                }
+            };
+
+            for (size_t i = 0; i < 20; ++i)
+            {
+                const auto size = get_random(state, 1, valid.size() - 1);
+                expect_miss("truncated entry", std::vector<char>(valid.begin(), valid.begin() + static_cast<ptrdiff_t>(size)));
+            }
+
+            auto data = valid;
+            put(data, version_offset, uint32_t{2});
+            expect_miss("old version", data);
+
+            data = valid;
+            put(data, section_count_offset, uint32_t{0xFFFFFFFF});
+            expect_miss("section count", data);
+
+            data = valid;
+            put(data, pointer_slot_count_offset, uint32_t{0xFFFFFFFF});
+            expect_miss("pointer slot count", data);
+
+            const auto sections_offset = (header_size + image_path.string().size() + 7) & ~size_t{7};
+            data = valid;
+            put(data, sections_offset + relocation_count_offset, uint32_t{0xFFFFFFFF});
+            expect_miss("relocation count", data);
+
+            write_file(entry_path, valid);
+            if (!load(state, test.image, true))
+            {
+                fail(state, "restored entry", "entry was not used");
+            }
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+            state.directory = std::filesystem::temp_directory_path() / "patch-finder-disk-cache-test";
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                test_round_trip(state);
+                test_broken_entries(state);
+            }
+
+            std::error_code error{};
+            std::filesystem::remove_all(state.directory, error);
+
+            printf("disk cache: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
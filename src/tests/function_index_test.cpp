@@ -0,0 +1,128 @@
+#include <map>
+#include <limits>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <exception>
+
+#include "function_index.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t iterations = 300;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            size_t failures{};
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        void check(test_state& state, const uint32_t rva, const std::optional<function_symbol>& actual,
+                   const std::optional<function_symbol>& expected)
+        {
+            const auto matches = [&] {
+                if (!actual || !expected)
+                {
+                    return actual.has_value() == expected.has_value();
+                }
+
+                return actual->rva == expected->rva && actual->end_rva == expected->end_rva && actual->name == expected->name;
+            };
+
+            if (matches())
+            {
+                return;
+            }
+
+            ++state.failures;
+            fprintf(stderr, "find(0x%X): got %s at 0x%X, expected %s at 0x%X\n", rva, actual ? std::string(actual->name).c_str() : "nothing",
+                    actual ? actual->rva : 0, expected ? std::string(expected->name).c_str() : "nothing", expected ? expected->rva : 0);
+        }
+
+        // Starts come from exports and unwind data in any order and may repeat, named ones win
+        void test_lookups(test_state& state)
+        {
+            function_index index{};
+            std::map<uint32_t, std::string> reference{};
+
+            const auto range = static_cast<uint32_t>(get_random(state, 1, 0x10000));
+
+            for (auto count = get_random(state, 0, 300); count > 0; --count)
+            {
+                const auto rva = static_cast<uint32_t>(0x1000 + get_random(state, 0, range));
+                const auto name = get_random(state, 0, 2) == 0 ? std::string{} : "function_" + std::to_string(get_random(state, 0, 5));
+
+                index.add(rva, name);
+
+                auto& entry = reference[rva];
+                if (entry.empty())
+                {
+                    entry = name;
+                }
+            }
+
+            index.finalize();
+
+            if (index.size() != reference.size())
+            {
+                ++state.failures;
+                fprintf(stderr, "got %zu functions, expected %zu\n", index.size(), reference.size());
+                return;
+            }
+
+            for (size_t i = 0; i < 500; ++i)
+            {
+                const auto rva = static_cast<uint32_t>(get_random(state, 0, range + 0x2000));
+
+                std::optional<function_symbol> expected{};
+                auto next = reference.upper_bound(rva);
+
+                if (next != reference.begin())
+                {
+                    const auto& [start, name] = *std::prev(next);
+                    expected = function_symbol{
+                        .rva = start,
+                        .end_rva = next != reference.end() ? next->first : std::numeric_limits<uint32_t>::max(),
+                        .name = name,
+                    };
+                }
+
+                check(state, rva, index.find(rva), expected);
+            }
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                test_lookups(state);
+            }
+
+            printf("function index: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <exception>
+#include <unordered_set>
+
+#include "hash_set.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t iterations = 200;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            size_t failures{};
+        };
+
+        // Puts every key into a handful of buckets, so that probe sequences get long and wrap around the end of the table
+        struct colliding_hash
+        {
+            size_t operator()(const uint64_t value) const
+            {
+                return static_cast<size_t>((value % 4) * 0x9E3779B97F4A7C15);
+            }
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        // Keys are aligned and close to each other, like addresses
+        uint64_t get_key(test_state& state, const size_t range)
+        {
+            return 0x7ff800000000 + (get_random(state, 0, range) * 0x10);
+        }
+
+        template <typename Hash>
+        void test_against_reference(test_state& state, const char* name)
+        {
+            utils::hash_set<uint64_t, Hash> set{};
+            std::unordered_set<uint64_t> reference{};
+
+            const auto range = get_random(state, 1, 2000);
+
+            if (get_random(state, 0, 1) == 0)
+            {
+                set.reserve(get_random(state, 0, 1000));
+            }
+
+            for (auto count = get_random(state, 0, 1000); count > 0; --count)
+            {
+                const auto key = get_key(state, range);
+                if (set.insert(key) != reference.insert(key).second)
+                {
+                    ++state.failures;
+                    fprintf(stderr, "%s: insert reported the wrong result\n", name);
+                    return;
+                }
+            }
+
+            // Reserving later must not lose keys
+            set.reserve(set.size() + get_random(state, 0, 1000));
+
+            for (size_t i = 0; i < range * 2; ++i)
+            {
+                const auto key = get_key(state, range * 2);
+                if (set.contains(key) != reference.contains(key))
+                {
+                    ++state.failures;
+                    fprintf(stderr, "%s: lookup differs\n", name);
+                    return;
+                }
+            }
+
+            if (set.size() != reference.size() || set.empty() != reference.empty())
+            {
+                ++state.failures;
+                fprintf(stderr, "%s: got %zu keys, expected %zu\n", name, set.size(), reference.size());
+            }
+
+            set.clear();
+            if (!set.empty() || set.contains(get_key(state, range)) || !set.insert(1) || !set.contains(1))
+            {
+                ++state.failures;
+                fprintf(stderr, "%s: set is unusable after clearing it\n", name);
+            }
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                test_against_reference<utils::integer_hash>(state, "integer hash");
+                test_against_reference<colliding_hash>(state, "colliding hash");
+            }
+
+            printf("hash set: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,301 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+
+#include "minidump.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr uint32_t minidump_signature = 0x504D444D;
+        constexpr uint32_t module_list_stream = 4;
+        constexpr uint32_t memory_list_stream = 5;
+        constexpr uint32_t memory64_list_stream = 9;
+
+        constexpr size_t header_size = 32;
+        constexpr size_t directory_size = 12;
+        constexpr size_t module_size = 108;
+
+        struct test_state
+        {
+            std::filesystem::path directory{};
+            size_t failures{};
+        };
+
+        struct dump_range
+        {
+            uint64_t address{};
+            std::vector<uint8_t> data{};
+        };
+
+        struct dump_content
+        {
+            std::vector<dump_range> memory_list{};
+            std::vector<dump_range> memory64_list{};
+            std::u16string module_name{u"C:\\Windows\\System32\\ntdll.dll"};
+        };
+
+        template <typename T>
+        void put(std::vector<uint8_t>& data, const size_t offset, const T value)
+        {
+            if (data.size() < offset + sizeof(T))
+            {
+                data.resize(offset + sizeof(T));
+            }
+
+            memcpy(data.data() + offset, &value, sizeof(T));
+        }
+
+        template <typename T>
+        size_t append(std::vector<uint8_t>& data, const T value)
+        {
+            const auto offset = data.size();
+            put(data, offset, value);
+            return offset;
+        }
+
+        void add_directory(std::vector<uint8_t>& data, const size_t index, const uint32_t type, const size_t offset)
+        {
+            const auto entry = header_size + (index * directory_size);
+
+            put(data, entry, type);
+            put(data, entry + 4, static_cast<uint32_t>(data.size() - offset));
+            put(data, entry + 8, static_cast<uint32_t>(offset));
+        }
+
+        // Module list, memory list and memory64 list, followed by the memory of both lists
+        std::vector<uint8_t> build_minidump(const dump_content& content)
+        {
+            std::vector<uint8_t> data{};
+
+            append(data, minidump_signature);
+            append(data, uint32_t{0xA793});
+            append(data, uint32_t{3});
+            append(data, static_cast<uint32_t>(header_size));
+            data.resize(header_size + (3 * directory_size));
+
+            const auto module_list = append(data, uint32_t{1});
+            const auto module = data.size();
+            data.resize(module + module_size);
+            put(data, module, uint64_t{0x7FF800000000});
+            put(data, module + 8, uint32_t{0x1F8000});
+            put(data, module + 16, uint32_t{0x12345678});
+            add_directory(data, 0, module_list_stream, module_list);
+
+            put(data, module + 20, static_cast<uint32_t>(data.size()));
+            append(data, static_cast<uint32_t>(content.module_name.size() * sizeof(char16_t)));
+            for (const auto character : content.module_name)
+            {
+                append(data, character);
+            }
+
+            const auto memory_list = append(data, static_cast<uint32_t>(content.memory_list.size()));
+            data.resize(data.size() + (content.memory_list.size() * 16));
+            add_directory(data, 1, memory_list_stream, memory_list);
+
+            const auto memory64_list = append(data, static_cast<uint64_t>(content.memory64_list.size()));
+            const auto base_rva = append(data, uint64_t{});
+            for (const auto& range : content.memory64_list)
+            {
+                append(data, range.address);
+                append(data, static_cast<uint64_t>(range.data.size()));
+            }
+
+            add_directory(data, 2, memory64_list_stream, memory64_list);
+
+            for (size_t i = 0; i < content.memory_list.size(); ++i)
+            {
+                const auto& range = content.memory_list[i];
+                const auto descriptor = memory_list + 4 + (i * 16);
+
+                put(data, descriptor, range.address);
+                put(data, descriptor + 8, static_cast<uint32_t>(range.data.size()));
+                put(data, descriptor + 12, static_cast<uint32_t>(data.size()));
+                data.insert(data.end(), range.data.begin(), range.data.end());
+            }
+
+            put(data, base_rva, static_cast<uint64_t>(data.size()));
+            for (const auto& range : content.memory64_list)
+            {
+                data.insert(data.end(), range.data.begin(), range.data.end());
+            }
+
+            return data;
+        }
+
+        std::filesystem::path write_file(const test_state& state, const char* name, const std::vector<uint8_t>& data)
+        {
+            const auto path = state.directory / name;
+
+            std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+            stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+            return path;
+        }
+
+        void fail(test_state& state, const char* name, const char* reason)
+        {
+            ++state.failures;
+            fprintf(stderr, "%s: %s\n", name, reason);
+        }
+
+        std::vector<uint8_t> read(minidump& dump, const uint64_t address, const size_t size)
+        {
+            std::vector<uint8_t> data(size);
+            if (!dump.read_memory(address, data).get())
+            {
+                data.clear();
+            }
+
+            return data;
+        }
+
+        // The range that comes first in the file keeps the overlap, the other one keeps its tail
+        void test_overlapping_ranges(test_state& state)
+        {
+            dump_content content{};
+            content.memory_list.push_back({0x10000, std::vector<uint8_t>(0x200, 0xAA)});
+            content.memory64_list.push_back({0x10100, std::vector<uint8_t>(0x300, 0xBB)});
+            content.memory64_list.push_back({0x10000, std::vector<uint8_t>(0x100, 0xCC)});
+
+            const auto path = write_file(state, "overlapping.dmp", build_minidump(content));
+
+            try
+            {
+                minidump dump{path};
+
+                auto expected = std::vector<uint8_t>(0x200, 0xAA);
+                expected.resize(0x400, 0xBB);
+
+                if (read(dump, 0x10000, 0x400) != expected)
+                {
+                    fail(state, "overlapping ranges", "memory differs");
+                }
+
+                if (!read(dump, 0x10400, 1).empty())
+                {
+                    fail(state, "overlapping ranges", "memory past the ranges could be read");
+                }
+
+                const auto modules = dump.get_modules();
+                if (modules.size() != 1 || modules.front().path != "C:\\Windows\\System32\\ntdll.dll" ||
+                    modules.front().base_address != 0x7FF800000000)
+                {
+                    fail(state, "overlapping ranges", "module differs");
+                }
+            }
+            catch (const std::exception& e)
+            {
+                fail(state, "overlapping ranges", e.what());
+            }
+        }
+
+        void expect_rejected(test_state& state, const char* name, const std::vector<uint8_t>& data)
+        {
+            const auto path = write_file(state, "malformed.dmp", data);
+
+            try
+            {
+                minidump dump{path};
+                fail(state, name, "was accepted");
+            }
+            catch (const std::exception&)
+            {
+                // Expected
+            }
+        }
+
+        // Counts, sizes and offsets come from the file and must be checked against it
+        void test_malformed_dumps(test_state& state)
+        {
+            dump_content content{};
+            content.memory_list.push_back({0x10000, std::vector<uint8_t>(0x100, 0xAA)});
+            content.memory64_list.push_back({0x20000, std::vector<uint8_t>(0x100, 0xBB)});
+
+            const auto valid = build_minidump(content);
+
+            expect_rejected(state, "empty file", {0});
+            expect_rejected(state, "truncated header", std::vector<uint8_t>(valid.begin(), valid.begin() + 16));
+
+            auto dump = valid;
+            put(dump, 0, uint32_t{0x12345678});
+            expect_rejected(state, "wrong signature", dump);
+
+            dump = valid;
+            put(dump, 8, uint32_t{0x10000000});
+            expect_rejected(state, "stream count past the end", dump);
+
+            dump = valid;
+            put(dump, 12, static_cast<uint32_t>(valid.size()));
+            expect_rejected(state, "directory past the end", dump);
+
+            dump = valid;
+            put(dump, header_size + directory_size + 4, uint32_t{0x7FFFFFFF});
+            expect_rejected(state, "stream past the end", dump);
+
+            dump = std::vector<uint8_t>(valid.begin(), valid.end() - 1);
+            expect_rejected(state, "truncated memory", dump);
+
+            // Name length of the module
+            dump = valid;
+            const auto name_rva = [&] {
+                uint32_t rva{};
+                memcpy(&rva, valid.data() + header_size + (3 * directory_size) + 4 + 20, sizeof(rva));
+                return rva;
+            }();
+            put(dump, name_rva, uint32_t{0xFFFFFFF0});
+            expect_rejected(state, "module name past the end", dump);
+
+            // Number of ranges of the memory64 list, which is 64 bits wide
+            dump = valid;
+            const auto memory64_rva = [&] {
+                uint32_t rva{};
+                memcpy(&rva, valid.data() + header_size + (2 * directory_size) + 8, sizeof(rva));
+                return rva;
+            }();
+            put(dump, memory64_rva, uint64_t{0x100000000000});
+            expect_rejected(state, "memory64 count past the end", dump);
+
+            // A range that wraps around the address space is malformed, not overlapping
+            dump = valid;
+            put(dump, memory64_rva + 16, uint64_t{0xFFFFFFFFFFFFFF80});
+            expect_rejected(state, "wrapping range", dump);
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+            state.directory = std::filesystem::temp_directory_path() / "patch-finder-minidump-test";
+
+            std::filesystem::create_directories(state.directory);
+
+            test_overlapping_ranges(state);
+            test_malformed_dumps(state);
+
+            std::error_code error{};
+            std::filesystem::remove_all(state.directory, error);
+
+            printf("minidump: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,446 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <ranges>
+#include <algorithm>
+#include <exception>
+
+#include "module_scanner.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t page_size = 0x1000;
+        constexpr uint64_t image_base = 0x180000000;
+        constexpr uint64_t base_address = 0x7ff600000000;
+        constexpr size_t iterations = 200;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            size_t failures{};
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        // Memory of a single module, with pages that can't be read. Views are only handed out if mapped is set.
+        class test_memory : public memory_source
+        {
+          public:
+            std::vector<uint8_t> data{};
+            std::vector<bool> unreadable_pages{};
+            bool mapped{false};
+
+            std::future<bool> read_memory(const uint64_t address, const std::span<uint8_t> buffer) override
+            {
+                if (!this->is_readable(address, buffer.size()))
+                {
+                    return make_ready_read_result(false);
+                }
+
+                memcpy(buffer.data(), this->data.data() + (address - base_address), buffer.size());
+                return make_ready_read_result(true);
+            }
+
+            std::span<const uint8_t> get_memory_view(const uint64_t address, const size_t size) override
+            {
+                if (!this->mapped || !this->is_readable(address, size))
+                {
+                    return {};
+                }
+
+                return std::span(this->data).subspan(static_cast<size_t>(address - base_address), size);
+            }
+
+          private:
+            bool is_readable(const uint64_t address, const size_t size) const
+            {
+                if (address < base_address || address - base_address + size > this->data.size())
+                {
+                    return false;
+                }
+
+                const auto first_page = (address - base_address) / page_size;
+                const auto last_page = (address - base_address + size - 1) / page_size;
+
+                for (auto page = first_page; page <= last_page && size > 0; ++page)
+                {
+                    if (this->unreadable_pages[page])
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+        };
+
+        struct test_case
+        {
+            std::vector<std::vector<uint8_t>> section_data{};
+            clean_image image{};
+            test_memory memory{};
+
+            // Scans stop reading once every section of a region was rejected, so how far they read depends on the chunks
+            bool may_reject{false};
+        };
+
+        // Sections follow each other closely or with gaps, are full of 8 byte slots and get patched in random places
+        test_case generate_test_case(test_state& state)
+        {
+            test_case test{};
+            test.image.image_base = image_base;
+
+            const auto section_count = get_random(state, 1, 4);
+            test.section_data.resize(section_count);
+
+            uint64_t rva = page_size;
+
+            for (auto& data : test.section_data)
+            {
+                data.resize(get_random(state, 1, 0x6000));
+                for (auto& value : data)
+                {
+                    value = static_cast<uint8_t>(state.random());
+                }
+
+                auto& section = test.image.sections.emplace_back();
+                section.rva = static_cast<uint32_t>(rva);
+                section.data = data;
+
+                size_t position = get_random(state, 0, 16);
+                while (position + sizeof(uint64_t) <= data.size())
+                {
+                    section.relocations.emplace_back(static_cast<uint32_t>(rva + position), static_cast<uint8_t>(sizeof(uint64_t)));
+                    position += sizeof(uint64_t) + (get_random(state, 0, 1) == 0 ? 0 : get_random(state, 1, 40));
+                }
+
+                rva += data.size() + (get_random(state, 0, 1) == 0 ? get_random(state, 0, 64) : get_random(state, 1, 3) * page_size);
+            }
+
+            const auto delta = test.image.get_delta(base_address);
+            const auto image_size = (rva + page_size - 1) & ~(page_size - 1);
+
+            auto& memory = test.memory;
+            memory.data.resize(image_size);
+            memory.unreadable_pages.resize(image_size / page_size);
+
+            std::vector<uint8_t> relocated{};
+
+            for (const auto& section : test.image.sections)
+            {
+                auto* runtime = memory.data.data() + section.rva;
+                std::ranges::copy(section.data, runtime);
+
+                for (const auto& slot : section.relocations)
+                {
+                    uint64_t value{};
+                    memcpy(&value, runtime + (slot.rva - section.rva), sizeof(value));
+                    value += static_cast<uint64_t>(delta);
+                    memcpy(runtime + (slot.rva - section.rva), &value, sizeof(value));
+                }
+            }
+
+            relocated = memory.data;
+
+            const auto patch_count = get_random(state, 0, get_random(state, 0, 3) == 0 ? 400 : 20);
+            for (size_t i = 0; i < patch_count; ++i)
+            {
+                const auto start = get_random(state, page_size, image_size - 1);
+                const auto length = std::min(get_random(state, 1, 16), image_size - start);
+
+                for (size_t j = start; j < start + length; ++j)
+                {
+                    memory.data[j] ^= static_cast<uint8_t>(get_random(state, 1, 255));
+                }
+            }
+
+            // Same rule as the scanner, at least 90% of a section must be equal
+            for (const auto& section : test.image.sections)
+            {
+                const auto size = section.data.size();
+                const auto max_differences = size - (((size / 10) * 9) + 1);
+                const auto differences = std::ranges::count_if(std::views::iota(size_t{0}, size), [&](const size_t offset) {
+                    return memory.data[section.rva + offset] != relocated[section.rva + offset];
+                });
+
+                test.may_reject |= static_cast<size_t>(differences) > max_differences;
+            }
+
+            if (get_random(state, 0, 1) == 0)
+            {
+                const auto unreadable_count = get_random(state, 1, 3);
+                for (size_t i = 0; i < unreadable_count; ++i)
+                {
+                    memory.unreadable_pages[get_random(state, 0, memory.unreadable_pages.size() - 1)] = true;
+                }
+            }
+
+            return test;
+        }
+
+        module_scan_result scan(test_case& test, const scan_options& options, const patch_allowlist* allowlist = nullptr)
+        {
+            utils::thread_pool pool{1};
+            const std::atomic_bool cancelled{false};
+            scan_profiler profiler{false};
+            module_profile profile{};
+
+            const module_scan_context context{options, test.memory, pool, cancelled, profiler, true, allowlist};
+            return scan_module(context, test.image, base_address, profile);
+        }
+
+        void check(test_state& state, const char* name, const test_case& test, const module_scan_result& actual,
+                   const module_scan_result& expected)
+        {
+            const auto same_patches = std::ranges::equal(actual.patches, expected.patches, [](const patch& left, const patch& right) {
+                return left.address == right.address && left.length == right.length;
+            });
+
+            const auto same_ranges =
+                std::ranges::equal(actual.unreadable_ranges, expected.unreadable_ranges, [](const memory_range& left, const memory_range& right) {
+                    return left.address == right.address && left.size == right.size;
+                });
+
+            const auto same_pages = std::ranges::equal(actual.page_hashes, expected.page_hashes, [](const page_hash& left, const page_hash& right) {
+                return left.address == right.address && left.hash == right.hash;
+            });
+
+            if (same_patches && ((same_ranges && same_pages) || test.may_reject) && actual.allowed_patches == expected.allowed_patches)
+            {
+                return;
+            }
+
+            ++state.failures;
+            fprintf(stderr, "%s: got %zu patches (%zu allowed), expected %zu (%zu allowed)%s%s\n", name, actual.patches.size(),
+                    actual.allowed_patches, expected.patches.size(), expected.allowed_patches, same_ranges ? "" : ", unreadable ranges differ",
+                    same_pages ? "" : ", page hashes differ");
+        }
+
+        // Small reads cut the sections into many chunks, which must not change the result of reading each region at once
+        void test_chunked_reads(test_state& state)
+        {
+            auto test = generate_test_case(state);
+
+            scan_options whole{};
+            whole.initial_read_size = 0x100000;
+            whole.max_read_size = 0x100000;
+
+            scan_options chunked{};
+            chunked.initial_read_size = page_size;
+            chunked.max_read_size = get_random(state, 1, 3) * page_size;
+
+            const auto expected = scan(test, whole);
+            check(state, "chunked reads", test, scan(test, chunked), expected);
+
+            if (std::ranges::none_of(test.memory.unreadable_pages, [](const bool unreadable) { return unreadable; }))
+            {
+                test.memory.mapped = true;
+                check(state, "mapped memory", test, scan(test, chunked), expected);
+                test.memory.mapped = false;
+            }
+
+            // Patches that cross chunk boundaries must still be matched against the allowlist as a whole
+            patch_allowlist allowlist{};
+            auto allowed = expected;
+            allowed.patches.clear();
+
+            for (const auto& entry : expected.patches)
+            {
+                if (get_random(state, 0, 1) == 0)
+                {
+                    allowed.patches.push_back(entry);
+                    continue;
+                }
+
+                const auto offset = static_cast<size_t>(entry.address - base_address);
+                const auto bytes = std::span(test.memory.data).subspan(offset, static_cast<size_t>(entry.length));
+                allowlist.add(make_allowed_patch(test.image.identity, entry.address - base_address, bytes));
+                ++allowed.allowed_patches;
+            }
+
+            check(state, "allowlist", test, scan(test, chunked, &allowlist), allowed);
+        }
+
+        // Compared ranges of the quick scan, grown the same way so that they don't cut through a slot
+        std::vector<diff_range> get_prologue_windows(const clean_section& section, const std::span<const uint32_t> functions,
+                                                     const size_t prologue_size)
+        {
+            std::vector<diff_range> windows{};
+
+            for (size_t i = 0; i < functions.size(); ++i)
+            {
+                if (functions[i] < section.rva || functions[i] >= section.rva + section.data.size())
+                {
+                    continue;
+                }
+
+                auto end = std::min<size_t>(functions[i] + prologue_size, section.rva + section.data.size());
+                if (i + 1 < functions.size())
+                {
+                    end = std::min<size_t>(end, functions[i + 1]);
+                }
+
+                diff_range window{functions[i] - section.rva, end - section.rva};
+
+                for (const auto& slot : section.relocations)
+                {
+                    const auto begin = slot.rva - section.rva;
+                    if (begin < window.begin && begin + slot.size > window.begin)
+                    {
+                        window.begin = begin;
+                    }
+
+                    if (begin < window.end && begin + slot.size > window.end)
+                    {
+                        window.end = begin + slot.size;
+                    }
+                }
+
+                if (!windows.empty() && window.begin <= windows.back().end)
+                {
+                    windows.back().end = std::max(windows.back().end, window.end);
+                }
+                else
+                {
+                    windows.push_back(window);
+                }
+            }
+
+            return windows;
+        }
+
+        // Quick scans must report the patches they see with the same address and length as full scans,
+        // so that an allowlist written by a full scan also applies to them
+        void test_prologue_scans(test_state& state)
+        {
+            auto test = generate_test_case(state);
+            test.memory.unreadable_pages.assign(test.memory.unreadable_pages.size(), false);
+
+            if (test.may_reject)
+            {
+                return;
+            }
+
+            std::vector<uint32_t> starts{};
+            function_index functions{};
+
+            for (const auto& section : test.image.sections)
+            {
+                for (auto count = get_random(state, 0, 40); count > 0; --count)
+                {
+                    starts.push_back(static_cast<uint32_t>(section.rva + get_random(state, 0, section.data.size() - 1)));
+                    functions.add(starts.back());
+                }
+            }
+
+            std::ranges::sort(starts);
+            const auto duplicates = std::ranges::unique(starts);
+            starts.erase(duplicates.begin(), duplicates.end());
+            functions.finalize();
+
+            scan_options options{};
+            options.prologue_size = get_random(state, 1, 64);
+
+            const auto full = scan(test, options);
+
+            module_scan_result expected{};
+            patch_allowlist allowlist{};
+
+            for (const auto& section : test.image.sections)
+            {
+                const auto windows = get_prologue_windows(section, starts, options.prologue_size);
+                const auto section_address = base_address + section.rva;
+
+                size_t compared_bytes = 0;
+                size_t differences = 0;
+                std::vector<patch> patches{};
+
+                for (const auto& window : windows)
+                {
+                    compared_bytes += window.end - window.begin;
+
+                    for (const auto& entry : full.patches)
+                    {
+                        const auto begin = std::max(entry.address, section_address + window.begin);
+                        const auto end = std::min(entry.address + entry.length, section_address + window.end);
+
+                        if (begin >= end)
+                        {
+                            continue;
+                        }
+
+                        differences += static_cast<size_t>(end - begin);
+
+                        if (patches.empty() || patches.back().address != entry.address)
+                        {
+                            patches.push_back(entry);
+                        }
+                    }
+                }
+
+                const auto min_equal_bytes = ((compared_bytes / 10) * 9) + 1;
+                if (compared_bytes >= min_equal_bytes && differences <= compared_bytes - min_equal_bytes)
+                {
+                    expected.patches.insert(expected.patches.end(), patches.begin(), patches.end());
+                }
+            }
+
+            for (const auto& entry : full.patches)
+            {
+                const auto offset = static_cast<size_t>(entry.address - base_address);
+                const auto bytes = std::span(test.memory.data).subspan(offset, static_cast<size_t>(entry.length));
+                allowlist.add(make_allowed_patch(test.image.identity, entry.address - base_address, bytes));
+            }
+
+            utils::thread_pool pool{1};
+            const std::atomic_bool cancelled{false};
+            scan_profiler profiler{false};
+            module_profile profile{};
+
+            const module_scan_context context{options, test.memory, pool, cancelled, profiler, true};
+            check(state, "prologue scan", test, scan_function_prologues(context, test.image, functions, base_address, profile), expected);
+
+            // Every patch the quick scan reports was recorded by the full scan
+            auto allowed = expected;
+            allowed.allowed_patches = allowed.patches.size();
+            allowed.patches.clear();
+
+            const module_scan_context allowlist_context{options, test.memory, pool, cancelled, profiler, true, &allowlist};
+            check(state, "prologue allowlist", test, scan_function_prologues(allowlist_context, test.image, functions, base_address, profile),
+                  allowed);
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                test_chunked_reads(state);
+                test_prologue_scans(state);
+            }
+
+            printf("module scanner: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,276 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <exception>
+#include <filesystem>
+
+#include "module_store.hpp"
+#include "patch_allowlist.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t iterations = 50;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            std::filesystem::path directory{};
+            size_t failures{};
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        void fail(test_state& state, const char* name, const char* reason)
+        {
+            ++state.failures;
+            fprintf(stderr, "%s: %s\n", name, reason);
+        }
+
+        std::filesystem::path write_file(const test_state& state, const char* name, const std::string_view data)
+        {
+            const auto path = state.directory / name;
+
+            std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+            stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+
+            return path;
+        }
+
+        std::string read_file(const std::filesystem::path& path)
+        {
+            std::ifstream stream{path, std::ios::binary};
+            return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+        }
+
+        std::vector<allowed_patch> generate_entries(test_state& state)
+        {
+            std::vector<allowed_patch> entries{};
+
+            for (auto count = get_random(state, 0, 200); count > 0; --count)
+            {
+                std::vector<uint8_t> bytes(get_random(state, 1, 16));
+                for (auto& value : bytes)
+                {
+                    value = static_cast<uint8_t>(state.random());
+                }
+
+                // Few identities, so that entries of the same module share them
+                const image_identity identity{static_cast<uint32_t>(get_random(state, 1, 3)), 0x1F8000};
+                entries.push_back(make_allowed_patch(identity, get_random(state, 0x1000, 0x200000), bytes));
+            }
+
+            return entries;
+        }
+
+        // Entries written in either format are loaded back, and nothing else is contained
+        void test_round_trip(test_state& state, const bool binary)
+        {
+            const auto name = binary ? "binary round trip" : "text round trip";
+            const auto entries = generate_entries(state);
+            const auto path = state.directory / (binary ? "allowlist.bin" : "allowlist.txt");
+
+            write_patch_allowlist(path, entries, binary);
+
+            patch_allowlist allowlist{};
+            allowlist.load(path);
+
+            for (const auto& entry : entries)
+            {
+                if (!allowlist.contains(entry))
+                {
+                    fail(state, name, "entry is missing");
+                    return;
+                }
+
+                auto other = entry;
+                other.hash ^= 1;
+
+                if (allowlist.contains(other))
+                {
+                    fail(state, name, "entry with another hash is contained");
+                    return;
+                }
+            }
+
+            if (allowlist.size() > entries.size())
+            {
+                fail(state, name, "more entries than written");
+            }
+        }
+
+        void expect_rejected(test_state& state, const char* name, const std::string_view data)
+        {
+            const auto path = write_file(state, "malformed", data);
+
+            try
+            {
+                patch_allowlist allowlist{};
+                allowlist.load(path);
+                fail(state, name, "was accepted");
+            }
+            catch (const std::exception&)
+            {
+                // Expected
+            }
+        }
+
+        // Comments, blank lines and CRLF line endings are skipped, broken lines are reported
+        void test_text_format(test_state& state)
+        {
+            const image_identity identity{0x12345678, 0x1F8000};
+            const auto prefix = format_image_identity(identity);
+
+            const auto text = "# Hotpatches\r\n\r\n   \n" + prefix + " 1A2B 5 00000000DEADBEEF\r\n\t" + prefix + "\t10 2 0000000000000001";
+            const auto path = write_file(state, "allowlist.txt", text);
+
+            try
+            {
+                patch_allowlist allowlist{};
+                allowlist.load(path);
+
+                if (allowlist.size() != 2 || !allowlist.contains({identity, 0x1A2B, 5, 0xDEADBEEF}) ||
+                    !allowlist.contains({identity, 0x10, 2, 1}))
+                {
+                    fail(state, "text format", "entries differ");
+                }
+            }
+            catch (const std::exception& e)
+            {
+                fail(state, "text format", e.what());
+            }
+
+            expect_rejected(state, "missing field", prefix + " 1A2B 5\n");
+            expect_rejected(state, "extra field", prefix + " 1A2B 5 1 2\n");
+            expect_rejected(state, "invalid number", prefix + " 1A2B 5 XYZ\n");
+            expect_rejected(state, "invalid identity", "module 1A2B 5 1\n");
+
+            try
+            {
+                patch_allowlist allowlist{};
+                allowlist.load(write_file(state, "allowlist.txt", "# Comment\n" + prefix + " 1 1 1\n" + prefix + " 1 1\n"));
+                fail(state, "line number", "was accepted");
+            }
+            catch (const std::exception& e)
+            {
+                if (std::string_view(e.what()).find("line 3") == std::string_view::npos)
+                {
+                    fail(state, "line number", e.what());
+                }
+            }
+        }
+
+        // The entry count of the binary format comes from the file and must be checked against its size
+        void test_binary_format(test_state& state)
+        {
+            const image_identity identity{0x12345678, 0x1F8000};
+            const std::vector<allowed_patch> entries{{identity, 0x1000, 4, 1}, {identity, 0x2000, 8, 2}};
+
+            const auto path = state.directory / "allowlist.bin";
+            write_patch_allowlist(path, entries, true);
+
+            const auto valid = read_file(path);
+
+            auto data = valid;
+            const uint64_t count = 3;
+            memcpy(data.data() + 8, &count, sizeof(count));
+            expect_rejected(state, "count past the end", data);
+
+            const uint64_t huge_count = 0x1000000000000000;
+            memcpy(data.data() + 8, &huge_count, sizeof(huge_count));
+            expect_rejected(state, "huge count", data);
+
+            data = valid;
+            const uint32_t version = 2;
+            memcpy(data.data() + 4, &version, sizeof(version));
+            expect_rejected(state, "unsupported version", data);
+
+            expect_rejected(state, "truncated header", valid.substr(0, 12));
+
+            // Bytes after the last entry are not part of the table
+            try
+            {
+                patch_allowlist allowlist{};
+                allowlist.load(write_file(state, "allowlist.bin", valid + "garbage"));
+
+                if (allowlist.size() != entries.size())
+                {
+                    fail(state, "trailing bytes", "entries differ");
+                }
+            }
+            catch (const std::exception& e)
+            {
+                fail(state, "trailing bytes", e.what());
+            }
+
+            try
+            {
+                patch_allowlist allowlist{};
+                allowlist.load(write_file(state, "empty.txt", ""));
+
+                if (!allowlist.empty())
+                {
+                    fail(state, "empty file", "entries were loaded");
+                }
+            }
+            catch (const std::exception& e)
+            {
+                fail(state, "empty file", e.what());
+            }
+
+            try
+            {
+                patch_allowlist allowlist{};
+                allowlist.load(state.directory / "missing.txt");
+                fail(state, "missing file", "was accepted");
+            }
+            catch (const std::exception&)
+            {
+                // Expected
+            }
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+            state.directory = std::filesystem::temp_directory_path() / "patch-finder-allowlist-test";
+
+            std::filesystem::create_directories(state.directory);
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                test_round_trip(state, false);
+                test_round_trip(state, true);
+            }
+
+            test_text_format(state);
+            test_binary_format(state);
+
+            std::error_code error{};
+            std::filesystem::remove_all(state.directory, error);
+
+            printf("patch allowlist: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
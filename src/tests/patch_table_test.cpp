@@ -0,0 +1,207 @@
+#include <tuple>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+#include "patch_table.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t iterations = 300;
+        constexpr size_t module_count = 4;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            size_t failures{};
+        };
+
+        // What a row of the table should show
+        struct expected_row
+        {
+            std::string module{};
+            uint64_t address{};
+            uint32_t length{};
+            bool is_pointer{false};
+            uint64_t target{};
+
+            bool operator==(const expected_row&) const = default;
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        std::string get_module_path(const size_t index)
+        {
+            return "C:\\Windows\\System32\\module" + std::to_string(index) + ".dll";
+        }
+
+        std::vector<patch> generate_patches(test_state& state, const size_t module_index)
+        {
+            std::vector<patch> patches{};
+            uint64_t address = 0x7ff800000000 + (module_index * 0x1000000);
+
+            for (auto count = get_random(state, 0, 20); count > 0; --count)
+            {
+                address += get_random(state, 1, 0x400);
+                patches.emplace_back(address, get_random(state, 1, 32));
+            }
+
+            return patches;
+        }
+
+        bool is_row_before(const patch_sort_key key, const expected_row& left, const expected_row& right)
+        {
+            switch (key)
+            {
+            case patch_sort_key::module:
+                return std::tie(left.module, left.address) < std::tie(right.module, right.address);
+            case patch_sort_key::length:
+                return left.length != right.length ? left.length > right.length : left.address < right.address;
+            default:
+                return left.address < right.address;
+            }
+        }
+
+        // Rows that are equal by the sort key may come in any order
+        void check(test_state& state, const char* name, const patch_table& table, std::vector<expected_row> expected)
+        {
+            std::vector<expected_row> actual{};
+            for (size_t row = 0; row < table.size(); ++row)
+            {
+                const auto& record = table.get_row(row);
+                const auto* target = table.get_pointer_target(row);
+
+                actual.push_back({
+                    .module = table.get_module(record),
+                    .address = record.address,
+                    .length = record.length,
+                    .is_pointer = target != nullptr,
+                    .target = target ? target->target : 0,
+                });
+            }
+
+            const auto sorted = std::ranges::is_sorted(actual, [&](const expected_row& left, const expected_row& right) {
+                return is_row_before(table.get_sort_key(), left, right);
+            });
+
+            const auto get_key = [](const expected_row& row) { return std::tie(row.module, row.address, row.length, row.is_pointer, row.target); };
+            std::ranges::sort(actual, {}, get_key);
+            std::ranges::sort(expected, {}, get_key);
+
+            if (sorted && actual == expected)
+            {
+                return;
+            }
+
+            ++state.failures;
+            fprintf(stderr, "%s: got %zu rows, expected %zu%s\n", name, actual.size(), expected.size(), sorted ? "" : ", rows are out of order");
+        }
+
+        // Modules are added, patched, partially removed and unloaded in random order, as incremental scans do
+        void test_random_updates(test_state& state)
+        {
+            patch_table table{};
+            std::vector<expected_row> expected{};
+
+            for (auto steps = get_random(state, 1, 12); steps > 0; --steps)
+            {
+                const auto module = get_random(state, 0, module_count - 1);
+                const auto path = get_module_path(module);
+                const auto module_index = table.add_module(path);
+
+                switch (get_random(state, 0, 4))
+                {
+                case 0: {
+                    const auto patches = generate_patches(state, module);
+
+                    std::vector<pointer_patch> pointer_patches{};
+                    for (const auto& entry : patches)
+                    {
+                        pointer_patches.push_back({entry.address, 8, entry.address ^ 0xFFFF, entry.address});
+                        expected.push_back({path, entry.address, 8, true, entry.address ^ 0xFFFF});
+                    }
+
+                    table.add_pointer_patches(module_index, pointer_patches);
+                    break;
+                }
+
+                case 1: {
+                    std::vector<patch> removed{};
+                    std::erase_if(expected, [&](const expected_row& row) {
+                        if (row.module != path || row.is_pointer || get_random(state, 0, 1) == 0)
+                        {
+                            return false;
+                        }
+
+                        removed.emplace_back(row.address, row.length);
+                        return true;
+                    });
+
+                    std::ranges::sort(removed, [](const patch& left, const patch& right) {
+                        return std::tie(left.address, left.length) < std::tie(right.address, right.length);
+                    });
+
+                    table.remove_patches(module_index, removed);
+                    break;
+                }
+
+                case 2:
+                    std::erase_if(expected, [&](const expected_row& row) { return row.module == path; });
+                    table.remove_module(path);
+                    break;
+
+                case 3:
+                    table.sort(static_cast<patch_sort_key>(get_random(state, 0, 2)));
+                    break;
+
+                default: {
+                    const auto patches = generate_patches(state, module);
+                    for (const auto& entry : patches)
+                    {
+                        expected.push_back({path, entry.address, static_cast<uint32_t>(entry.length)});
+                    }
+
+                    table.add_patches(module_index, patches);
+                    break;
+                }
+                }
+
+                check(state, "random updates", table, expected);
+            }
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                test_random_updates(state);
+            }
+
+            printf("patch table: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,244 @@
+#include <set>
+#include <tuple>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <optional>
+#include <algorithm>
+#include <exception>
+
+#include "scan_history.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t iterations = 300;
+        constexpr uint64_t page_size = 0x1000;
+        constexpr uint64_t base_address = 0x7ff800000000;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            size_t failures{};
+        };
+
+        using patch_key = std::tuple<uint64_t, uint64_t>;
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        void fail(test_state& state, const char* name, const char* reason)
+        {
+            ++state.failures;
+            fprintf(stderr, "%s: %s\n", name, reason);
+        }
+
+        // Patches come in scan order, which isn't necessarily sorted, and pages may be missing because they were unreadable
+        module_scan_result generate_result(test_state& state)
+        {
+            module_scan_result result{};
+
+            for (auto count = get_random(state, 0, 12); count > 0; --count)
+            {
+                result.patches.emplace_back(base_address + get_random(state, 0, 0x20) * 0x10, get_random(state, 1, 2));
+            }
+
+            std::ranges::sort(result.patches, {}, [](const patch& entry) { return patch_key{entry.address, entry.length}; });
+            const auto duplicates = std::ranges::unique(result.patches, {}, [](const patch& entry) { return patch_key{entry.address, entry.length}; });
+            result.patches.erase(duplicates.begin(), duplicates.end());
+            std::ranges::shuffle(result.patches, state.random);
+
+            for (uint64_t page = 0; page < 8; ++page)
+            {
+                if (get_random(state, 0, 5) != 0)
+                {
+                    result.page_hashes.emplace_back(base_address + (page * page_size), get_random(state, 0, 2));
+                }
+            }
+
+            std::ranges::shuffle(result.page_hashes, state.random);
+            return result;
+        }
+
+        std::set<patch_key> get_keys(const std::span<const patch> patches)
+        {
+            std::set<patch_key> keys{};
+            for (const auto& entry : patches)
+            {
+                keys.emplace(entry.address, entry.length);
+            }
+
+            return keys;
+        }
+
+        // Pages that were hashed in only one of the scans count as changed as well
+        std::set<uint64_t> get_changed_pages(const module_scan_result& old_result, const module_scan_result& new_result)
+        {
+            std::set<uint64_t> changed{};
+
+            for (uint64_t page = 0; page < 8; ++page)
+            {
+                const auto address = base_address + (page * page_size);
+                const auto find = [&](const module_scan_result& result) {
+                    const auto entry = std::ranges::find(result.page_hashes, address, &page_hash::address);
+                    return entry != result.page_hashes.end() ? std::optional(entry->hash) : std::nullopt;
+                };
+
+                if (find(old_result) != find(new_result))
+                {
+                    changed.insert(address);
+                }
+            }
+
+            return changed;
+        }
+
+        std::set<uint64_t> get_pages(const std::span<const memory_range> ranges)
+        {
+            std::set<uint64_t> pages{};
+            for (const auto& range : ranges)
+            {
+                for (auto address = range.address; address < range.address + range.size; address += page_size)
+                {
+                    pages.insert(address);
+                }
+            }
+
+            return pages;
+        }
+
+        void test_updates(test_state& state)
+        {
+            scan_history history{};
+            const module_info module{"C:\\Windows\\System32\\ntdll.dll", base_address, 8 * page_size};
+
+            const auto first = generate_result(state);
+            auto changes = history.update(module, first);
+
+            if (!changes.is_new || get_keys(changes.added_patches) != get_keys(first.patches) || !changes.removed_patches.empty())
+            {
+                fail(state, "first scan", "all patches must be new");
+            }
+
+            const auto second = generate_result(state);
+            changes = history.update(module, second);
+
+            std::set<patch_key> added{};
+            std::set<patch_key> removed{};
+            const auto first_keys = get_keys(first.patches);
+            const auto second_keys = get_keys(second.patches);
+            std::ranges::set_difference(second_keys, first_keys, std::inserter(added, added.end()));
+            std::ranges::set_difference(first_keys, second_keys, std::inserter(removed, removed.end()));
+
+            if (changes.is_new || get_keys(changes.added_patches) != added || get_keys(changes.removed_patches) != removed)
+            {
+                fail(state, "second scan", "patch changes differ");
+            }
+
+            if (get_pages(changes.changed_pages) != get_changed_pages(first, second))
+            {
+                fail(state, "second scan", "changed pages differ");
+            }
+
+            // The baseline is what a rescan starts from, patches must come sorted
+            const auto baseline = history.get_baseline(module);
+            if (!baseline || get_keys(baseline->patches) != second_keys ||
+                !std::ranges::is_sorted(baseline->patches, {}, [](const patch& entry) { return patch_key{entry.address, entry.length}; }) ||
+                baseline->page_hashes.size() != second.page_hashes.size())
+            {
+                fail(state, "baseline", "differs from the last scan");
+            }
+
+            // Another module at the same base is a different one
+            auto other = module;
+            other.path = "C:\\Windows\\System32\\kernel32.dll";
+
+            if (history.contains(other) || history.get_baseline(other) || !history.update(other, second).is_new)
+            {
+                fail(state, "same base", "module was not treated as new");
+            }
+
+            const auto removed_modules = history.remove(other.path);
+            if (removed_modules.size() != 1 || get_keys(removed_modules.front().patches) != second_keys || history.contains(other))
+            {
+                fail(state, "remove", "module was not forgotten");
+            }
+        }
+
+        void test_missing_modules(test_state& state)
+        {
+            scan_history history{};
+            std::vector<module_info> modules{};
+
+            for (size_t i = 0; i < 6; ++i)
+            {
+                modules.push_back({"module" + std::to_string(i) + ".dll", base_address + (i * 0x1000000), page_size});
+                history.update(modules.back(), generate_result(state));
+            }
+
+            std::vector<module_info> loaded{};
+            std::set<std::string> unloaded{};
+
+            for (const auto& module : modules)
+            {
+                if (get_random(state, 0, 1) == 0)
+                {
+                    loaded.push_back(module);
+                }
+                else
+                {
+                    unloaded.insert(module.path);
+                }
+            }
+
+            std::set<std::string> removed{};
+            for (const auto& entry : history.remove_missing(loaded))
+            {
+                removed.insert(entry.module.path);
+            }
+
+            if (removed != unloaded || !std::ranges::all_of(loaded, [&](const module_info& module) { return history.contains(module); }))
+            {
+                fail(state, "remove missing", "wrong modules were forgotten");
+            }
+
+            history.clear();
+            if (std::ranges::any_of(modules, [&](const module_info& module) { return history.contains(module); }))
+            {
+                fail(state, "clear", "modules are still known");
+            }
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                test_updates(state);
+                test_missing_modules(state);
+            }
+
+            printf("scan history: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,332 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+
+#include "session_capture.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr uint64_t base_address = 0x7ff700000000;
+        constexpr size_t window_size = 0x10000;
+        constexpr size_t iterations = 40;
+
+        // Offsets into the capture, the header is followed by the chunk data, the chunk index and the module table
+        constexpr size_t chunk_offset_offset = 8;
+        constexpr size_t chunk_count_offset = 16;
+        constexpr size_t module_offset_offset = 24;
+        constexpr size_t header_size = 40;
+        constexpr size_t chunk_file_offset_offset = 8;
+        constexpr size_t chunk_stored_size_offset = 20;
+        constexpr size_t module_path_length_offset = 40;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            std::filesystem::path directory{};
+            size_t failures{};
+        };
+
+        struct captured_region
+        {
+            uint64_t address{};
+            std::vector<uint8_t> data{};
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        void fail(test_state& state, const char* name, const char* reason)
+        {
+            ++state.failures;
+            fprintf(stderr, "%s: %s\n", name, reason);
+        }
+
+        // Half of the regions are runs of a single byte, so that they are stored compressed
+        std::vector<captured_region> generate_regions(test_state& state)
+        {
+            std::vector<captured_region> regions(get_random(state, 1, 12));
+
+            for (auto& region : regions)
+            {
+                const auto size = get_random(state, 1, 0x3000);
+                region.address = base_address + get_random(state, 0, window_size - size);
+                region.data.resize(size);
+
+                const auto is_run = get_random(state, 0, 1) == 0;
+                const auto fill = static_cast<uint8_t>(state.random());
+
+                for (auto& value : region.data)
+                {
+                    value = is_run ? fill : static_cast<uint8_t>(state.random());
+                }
+            }
+
+            return regions;
+        }
+
+        std::vector<captured_module> generate_modules(test_state& state)
+        {
+            std::vector<captured_module> modules(get_random(state, 1, 4));
+
+            for (size_t i = 0; i < modules.size(); ++i)
+            {
+                auto& module = modules[i];
+                module.module.path = "C:\\Windows\\System32\\module" + std::to_string(i) + ".dll";
+                module.module.base_address = base_address + (i * 0x100000);
+                module.module.size = get_random(state, 0x1000, 0x100000);
+
+                if (get_random(state, 0, 1) == 0)
+                {
+                    module.module.identity = image_identity{static_cast<uint32_t>(state.random()), static_cast<uint32_t>(module.module.size)};
+                }
+
+                if (get_random(state, 0, 1) == 0)
+                {
+                    module.file = file_identity{get_random(state, 1, 0x100000), static_cast<int64_t>(state.random() >> 1)};
+                }
+            }
+
+            return modules;
+        }
+
+        // Regions that start at a lower address win, at the same address the one captured first
+        std::vector<std::optional<uint8_t>> get_reference_memory(std::vector<captured_region> regions)
+        {
+            std::vector<std::optional<uint8_t>> memory(window_size);
+            std::ranges::stable_sort(regions, {}, &captured_region::address);
+
+            for (const auto& region : regions)
+            {
+                for (size_t i = 0; i < region.data.size(); ++i)
+                {
+                    auto& value = memory[region.address - base_address + i];
+                    if (!value)
+                    {
+                        value = region.data[i];
+                    }
+                }
+            }
+
+            return memory;
+        }
+
+        std::vector<uint8_t> read_file(const std::filesystem::path& path)
+        {
+            std::ifstream stream{path, std::ios::binary};
+            return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+        }
+
+        void write_file(const std::filesystem::path& path, const std::span<const uint8_t> data)
+        {
+            std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+            stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        }
+
+        template <typename T>
+        T get(const std::vector<uint8_t>& data, const size_t offset)
+        {
+            T value{};
+            memcpy(&value, data.data() + offset, sizeof(value));
+            return value;
+        }
+
+        template <typename T>
+        void put(std::vector<uint8_t>& data, const size_t offset, const T value)
+        {
+            memcpy(data.data() + offset, &value, sizeof(value));
+        }
+
+        bool is_same_module(const captured_module& left, const captured_module& right)
+        {
+            return left.module.path == right.module.path && left.module.base_address == right.module.base_address &&
+                   left.module.size == right.module.size && left.module.identity == right.module.identity && left.file == right.file;
+        }
+
+        void check_reads(test_state& state, session_capture& capture, const std::vector<std::optional<uint8_t>>& memory)
+        {
+            for (size_t i = 0; i < 200; ++i)
+            {
+                const auto size = get_random(state, 1, 0x2000);
+                const auto offset = get_random(state, 0, window_size - size);
+                const auto expected = std::span(memory).subspan(offset, size);
+                const auto is_captured = std::ranges::all_of(expected, [](const std::optional<uint8_t>& value) { return value.has_value(); });
+
+                std::vector<uint8_t> buffer(size);
+                const auto success = capture.read_memory(base_address + offset, buffer).get();
+
+                if (success != is_captured)
+                {
+                    fail(state, "read_memory", is_captured ? "captured memory was not read" : "memory that was not captured was read");
+                    continue;
+                }
+
+                if (success && !std::ranges::equal(buffer, expected, [](const uint8_t left, const std::optional<uint8_t>& right) {
+                        return left == *right;
+                    }))
+                {
+                    fail(state, "read_memory", "memory differs");
+                }
+
+                const auto view = capture.get_memory_view(base_address + offset, size);
+                if (!view.empty() && (!is_captured || !std::ranges::equal(view, buffer)))
+                {
+                    fail(state, "get_memory_view", "view differs");
+                }
+            }
+        }
+
+        void test_round_trip(test_state& state)
+        {
+            const auto path = state.directory / "capture.pfsc";
+            const auto regions = generate_regions(state);
+            const auto modules = generate_modules(state);
+
+            {
+                session_writer writer{path, get_random(state, 0, 1) == 0};
+                for (const auto& region : regions)
+                {
+                    writer.add_memory(region.address, region.data);
+                }
+
+                for (const auto& module : modules)
+                {
+                    writer.add_module(module);
+                }
+
+                if (writer.finish() != std::filesystem::file_size(path))
+                {
+                    fail(state, "finish", "size differs from the file");
+                }
+            }
+
+            if (!session_capture::is_session_capture(path))
+            {
+                fail(state, "is_session_capture", "capture was not detected");
+            }
+
+            session_capture capture{path};
+            check_reads(state, capture, get_reference_memory(regions));
+
+            if (!std::ranges::equal(capture.get_captured_modules(), modules, is_same_module))
+            {
+                fail(state, "modules", "modules differ");
+            }
+        }
+
+        // Every broken capture throws, no matter where it is cut or what its counts claim
+        void test_broken_captures(test_state& state)
+        {
+            const auto path = state.directory / "capture.pfsc";
+
+            {
+                session_writer writer{path, true};
+                for (const auto& region : generate_regions(state))
+                {
+                    writer.add_memory(region.address, region.data);
+                }
+
+                for (const auto& module : generate_modules(state))
+                {
+                    writer.add_module(module);
+                }
+
+                writer.finish();
+            }
+
+            const auto valid = read_file(path);
+            const auto chunk_offset = static_cast<size_t>(get<uint64_t>(valid, chunk_offset_offset));
+            const auto module_offset = static_cast<size_t>(get<uint64_t>(valid, module_offset_offset));
+
+            const auto expect_rejected = [&](const char* name, const std::vector<uint8_t>& data) {
+                write_file(path, data);
+
+                try
+                {
+                    session_capture capture{path};
+                    fail(state, name, "capture was accepted");
+                }
+                catch (const std::exception&)
+                {
+                }
+            };
+
+            expect_rejected("empty file", {});
+
+            for (size_t i = 0; i < 20; ++i)
+            {
+                const auto size = get_random(state, 1, valid.size() - 1);
+                expect_rejected("truncated capture", std::vector<uint8_t>(valid.begin(), valid.begin() + static_cast<ptrdiff_t>(size)));
+            }
+
+            auto data = valid;
+            put(data, 0, uint32_t{0x504D444D});
+            expect_rejected("magic", data);
+
+            data = valid;
+            put(data, chunk_count_offset, uint64_t{0x1000000000000000});
+            expect_rejected("chunk count", data);
+
+            data = valid;
+            put(data, chunk_offset_offset, static_cast<uint64_t>(valid.size() - header_size));
+            expect_rejected("chunk offset", data);
+
+            data = valid;
+            put(data, chunk_offset + chunk_file_offset_offset, static_cast<uint64_t>(valid.size()));
+            expect_rejected("chunk file offset", data);
+
+            data = valid;
+            put(data, chunk_offset + chunk_stored_size_offset, uint32_t{0x10001});
+            expect_rejected("chunk stored size", data);
+
+            data = valid;
+            put(data, module_offset + module_path_length_offset, uint32_t{0xFFFFFFFF});
+            expect_rejected("module path length", data);
+
+            write_file(path, valid);
+            session_capture capture{path};
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+            state.directory = std::filesystem::temp_directory_path() / "patch-finder-session-capture-test";
+            std::filesystem::create_directories(state.directory);
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                test_round_trip(state);
+                test_broken_captures(state);
+            }
+
+            std::error_code error{};
+            std::filesystem::remove_all(state.directory, error);
+
+            printf("session capture: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <exception>
+
+#include "symbol_index.hpp"
+
+namespace momo
+{
+    namespace
+    {
+        constexpr size_t address_count = 0x200;
+        constexpr size_t iterations = 300;
+
+        struct test_state
+        {
+            std::mt19937_64 random{};
+            size_t failures{};
+        };
+
+        // What every address resolves to, filled in the order the index is supposed to prefer entries
+        struct reference_index
+        {
+            std::vector<std::optional<symbol_entry>> addresses = std::vector<std::optional<symbol_entry>>(address_count);
+
+            void add(std::vector<symbol_entry> entries)
+            {
+                std::ranges::stable_sort(entries, {}, &symbol_entry::start);
+
+                for (const auto& entry : entries)
+                {
+                    for (auto address = entry.start; address < std::max(entry.end, entry.start + 1); ++address)
+                    {
+                        auto& slot = this->addresses[address];
+                        if (!slot)
+                        {
+                            slot = entry;
+                        }
+                    }
+                }
+            }
+        };
+
+        size_t get_random(test_state& state, const size_t min, const size_t max)
+        {
+            return std::uniform_int_distribution<size_t>{min, max}(state.random);
+        }
+
+        void check(test_state& state, const char* name, const uint64_t address, const std::optional<symbol_location>& actual,
+                   const std::optional<symbol_entry>& expected)
+        {
+            const auto matches = [&] {
+                if (!actual || !expected)
+                {
+                    return actual.has_value() == expected.has_value();
+                }
+
+                return actual->name == expected->name && actual->offset == address - expected->base;
+            };
+
+            if (matches())
+            {
+                return;
+            }
+
+            ++state.failures;
+            fprintf(stderr, "%s: 0x%llX resolved to %s, expected %s\n", name, static_cast<unsigned long long>(address),
+                    actual ? format_symbol(*actual).c_str() : "nothing",
+                    expected ? format_symbol({expected->name, address - expected->base}).c_str() : "nothing");
+        }
+
+        // A whole function after a label within it and the other way round, as the symbolizer adds them
+        void test_overlapping_entries(test_state& state)
+        {
+            symbol_index index{};
+            index.add(std::vector<symbol_entry>{{.start = 0x20, .end = 0x21, .base = 0x20, .name = "label"}});
+            index.add(std::vector<symbol_entry>{{.start = 0x10, .end = 0x40, .base = 0x10, .name = "function"}});
+
+            check(state, "function after label", 0x10, index.find(0x10), symbol_entry{.base = 0x10, .name = "function"});
+            check(state, "function after label", 0x20, index.find(0x20), symbol_entry{.base = 0x20, .name = "label"});
+            check(state, "function after label", 0x30, index.find(0x30), symbol_entry{.base = 0x10, .name = "function"});
+            check(state, "function after label", 0x40, index.find(0x40), std::nullopt);
+
+            index.clear();
+            index.add(std::vector<symbol_entry>{{.start = 0x10, .end = 0x40, .base = 0x10, .name = "function"}});
+            index.add(std::vector<symbol_entry>{{.start = 0x20, .end = 0x21, .base = 0x20, .name = "label"}});
+
+            check(state, "label after function", 0x20, index.find(0x20), symbol_entry{.base = 0x10, .name = "function"});
+
+            if (index.size() != 1)
+            {
+                ++state.failures;
+                fprintf(stderr, "label after function: %zu ranges, expected 1\n", index.size());
+            }
+        }
+
+        void test_random_entries(test_state& state)
+        {
+            symbol_index index{};
+            reference_index reference{};
+
+            const auto batch_count = get_random(state, 1, 6);
+            for (size_t batch = 0; batch < batch_count; ++batch)
+            {
+                std::vector<symbol_entry> entries(get_random(state, 0, 12));
+
+                for (auto& entry : entries)
+                {
+                    entry.start = get_random(state, 0, address_count - 1);
+                    entry.end = std::min(entry.start + get_random(state, 0, get_random(state, 0, 3) == 0 ? 0x100 : 0x10), address_count);
+                    entry.base = get_random(state, 0, 1) == 0 ? entry.start : get_random(state, 0, entry.start);
+                    entry.name = get_random(state, 0, 7) == 0 ? std::string{} : "sub_" + std::to_string(state.random() % 1000);
+                }
+
+                index.add(entries);
+                reference.add(entries);
+            }
+
+            for (uint64_t address = 0; address < address_count; ++address)
+            {
+                check(state, "random entries", address, index.find(address), reference.addresses[address]);
+            }
+        }
+
+        size_t run_tests()
+        {
+            test_state state{};
+            test_overlapping_entries(state);
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                test_random_entries(state);
+            }
+
+            printf("symbol index: %zu failures\n", state.failures);
+            return state.failures;
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        return momo::run_tests() == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Tests failed: %s\n", e.what());
+        return 1;
+    }
+}